@@ -270,7 +270,7 @@ def gen_format_struct_name(name):
 
 def gen_format_str(t, typeMap, funcName, inout):
     t = string.strip(t)
-    if t == 'cl_int' and funcName == 'clSetUserEventStatus':
+    if t == 'cl_int' and funcName == 'clSetUserEventStatus' and inout == 0:
         t = 'execution_status'
     if (gen_format_struct_name(t) in gen_format_struct_map) and (inout != 0 or is_type_const(t)) and (
             inout != 1 or not is_type_const(t)):
@@ -288,7 +288,7 @@ def gen_format_str(t, typeMap, funcName, inout):
 
 def gen_format_arg(t, name, typeMap, funcName, inout):
     t = string.strip(t)
-    if t == 'cl_int' and funcName == 'clSetUserEventStatus':
+    if t == 'cl_int' and funcName == 'clSetUserEventStatus' and inout == 0:
         t = 'execution_status'
     if (gen_format_struct_name(t) in gen_format_struct_map) and (inout != 0 or is_type_const(t)) and (
             inout != 1 or not is_type_const(t)):
@@ -302,6 +302,96 @@ def gen_format_arg(t, name, typeMap, funcName, inout):
     return 'clint_string_%s(%s)' % (gen_type_name(t), name)
 
 
+def gen_func_formats(f, typeMap):
+    """Returns the text trace format of a call, and of its return as the
+    (format, out_args) pair, or None if nothing is logged on return."""
+    proto, name, r, args, core, ext = f
+    fmt = name + '(' + string.join(map(lambda a: a[1] + '=' + gen_format_str(a[0], typeMap, name, 0), args), ", ") + ')'
+    if r == 'void' and not args:
+        return fmt, None
+    out_args = filter(
+        lambda x: '*' in x[0] and (not 'const' in x[0]) and (not pat_void.match(x[0])) and (x[1] != 'errcode_ret'),
+        args)
+    if r != 'void':
+        out_args = [(r, 'retval')] + out_args
+    out_fmt = name + ' returned ' + string.join(map(
+        lambda a: ((a[1] == 'retval') and gen_format_str(a[0], typeMap, name, 1)) or (
+        a[1] + '=' + gen_format_str(string.strip(a[0][:-1]), typeMap, name, 1)), out_args), " ")
+    return fmt, (out_fmt, out_args)
+
+
+def gen_trace_field(t, name, typeMap, funcName, inout):
+    """Returns how CLINT_TRACE_BINARY encodes an argument as (kind, C type,
+    value, string function), mirroring gen_format_arg so that the decoder can
+    render the same text."""
+    if name == 'retval':
+        if gen_format_str(t, typeMap, funcName, inout) == '%p':
+            return ('pointer', None, name, None)
+        return ('value', string.strip(t), name, None)
+    t = string.strip(t)
+    if t == 'cl_int' and funcName == 'clSetUserEventStatus' and inout == 0:
+        t = 'execution_status'
+    if (gen_format_struct_name(t) in gen_format_struct_map) and (inout != 0 or is_type_const(t)) and (
+            inout != 1 or not is_type_const(t)):
+        struct = gen_format_struct_name(t)
+        return ('struct', struct, name, 'clint_string_%s' % gen_type_name(struct))
+    if inout == 1 and '*' in t and (not '(' in t) and gen_format_struct_name(t) != 'void':
+        value = '(%s ? *%s : 0)' % (name, name)
+        if gen_format_str(t, typeMap, funcName, inout) == '%p':
+            return ('pointer', None, value, None)
+        return ('value', gen_format_struct_name(t), value, None)
+    if t == 'const char *':
+        return ('string', None, name, 'clint_string_shorten')
+    if t in typeMap:
+        return ('enum', gen_type_arg(t), name, 'clint_string_%s' % gen_type_name(t))
+    if gen_format_str(t, typeMap, funcName, inout) == '%p':
+        return ('pointer', None, name, None)
+    return ('value', t, name, None)
+
+
+def gen_trace_size(field):
+    kind, ctype, value, func = field
+    if kind == 'struct':
+        return '1 + sizeof(%s)' % ctype
+    if kind == 'string':
+        return '1 + CLINT_TRACE_MAX_STRING'
+    if kind == 'pointer':
+        return 'sizeof(cl_ulong)'
+    return 'sizeof(%s)' % ctype
+
+
+def gen_trace_put(field):
+    kind, ctype, value, func = field
+    if kind == 'struct':
+        return 'trace = clint_trace_put_bytes(trace, %s, sizeof(%s))' % (value, ctype)
+    if kind == 'string':
+        return 'trace = clint_trace_put_string(trace, %s)' % value
+    if kind == 'pointer':
+        return 'CLINT_TRACE_PUT_POINTER(trace, %s)' % value
+    return 'CLINT_TRACE_PUT(trace, %s, %s)' % (ctype, value)
+
+
+def gen_trace_log(out, name, log_args):
+    out.write('\tif (CLINT_FILTER_LIVE(ClintFunc_%s, CLINT_FILTER_TRACE)) {\n' % name)
+    out.write('\t\tif (clint_get_config(CLINT_TRACE_LOOPS))\n')
+    out.write('\t\t\tclint_loop_trace(ClintFunc_%s, clint_string_sprintf(%s));\n' % (name, log_args))
+    out.write('\t\telse\n')
+    out.write('\t\t\tclint_log(%s);\n' % log_args)
+    out.write('\t}\n')
+
+
+def gen_trace(out, name, kind, fields):
+    size = string.join(map(gen_trace_size, fields), ' + ') or '0'
+    out.write('\tif (CLINT_FILTER(ClintFunc_%s, CLINT_FILTER_BINARY | CLINT_FILTER_RECORD)) {\n' % name)
+    out.write('\t\tunsigned char *trace = clint_trace_begin(ClintFunc_%s, %s, %s);\n' % (name, kind, size))
+    out.write('\t\tif (trace != NULL) {\n')
+    for field in fields:
+        out.write('\t\t\t%s;\n' % gen_trace_put(field))
+    out.write('\t\t\tclint_trace_end(trace);\n')
+    out.write('\t\t}\n')
+    out.write('\t}\n')
+
+
 def gen_mem_sharing(funcName):
     if 'GL' in funcName:
         sharing = 'ClintObjectSharing_gl'
@@ -398,6 +488,117 @@ def is_profile_all(name, args):
     return has_prefix(name, 'clEnqueue') and filter(lambda a: a[0] == 'cl_event *', args)
 
 
+def wait_blocking_arg(name, args):
+    # The blocking_read/write/map flag of an enqueue that can wait for the device.
+    if not has_prefix(name, 'clEnqueue'):
+        return None
+    arg = filter(lambda a: a[0] == 'cl_bool' and 'blocking' in a[1], args)
+    return (arg and arg[0][1]) or None
+
+
+def is_wait(name, args):
+    return name in ('clFinish', 'clWaitForEvents', 'clGetEventInfo') or wait_blocking_arg(name, args)
+
+
+def gen_wait(out, f):
+    proto, name, r, args, core, ext = f
+    errcode = gen_func_errcode(f)
+    if name == 'clFinish':
+        out.write('\tif (clint_get_config(CLINT_PROFILE_WAIT) && retval == CL_SUCCESS)\n')
+        out.write('\t\tclint_wait_record(ClintFunc_%s, CLINT_RETURN_ADDRESS(), api_time, %s, 0, NULL);\n' %
+                  (name, args[0][1]))
+    elif name == 'clWaitForEvents':
+        out.write('\tif (clint_get_config(CLINT_PROFILE_WAIT) && retval == CL_SUCCESS)\n')
+        out.write('\t\tclint_wait_record(ClintFunc_%s, CLINT_RETURN_ADDRESS(), api_time, NULL, %s, %s);\n' %
+                  (name, args[0][1], args[1][1]))
+    elif name == 'clGetEventInfo':
+        out.write('\tif (clint_get_config(CLINT_PROFILE_WAIT) && retval == CL_SUCCESS &&\n')
+        out.write('\t    %s == CL_EVENT_COMMAND_EXECUTION_STATUS && %s != NULL)\n' % (args[1][1], args[3][1]))
+        out.write('\t\tclint_wait_poll(CLINT_RETURN_ADDRESS(), api_time, %s, *(cl_int*)%s);\n' %
+                  (args[0][1], args[3][1]))
+    else:
+        out.write('\tif (clint_get_config(CLINT_PROFILE_WAIT) && %s == CL_SUCCESS && %s)\n' %
+                  (errcode, wait_blocking_arg(name, args)))
+        out.write('\t\tclint_wait_record(ClintFunc_%s, CLINT_RETURN_ADDRESS(), api_time, %s, 0, NULL);\n' %
+                  (name, args[0][1]))
+
+
+def gen_profile_transfer(name, args):
+    # Direction and size of the data moved by read/write/copy/map commands.
+    if 'Read' in name:
+        transfer = 'ClintTransfer_device_to_host'
+    elif 'Write' in name:
+        transfer = 'ClintTransfer_host_to_device'
+    elif 'Copy' in name:
+        transfer = 'ClintTransfer_device_to_device'
+    elif has_prefix(name, 'clEnqueueMap'):
+        arg = filter(lambda a: a[0] == 'cl_map_flags', args)[-1]
+        transfer = '((%s & CL_MAP_READ) ? ClintTransfer_device_to_host : ClintTransfer_none)' % arg[1]
+    else:
+        return None
+    region = filter(lambda a: a[1] == 'region', args)
+    if region:
+        image = filter(lambda a: a[0] == 'cl_mem' and 'image' in a[1], args)
+        image = (image and image[0][1]) or 'NULL'
+        return (transfer, 'clint_profile_region_bytes(%s, %s)' % (image, region[0][1]))
+    size = filter(lambda a: a[0] == 'size_t' and a[1] in ('size', 'cb'), args)
+    if size:
+        return (transfer, size[-1][1])
+    return None
+
+
+def shm_object_type(name):
+    for prefix in ('clCreate', 'clRetain', 'clRelease'):
+        if has_prefix(name, prefix):
+            rest = name[len(prefix):]
+            break
+    else:
+        return None
+    if has_prefix(rest, 'Context'):
+        return 'context'
+    if has_prefix(rest, 'CommandQueue'):
+        return 'command_queue'
+    if has_prefix(rest, 'Sampler'):
+        return 'sampler'
+    if has_prefix(rest, 'Program'):
+        return 'program'
+    if has_prefix(rest, 'Kernel'):
+        return 'kernel'
+    if 'Event' in rest:
+        return 'event'
+    if rest in ('Buffer', 'SubBuffer', 'MemObject', 'Pipe') or 'Image' in rest or has_prefix(rest, 'From'):
+        return 'mem'
+    return None
+
+
+def gen_shm_counters(out, f):
+    proto, name, r, args, core, ext = f
+    obj = shm_object_type(name)
+    if obj and name == 'clCreateKernelsInProgram':
+        out.write('\tif (retval == CL_SUCCESS && %s != NULL && %s != NULL) {\n' % (args[2][1], args[3][1]))
+        out.write('\t\tCLINT_SHM_ADD(objects[ClintShmObject_%s], *%s);\n' % (obj, args[3][1]))
+        out.write('\t}\n')
+    elif obj and has_prefix(name, 'clCreate') and r != 'cl_int':
+        out.write('\tif (retval != NULL) {\n')
+        out.write('\t\tCLINT_SHM_ADD(objects[ClintShmObject_%s], 1);\n' % obj)
+        if name == 'clCreateBuffer':
+            size = filter(lambda a: a[0] == 'size_t', args)[0]
+            out.write('\t\tCLINT_SHM_ADD(buffer_bytes, %s);\n' % size[1])
+        out.write('\t}\n')
+    elif obj and (has_prefix(name, 'clRetain') or has_prefix(name, 'clRelease')):
+        out.write('\tif (retval == CL_SUCCESS) {\n')
+        out.write('\t\tCLINT_SHM_ADD(objects[ClintShmObject_%s], %d);\n' % (obj, has_prefix(name, 'clRetain') and 1 or -1))
+        out.write('\t}\n')
+    if is_profile_all(name, args):
+        arg = filter(lambda a: a[0] == 'cl_event *', args)[-1]
+        errcode = gen_func_errcode(f)
+        if name in profile_funcs:
+            out.write('\tif (%s == CL_SUCCESS)\n' % errcode)
+            out.write('\t\tCLINT_SHM_ADD(kernels, 1);\n')
+        out.write('\tif (%s == CL_SUCCESS && %s != NULL && %s != &profile_event)\n' % (errcode, arg[1], arg[1]))
+        out.write('\t\tCLINT_SHM_ADD(objects[ClintShmObject_event], 1);\n')
+
+
 def gen_func_has_errcode(f):
     proto, name, r, args, core, ext = f
     return (r == 'cl_int' or (args and args[-1][0] in ('cl_int *', 'int *')))
@@ -412,6 +613,8 @@ def gen_custom_func_decl(out, f, typeMap):
     proto, name, r, args, core, ext = f
     if is_profile_all(name, args):
         out.write('\tcl_event profile_event = NULL;\n')
+        out.write('\tClintProfileCommand profile_cmd;\n')
+        out.write('\tint profiled = 0;\n')
 
 
 def gen_custom_func_begin(out, f, typeMap):
@@ -420,32 +623,55 @@ def gen_custom_func_begin(out, f, typeMap):
         out.write('\tclint_opencl_enter();\n')
     if name == 'clSetKernelArg':
         out.write('\tclint_kernel_enter(%s);\n' % args[0][1])
-    if ('Image' in name or 'Texture' in name) and not name in ('clGetSupportedImageFormats',):
-        check = 'clint_get_config(CLINT_DISABLE_IMAGE)'
-        if '3D' in name:
-            check += ' || clint_get_config(CLINT_EMBEDDED)'
-        elif name == 'clCreateImage':
-            check += ' || (clint_get_config(CLINT_EMBEDDED) && (%s & CL_MEM_OBJECT_IMAGE3D) != 0)' % args[1][1]
-        out.write('\tif (%s) {\n' % check)
-        if r == 'cl_int':
-            out.write('\t\tretval = CL_INVALID_OPERATION;\n')
-        else:
-            out.write('\t\t*%s = CL_INVALID_OPERATION;\n' % args[-1][1])
-            out.write('\t\tretval = NULL;\n')
-        out.write('\t} else /* okay to call real function */\n')
+    if name == 'clReleaseCommandQueue':
+        out.write('\tif (clint_get_config(CLINT_PROFILE_MARKERS))\n')
+        out.write('\t\tclint_markers_release(%s);\n' % args[0][1])
+    if name == 'clReleaseKernel':
+        out.write('\tif (clint_get_config(CLINT_PROFILE))\n')
+        out.write('\t\tclint_kernels_release(%s);\n' % args[0][1])
     if is_profile_all(name, args):
-        config_value = 'CLINT_PROFILE_ALL'
+        transfer = gen_profile_transfer(name, args)
+        config_value = 'clint_get_config(CLINT_PROFILE_ALL)'
         if name in profile_funcs:
-            config_value = 'CLINT_PROFILE'
+            config_value = 'clint_get_config(CLINT_PROFILE)'
+        elif transfer or name == 'clEnqueueUnmapMemObject':
+            # Frames report the bytes transferred, which needs the transfers profiled.
+            config_value += ' || clint_get_config(CLINT_PROFILE_FRAME)'
         arg = filter(lambda a: a[0] == 'cl_event *', args)[-1]
-        out.write('\tif (clint_get_config(%s)) {\n' % config_value)
-        out.write('\t\tif (%s == NULL) %s = &profile_event;\n' % (arg[1], arg[1]))
+        queue = filter(lambda a: a[0] == 'cl_command_queue', args)
+        queue = (queue and queue[0][1]) or 'NULL'
+        kernel = filter(lambda a: a[0] == 'cl_kernel', args)
+        kernel = (kernel and kernel[0][1]) or 'NULL'
+        out.write('\tif (clint_get_config(CLINT_PROFILE_FRAME))\n')
+        out.write('\t\tclint_frame_enqueue(clint_frame_current(), %s);\n' %
+                  ((kernel != 'NULL' and kernel + ' != NULL') or (name in profile_funcs and '1') or '0'))
+        out.write('\tif (%s) {\n' % config_value)
+        out.write('\t\tprofiled = clint_profile_begin(&profile_cmd, "%s", %s, %s);\n' % (name, queue, kernel))
+        out.write('\t\tif (profiled && %s == NULL) %s = &profile_event;\n' % (arg[1], arg[1]))
+        if name == 'clEnqueueUnmapMemObject':
+            # Unmapping a writable mapping is what moves its data to the device.
+            out.write('\t\tif (profiled)\n')
+            out.write('\t\t\tclint_profile_unmap(&profile_cmd, %s, %s);\n' % (args[1][1], args[2][1]))
+        elif transfer:
+            out.write('\t\tif (profiled)\n')
+            out.write('\t\t\tclint_profile_transfer(&profile_cmd, %s, %s);\n' % transfer)
+        if name == 'clEnqueueNDRangeKernel':
+            out.write('\t\tif (profiled)\n')
+            out.write('\t\t\tclint_profile_ndrange(&profile_cmd, %s, %s, %s);\n' % (args[2][1], args[4][1], args[5][1]))
         out.write('\t}\n')
+    queue = filter(lambda a: a[0] == 'cl_command_queue', args)
+    if has_prefix(name, 'clEnqueue') and queue:
+        kernel = filter(lambda a: a[0] == 'cl_kernel', args)
+        kernel = (kernel and kernel[0][1]) or 'NULL'
+        out.write('\tif (clint_get_config(CLINT_PROFILE_WAIT))\n')
+        out.write('\t\tclint_wait_enqueued(%s, "%s", %s);\n' % (queue[0][1], name, kernel))
     if has_prefix(name, 'clCreate') and 'CommandQueue' in name:
         arg = filter(lambda a: a[0] == 'cl_command_queue_properties', args)
         if arg:
             arg = arg[-1]
-            out.write('\tif (clint_get_config(CLINT_PROFILE))\n')
+            # CLINT_CONTROL may turn profiling on later, for queues created now.
+            out.write('\tif (clint_get_config(CLINT_PROFILE) || clint_get_config(CLINT_PROFILE_MARKERS) ||\n')
+            out.write('\t    clint_get_config(CLINT_CONTROL))\n')
             out.write('\t\t%s |= CL_QUEUE_PROFILING_ENABLE;\n' % arg[1])
     if has_prefix(name, 'clEnqueueAcquire'):
         sharing = gen_mem_sharing(name)
@@ -471,8 +697,30 @@ def gen_custom_func_begin(out, f, typeMap):
         out.write('\tclint_release_shared_mems(%s, %s, %s);\n' % (args[1][1], args[2][1], sharing))
 
 
+def gen_custom_func_guard(out, f, typeMap):
+    """Skip the real function.  Returns True if the call must be wrapped in an else block."""
+    proto, name, r, args, core, ext = f
+    if ('Image' in name or 'Texture' in name) and not name in ('clGetSupportedImageFormats',):
+        check = 'clint_get_config(CLINT_DISABLE_IMAGE)'
+        if '3D' in name:
+            check += ' || clint_get_config(CLINT_EMBEDDED)'
+        elif name == 'clCreateImage':
+            check += ' || (clint_get_config(CLINT_EMBEDDED) && (%s & CL_MEM_OBJECT_IMAGE3D) != 0)' % args[1][1]
+        out.write('\tif (%s) {\n' % check)
+        if r == 'cl_int':
+            out.write('\t\tretval = CL_INVALID_OPERATION;\n')
+        else:
+            out.write('\t\t*%s = CL_INVALID_OPERATION;\n' % args[-1][1])
+            out.write('\t\tretval = NULL;\n')
+        out.write('\t} else { /* okay to call real function */\n')
+        return True
+    return False
+
+
 def gen_custom_func_exit(out, f, typeMap):
     proto, name, r, args, core, ext = f
+    if is_wait(name, args):
+        gen_wait(out, f)
     if 'Create' in name or 'Retain' in name or 'Release' in name:
         out.write('\tclint_opencl_exit();\n')
     if name == 'clSetKernelArg':
@@ -495,6 +743,9 @@ def gen_custom_func_exit(out, f, typeMap):
             out.write('\t%s = clint_retain_map(%s, %s, %s, %s);\n' % (arg2[1], arg0[1], arg1[1], arg2[1], arg3[1]))
         out.write('\tif (clint_get_config(CLINT_CHECK_MAPPING))\n\t\t%s = CL_TRUE;\n' %
                   filter(lambda a: a[0] == 'cl_bool', args)[-1][1])
+        out.write('\tif (profiled && %s == CL_SUCCESS && (%s & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)) != 0)\n' %
+                  (gen_func_errcode(f), arg1[1]))
+        out.write('\t\tclint_profile_map(&profile_cmd, %s, %s);\n' % (arg0[1], arg2[1]))
     if name in ('clGetPlatformInfo', 'clGetDeviceInfo'):
         if name == 'clGetPlatformInfo':
             param_name = 'CL_PLATFORM_EXTENSIONS'
@@ -543,15 +794,23 @@ def gen_custom_func_exit(out, f, typeMap):
             out.write('\t\t\tbreak;\n')
             out.write('\t\t}\n')
             out.write('\t}\n')
+    if name in ('clCreateKernel', 'clCloneKernel'):
+        out.write('\tif (clint_get_config(CLINT_PROFILE) && retval != NULL)\n')
+        out.write('\t\tclint_kernels_add(retval);\n')
+    if name == 'clCreateKernelsInProgram':
+        out.write('\tif (clint_get_config(CLINT_PROFILE) && retval == CL_SUCCESS && %s != NULL)\n' % args[3][1])
+        out.write('\t\tclint_kernels_add_all(*%s, %s);\n' % (args[3][1], args[2][1]))
     if is_profile_all(name, args):
-        config_value = 'CLINT_PROFILE_ALL'
-        if name in profile_funcs:
-            config_value = 'CLINT_PROFILE'
         arg = filter(lambda a: a[0] == 'cl_event *', args)[-1]
-        out.write('\tif (clint_get_config(%s))\n' % config_value)
-        out.write('\t\t%s = clint_log_profile("%s", *%s);\n' % (gen_func_errcode(f), name, arg[1]))
+        errcode = gen_func_errcode(f)
+        out.write('\tif (profiled && %s == CL_SUCCESS)\n' % errcode)
+        out.write('\t\t%s = clint_profile_end(&profile_cmd, *%s);\n' % (errcode, arg[1]))
         out.write('\tif (profile_event != NULL)\n')
         out.write('\t\tCLINTFUNC(clReleaseEvent)(profile_event);\n')
+        queue = filter(lambda a: a[0] == 'cl_command_queue', args)
+        if queue:
+            out.write('\tif (clint_get_config(CLINT_PROFILE_MARKERS) && %s == CL_SUCCESS)\n' % errcode)
+            out.write('\t\tclint_markers_enqueued(%s);\n' % queue[0][1])
 
 
 def gen_func(out, f, typeMap, funcs=[]):
@@ -570,7 +829,7 @@ def gen_func(out, f, typeMap, funcs=[]):
     proto = pat_suffix.sub('', proto)
     proto = proto.replace(name, 'F(%s)' % name)
 
-    fmt = name + '(' + string.join(map(lambda a: a[1] + '=' + gen_format_str(a[0], typeMap, name, 0), args), ", ") + ')'
+    fmt, ret = gen_func_formats(f, typeMap)
     call_args = string.join(map(lambda a: a[1], args), ", ")
     out.write(proto[:-1] + "\n")
     out.write('{\n')
@@ -580,12 +839,23 @@ def gen_func(out, f, typeMap, funcs=[]):
     do_errcode = gen_func_has_errcode(f)
     if r != 'cl_int' and do_errcode:
         out.write('\tcl_int errcode_local;\n')
+    out.write('\tcl_ulong api_time[3] = {0, 0, 0};\n')
     gen_custom_func_decl(out, f, typeMap)
     out.write('\tclint_init();\n')
+    if is_wait(name, args):
+        out.write('\tif (clint_get_config(CLINT_PROFILE_API) || clint_get_config(CLINT_PROFILE_TIMELINE) ||\n')
+        out.write('\t    clint_get_config(CLINT_PROFILE_WAIT))\n')
+    else:
+        out.write('\tif (clint_get_config(CLINT_PROFILE_API) || clint_get_config(CLINT_PROFILE_TIMELINE))\n')
+    out.write('\t\tapi_time[0] = clint_time_now();\n')
     out.write('\tclint_autopool_begin(&pool);\n')
-    out.write('\tif (clint_get_config(CLINT_TRACE))\n')
-    out.write('\t\tclint_log(%s);\n' % string.join(
+    out.write('\tCLINT_SHM_CALL(ClintFunc_%s);\n' % name)
+    if name in ('clEnqueueNDRangeKernel', 'clEnqueueTask'):
+        out.write('\tif (CLINT_FILTER(ClintFunc_%s, CLINT_FILTER_LAUNCH))\n' % name)
+        out.write('\t\tclint_filter_launch(%s);\n' % filter(lambda a: a[0] == 'cl_kernel', args)[0][1])
+    gen_trace_log(out, name, string.join(
         ['"%s\\n"' % fmt] + map(lambda a: gen_format_arg(a[0], a[1], typeMap, name, 0), args), ", "))
+    gen_trace(out, name, 'ClintTrace_call', map(lambda a: gen_trace_field(a[0], a[1], typeMap, name, 0), args))
     for a in args:
         check = gen_check_input_arg(a, args, name)
         if check:
@@ -597,6 +867,8 @@ def gen_func(out, f, typeMap, funcs=[]):
         call_str = 'CLINTFUNC(%s)' % name
     else:
         call_str = '((%s)CLINTFUNC(%s)("%s"))' % (typedef_name(name), 'clGetExtensionFunctionAddress', name)
+    call = '\tif (api_time[0] != 0)\n'
+    call += '\t\tapi_time[1] = clint_time_now();\n'
     if name in ['clGetExtensionFunctionAddress', 'clGetExtensionFunctionAddressForPlatform']:
         addr_str = '\tif (!func_name)\n'
         addr_str += '\t\tretval = NULL;\n'
@@ -604,33 +876,39 @@ def gen_func(out, f, typeMap, funcs=[]):
             if func[5] and 'FunctionAddress' not in func[1]:
                 addr_str += '\telse if (strcmp(func_name, "%s") == 0)\n' % func[1]
                 addr_str += '\t\tretval = F(%s);\n' % func[1]
+        for func in ['clintPushRangeCLINT', 'clintPopRangeCLINT', 'clintMarkerCLINT']:
+            addr_str += '\telse if (strcmp(func_name, "%s") == 0)\n' % func
+            addr_str += '\t\tretval = (void*)&%s;\n' % func
         addr_str += '\telse\n'
         addr_str += '\t\tretval = %s(%s);\n' % (call_str, call_args)
-        out.write(addr_str)
+        call += addr_str
     elif r == 'void':
-        out.write('\t%s(%s);' % (call_str, call_args))
+        call += '\t%s(%s);\n' % (call_str, call_args)
+    else:
+        call += '\tretval = %s(%s);\n' % (call_str, call_args)
+    call += '\tif (api_time[0] != 0)\n'
+    call += '\t\tapi_time[2] = clint_time_now();\n'
+    if gen_custom_func_guard(out, f, typeMap):
+        out.write(string.join(map(lambda l: '\t' + l + '\n', call.splitlines()), ''))
+        out.write('\t}\n')
     else:
-        out.write('\tretval = %s(%s);\n' % (call_str, call_args))
+        out.write(call)
     gen_custom_func_exit(out, f, typeMap)
+    gen_shm_counters(out, f)
     if do_errcode:
         errcode = gen_func_errcode(f)
         out.write('\tif (%s != CL_SUCCESS && clint_get_config(CLINT_ERRORS)) {\n' % errcode)
+        out.write('\t\tif (clint_get_config(CLINT_TRACE_LOOPS))\n')
+        out.write('\t\t\tclint_loop_flush();\n')
         out.write('\t\tclint_log("ERROR in %s: %%s\\n", clint_string_error(%s));\n' % (name, errcode))
         out.write('\t\tclint_log_abort();\n')
         out.write('\t}\n')
-    if r != 'void' or args:
-        out_args = filter(
-            lambda x: '*' in x[0] and (not 'const' in x[0]) and (not pat_void.match(x[0])) and (x[1] != 'errcode_ret'),
-            args)
-        if r != 'void':
-            out_args = [(r, 'retval')] + out_args
-        out_fmt = name + ' returned ' + string.join(map(
-            lambda a: ((a[1] == 'retval') and gen_format_str(a[0], typeMap, name, 1)) or (
-            a[1] + '=' + gen_format_str(string.strip(a[0][:-1]), typeMap, name, 1)), out_args), " ")
-        out.write('\tif (clint_get_config(CLINT_TRACE))\n')
-        out.write('\t\tclint_log(%s);\n' % string.join(['"%s\\n"' % out_fmt] + map(
+    if ret:
+        out_fmt, out_args = ret
+        gen_trace_log(out, name, string.join(['"%s\\n"' % out_fmt] + map(
             lambda a: ((a[1] == 'retval') and 'retval') or gen_format_arg(a[0], a[1], typeMap, name, 1), out_args),
-                                                       ", "))
+                                             ", "))
+        gen_trace(out, name, 'ClintTrace_return', map(lambda a: gen_trace_field(a[0], a[1], typeMap, name, 1), out_args))
     checks = ''
     if do_errcode:
         indent = '\t\t'
@@ -650,6 +928,10 @@ def gen_func(out, f, typeMap, funcs=[]):
             out.write(checks)
             out.write('\t}\n')
     out.write('\tclint_autopool_end(&pool);\n')
+    out.write('\tif (api_time[0] != 0 && (clint_get_config(CLINT_PROFILE_API) || clint_get_config(CLINT_PROFILE_TIMELINE)))\n')
+    out.write('\t\tclint_api_record(ClintFunc_%s, api_time);\n' % name)
+    out.write('\tif (clint_get_config(CLINT_PROFILE_FRAME))\n')
+    out.write('\t\tclint_frame_call(ClintFunc_%s);\n' % name)
     if r != 'void':
         out.write('\treturn retval;\n')
     out.write('}\n')
@@ -807,10 +1089,97 @@ def gen_type_header(file, typeMap, typeIncludes):
     file.write('\n#endif\n')
 
 
+# Largest run of unused values allowed inside one name table.
+gen_enum_table_gap = 8
+# Smallest number of names worth a table rather than switch cases.
+gen_enum_table_min = 4
+
+def gen_enum_value(expr):
+    expr = re.sub(r'\b(0[xX][0-9a-fA-F]+|[0-9]+)[uUlL]+\b', r'\1', expr)
+    if not re.match(r'^[-+~|&()<> 0-9a-fA-FxX]+$', expr):
+        return None
+    try:
+        return int(eval(expr, {}, {}))
+    except:
+        return None
+
+def gen_enum_tables(values):
+    # Group the values into dense runs; the caller turns long runs into
+    # name tables indexed by value and leaves the rest to a switch.
+    known = []
+    seen = set()
+    for i in values:
+        n = gen_enum_value(i[1])
+        if n is None:
+            return [], values
+        if n in seen:
+            continue
+        seen.add(n)
+        known.append((n, i))
+    known.sort()
+    runs = []
+    for v in known:
+        if runs and v[0] - runs[-1][-1][0] <= gen_enum_table_gap:
+            runs[-1].append(v)
+        else:
+            runs.append([v])
+    tables = []
+    cases = []
+    for run in runs:
+        if len(run) >= gen_enum_table_min:
+            tables.append(run)
+        else:
+            cases += [i for n, i in run]
+    return tables, cases
+
+def gen_enum_source(file, t, values):
+    name = gen_type_name(t)
+    tables, cases = gen_enum_tables(values)
+    for k in range(len(tables)):
+        run = tables[k]
+        names = dict(run)
+        file.write('static const char *const clint_names_%s_%d[] = {\n' % (name, k))
+        for n in range(run[0][0], run[-1][0] + 1):
+            if n in names:
+                file.write('\t"%s", /* %s */\n' % names[n])
+            else:
+                file.write('\tNULL,\n')
+        file.write('};\n\n')
+    file.write('const char *clint_string_%s(%s v)\n' % (name, gen_type_arg(t)))
+    file.write('{\n')
+    for k in range(len(tables)):
+        run = tables[k]
+        index = '(cl_ulong)((cl_long)v - (cl_long)%s)' % run[0][1][0]
+        file.write('\tif (%s < %d && clint_names_%s_%d[%s] != NULL)\n' % (index, run[-1][0] - run[0][0] + 1, name, k, index))
+        file.write('\t\treturn clint_names_%s_%d[%s];\n' % (name, k, index))
+    if cases:
+        file.write('\tswitch (v) {\n')
+        for i in cases:
+            file.write('\tcase %s: /* %s */\n' % i)
+            file.write('\t\treturn "%s";\n' % i[0])
+        file.write('\tdefault:\n')
+        file.write('\t\tbreak;\n')
+        file.write('\t}\n')
+    file.write('\treturn clint_string_sprintf("Unknown %s 0x%%X", (unsigned int)v);\n' % t)
+    file.write('}\n\n')
+
+def gen_bitfield_source(file, t, values):
+    name = gen_type_name(t)
+    file.write('static const ClintBitName clint_bits_%s[] = {\n' % name)
+    for i in values:
+        file.write('\t{%s, "%s"}, /* %s */\n' % (i[0], i[0], i[1]))
+    file.write('};\n\n')
+    file.write('const char *clint_string_%s(%s v)\n' % (name, gen_type_arg(t)))
+    file.write('{\n')
+    file.write('\treturn clint_string_bits((cl_ulong)v, clint_bits_%s, %d, "%s");\n' % (name, len(values), t))
+    file.write('}\n\n')
+
 def gen_type_source(file, typeMap):
     gen_top(file)
     file.write('#include "clint_opencl_types.h"\n')
     file.write('\n')
+    file.write('#include <string.h>\n')
+    file.write('\n')
     file.write('#ifdef __APPLE__\n')
     file.write('\n')
     file.write('#include <OpenCL/cl_gl.h>\n')
@@ -827,36 +1196,54 @@ def gen_type_source(file, typeMap):
     file.write('\n')
     gen_prefix(file)
     file.write('\n')
+    file.write('typedef struct ClintBitName {\n')
+    file.write('\tcl_ulong mask;\n')
+    file.write('\tconst char *name;\n')
+    file.write('} ClintBitName;\n')
+    file.write('\n')
+    file.write('static const char *clint_string_bits(cl_ulong v, const ClintBitName *bits, size_t count, const char *type)\n')
+    file.write('{\n')
+    file.write('\tconst char *found[64];\n')
+    file.write('\tsize_t lens[64];\n')
+    file.write('\tsize_t num = 0, size = 1, i;\n')
+    file.write('\tcl_ulong v0 = v;\n')
+    file.write('\tchar *buf, *p;\n')
+    file.write('\tif (v == 0)\n')
+    file.write('\t\treturn "0";\n')
+    file.write('\tfor (i = 0; i < count && v != 0; i++) {\n')
+    file.write('\t\tif ((v & bits[i].mask) != 0) {\n')
+    file.write('\t\t\tv &= ~bits[i].mask;\n')
+    file.write('\t\t\tfound[num] = bits[i].name;\n')
+    file.write('\t\t\tlens[num] = strlen(bits[i].name);\n')
+    file.write('\t\t\tsize += lens[num++] + 3;\n')
+    file.write('\t\t}\n')
+    file.write('\t}\n')
+    file.write('\tif (v != 0)\n')
+    file.write('\t\treturn clint_string_sprintf("Unknown %s 0x%X", type, (unsigned int)v0);\n')
+    file.write('\tif (num == 1)\n')
+    file.write('\t\treturn found[0];\n')
+    file.write('\tbuf = p = (char*)clint_autopool_malloc(size);\n')
+    file.write('\tfor (i = 0; i < num; i++) {\n')
+    file.write('\t\tif (i > 0) {\n')
+    file.write('\t\t\tmemcpy(p, " | ", 3);\n')
+    file.write('\t\t\tp += 3;\n')
+    file.write('\t\t}\n')
+    file.write('\t\tmemcpy(p, found[i], lens[i]);\n')
+    file.write('\t\tp += lens[i];\n')
+    file.write('\t}\n')
+    file.write('\t*p = 0;\n')
+    file.write('\treturn buf;\n')
+    file.write('}\n')
+    file.write('\n')
     types = typeMap.keys()
     types.sort()
     for t in types:
         if t in gen_format_struct_map:
             continue
-        file.write('const char *clint_string_%s(%s v)\n' % (gen_type_name(t), gen_type_arg(t)))
-        file.write('{\n')
         if typeMap[t] and ('<<' in typeMap[t][0][1]):
-            # bitfield
-            file.write('\tconst char *s = "";\n')
-            file.write('\t%s v0 = v;\n' % gen_type_arg(t))
-            file.write('\tif (v == 0)\n')
-            file.write('\t\treturn "0";\n')
-            for i in typeMap[t]:
-                file.write('\tif ((v & %s) != 0) { /* %s */\n' % i)
-                file.write('\t\tv &= ~(%s);\n' % i[0])
-                file.write('\t\ts = clint_string_join(s, "%s", " | ");\n' % i[0])
-                file.write('\t}\n')
-            file.write('\tif (v != 0)\n')
-            file.write('\t\treturn clint_string_sprintf("Unknown %s 0x%%X", (unsigned int)v0);\n' % t)
-            file.write('\treturn s;\n')
+            gen_bitfield_source(file, t, typeMap[t])
         else:
-            file.write('\tswitch (v) {\n')
-            for i in typeMap[t]:
-                file.write('\tcase %s: /* %s */\n' % i)
-                file.write('\t\treturn "%s";\n' % i[0])
-            file.write('\tdefault:\n')
-            file.write('\t\treturn clint_string_sprintf("Unknown %s 0x%%X", (unsigned int)v);\n' % t)
-            file.write('\t}\n')
-        file.write('}\n\n')
+            gen_enum_source(file, t, typeMap[t])
     types = typeMap.keys()
     types.sort()
     for t in types:
@@ -875,6 +1262,59 @@ def gen_type_source(file, typeMap):
     gen_postfix(file)
 
 
+def gen_real_func_lookup(file, funcs):
+    file.write('void *clint_opencl_func(const char *name)\n')
+    file.write('{\n')
+    file.write('\tclint_init();\n')
+    file.write('\tif (!name)\n')
+    file.write('\t\treturn NULL;\n')
+    for f in funcs:
+        if f[4]:
+            file.write('\telse if (strcmp(name, "%s") == 0)\n' % f[1])
+            file.write('\t\treturn (void*)CLINTFUNC(%s);\n' % f[1])
+    file.write('\telse if (clint_dll != NULL)\n')
+    file.write('\t\treturn clint_opencl_sym(clint_dll, name);\n')
+    file.write('\treturn NULL;\n')
+    file.write('}\n')
+    file.write('\n')
+
+
+def gen_func_names(file, funcs):
+    file.write('static const char *clint_func_names[] = {\n')
+    for f in funcs:
+        file.write('\t"%s",\n' % f[1])
+    file.write('};\n')
+    file.write('\n')
+    file.write('const char *clint_func_name(ClintFunc func)\n')
+    file.write('{\n')
+    file.write('\tif (func < 0 || func >= ClintFunc_max)\n')
+    file.write('\t\treturn NULL;\n')
+    file.write('\treturn clint_func_names[func];\n')
+    file.write('}\n')
+    file.write('\n')
+
+
+def gen_func_header(file, funcs):
+    file.write('#ifndef _CLINT_OPENCL_FUNCS_H_\n')
+    file.write('#define _CLINT_OPENCL_FUNCS_H_\n')
+    file.write('\n')
+    gen_top(file)
+    file.write('\n')
+    gen_prefix(file)
+    file.write('\n')
+    file.write('typedef enum ClintFunc {\n')
+    for f in funcs:
+        file.write('\tClintFunc_%s,\n' % f[1])
+    file.write('\tClintFunc_max\n')
+    file.write('} ClintFunc;\n')
+    file.write('\n')
+    file.write('const char *clint_func_name(ClintFunc func);\n')
+    file.write('\n')
+    gen_postfix(file)
+    file.write('\n')
+    file.write('#endif\n')
+
+
 def gen_func_source(file, funcs, typeMap):
     file.write('#define CL_USE_DEPRECATED_OPENCL_1_0_APIS\n')
     file.write('#define CL_USE_DEPRECATED_OPENCL_1_1_APIS\n')
@@ -891,6 +1331,18 @@ def gen_func_source(file, funcs, typeMap):
     file.write('#include "clint_config.h"\n')
     file.write('#include "clint_obj.h"\n')
     file.write('#include "clint_opencl_types.h"\n')
+    file.write('#include "clint_profile.h"\n')
+    file.write('#include "clint_annotate.h"\n')
+    file.write('#include "clint_api.h"\n')
+    file.write('#include "clint_filter.h"\n')
+    file.write('#include "clint_frame.h"\n')
+    file.write('#include "clint_loop.h"\n')
+    file.write('#include "clint_markers.h"\n')
+    file.write('#include "clint_shm.h"\n')
+    file.write('#include "clint_stack.h"\n')
+    file.write('#include "clint_time.h"\n')
+    file.write('#include "clint_trace.h"\n')
+    file.write('#include "clint_wait.h"\n')
     file.write('\n')
     file.write('#include <string.h>\n')
     file.write('\n')
@@ -918,24 +1370,6 @@ def gen_func_source(file, funcs, typeMap):
     file.write('\n')
     file.write('#define CLINTFUNC(a) clint_##a##_ptr\n')
     file.write('\n')
-    file.write('static cl_int clint_log_profile(const char *name, cl_event event)\n')
-    file.write('{\n')
-    file.write('\tcl_ulong start, end;\n')
-    file.write('\tcl_int err;\n')
-    file.write('\tdouble elapsed;\n')
-    file.write('\terr = CLINTFUNC(clWaitForEvents)(1, &event);\n')
-    file.write('\tif (err) return err;\n')
-    file.write(
-        '\terr = CLINTFUNC(clGetEventProfilingInfo)(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);\n')
-    file.write('\tif (err) return err;\n')
-    file.write(
-        '\terr = CLINTFUNC(clGetEventProfilingInfo)(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);\n')
-    file.write('\tif (err) return err;\n')
-    file.write('\telapsed = (double)(end - start) * 1.0e-9;\n')
-    file.write('\tclint_log("PROFILE: %s %f\\n", name, elapsed);\n')
-    file.write('\treturn err;\n')
-    file.write('}\n')
-    file.write('\n')
     file.write('static void* clint_dll = NULL;\n')
     file.write('static void clint_init(void)\n')
     file.write('{\n')
@@ -951,6 +1385,8 @@ def gen_func_source(file, funcs, typeMap):
     file.write('\t}\n')
     file.write('}\n')
     file.write('\n')
+    gen_real_func_lookup(file, funcs)
+    gen_func_names(file, funcs)
     # clGetExtensionFunctionAddress needs to be defined last.
     for f in funcs:
         if 'FunctionAddress' not in f[1]:
@@ -972,6 +1408,138 @@ def gen_func_source(file, funcs, typeMap):
     gen_postfix(file)
 
 
+def gen_decode_fields(out, fmt, fields, indent):
+    """Writes the reads of fields from p and the return of their text trace."""
+    args = []
+    for i, (kind, ctype, value, func) in enumerate(fields):
+        if kind == 'struct':
+            out.write('%s\t%s a%d;\n' % (indent, ctype, i))
+            out.write('%s\tconst %s *p%d = NULL;\n' % (indent, ctype, i))
+            args.append('%s(p%d)' % (func, i))
+        elif kind == 'string':
+            out.write('%s\tchar a%d[CLINT_TRACE_MAX_STRING + 1];\n' % (indent, i))
+            out.write('%s\tconst char *p%d;\n' % (indent, i))
+            args.append('%s(p%d)' % (func, i))
+        elif kind == 'pointer':
+            out.write('%s\tcl_ulong a%d;\n' % (indent, i))
+            args.append('(void*)(size_t)a%d' % i)
+        else:
+            out.write('%s\t%s a%d;\n' % (indent, ctype, i))
+            if func:
+                args.append('%s(a%d)' % (func, i))
+            else:
+                args.append('a%d' % i)
+    for i, (kind, ctype, value, func) in enumerate(fields):
+        if kind == 'struct':
+            out.write('%s\tif (*p++) {\n' % indent)
+            out.write('%s\t\tmemcpy(&a%d, p, sizeof(a%d));\n' % (indent, i, i))
+            out.write('%s\t\tp += sizeof(a%d);\n' % (indent, i))
+            out.write('%s\t\tp%d = &a%d;\n' % (indent, i, i))
+            out.write('%s\t}\n' % indent)
+        elif kind == 'string':
+            out.write('%s\tp = clint_decode_string(p, a%d, &p%d);\n' % (indent, i, i))
+        elif kind == 'pointer':
+            out.write('%s\tCLINT_TRACE_GET(p, cl_ulong, a%d);\n' % (indent, i))
+        else:
+            out.write('%s\tCLINT_TRACE_GET(p, %s, a%d);\n' % (indent, ctype, i))
+    out.write('%s\treturn clint_string_sprintf(%s);\n' % (indent, string.join(['"%s\\n"' % fmt] + args, ", ")))
+
+
+def gen_decode_func(out, f, typeMap):
+    proto, name, r, args, core, ext = f
+    fmt, ret = gen_func_formats(f, typeMap)
+    out.write('static const char *clint_decode_%s(ClintTraceKind kind, const unsigned char *p)\n' % name)
+    out.write('{\n')
+    out.write('\tif (kind == ClintTrace_call) {\n')
+    gen_decode_fields(out, fmt, map(lambda a: gen_trace_field(a[0], a[1], typeMap, name, 0), args), '\t')
+    out.write('\t}\n')
+    if ret:
+        out_fmt, out_args = ret
+        out.write('\tif (kind == ClintTrace_return) {\n')
+        gen_decode_fields(out, out_fmt, map(lambda a: gen_trace_field(a[0], a[1], typeMap, name, 1), out_args), '\t')
+        out.write('\t}\n')
+    out.write('\treturn NULL;\n')
+    out.write('}\n')
+    out.write('\n')
+
+
+def gen_decode_source(file, funcs, typeMap):
+    gen_top(file)
+    file.write('#include "clint_opencl_funcs.h"\n')
+    file.write('#include "clint_opencl_types.h"\n')
+    file.write('#include "clint_trace.h"\n')
+    file.write('\n')
+    file.write('#include <string.h>\n')
+    file.write('\n')
+    gen_prefix(file)
+    file.write('\n')
+    file.write('static const unsigned char *clint_decode_string(const unsigned char *p, char *buf, const char **s)\n')
+    file.write('{\n')
+    file.write('\tsize_t len = *p++;\n')
+    file.write('\tif (len == CLINT_TRACE_NULL_STRING) {\n')
+    file.write('\t\t*s = NULL;\n')
+    file.write('\t\treturn p;\n')
+    file.write('\t}\n')
+    file.write('\tif (len > CLINT_TRACE_MAX_STRING)\n')
+    file.write('\t\tlen = CLINT_TRACE_MAX_STRING;\n')
+    file.write('\tmemcpy(buf, p, len);\n')
+    file.write('\tbuf[len] = 0;\n')
+    file.write('\t*s = buf;\n')
+    file.write('\treturn p + len;\n')
+    file.write('}\n')
+    file.write('\n')
+    for f in funcs:
+        gen_decode_func(file, f, typeMap)
+    file.write('const char *clint_decode_record(int func, ClintTraceKind kind, const unsigned char *args)\n')
+    file.write('{\n')
+    file.write('\tswitch (func) {\n')
+    for f in funcs:
+        file.write('\tcase ClintFunc_%s:\n' % f[1])
+        file.write('\t\treturn clint_decode_%s(kind, args);\n' % f[1])
+    file.write('\tdefault:\n')
+    file.write('\t\treturn NULL;\n')
+    file.write('\t}\n')
+    file.write('}\n')
+    file.write('\n')
+    gen_postfix(file)
+
+
+def gen_analyze_func(out, f):
+    proto, name, r, args, core, ext = f
+    obj = shm_object_type(name)
+    kind = 'none'
+    if obj and has_prefix(name, 'clCreate') and r != 'cl_int':
+        kind = 'create'
+    elif obj and has_prefix(name, 'clRetain'):
+        kind = 'retain'
+    elif obj and has_prefix(name, 'clRelease'):
+        kind = 'release'
+    kernel = []
+    if name in profile_funcs:
+        kernel = filter(lambda a: a[0] == 'cl_kernel', args)
+    elif r == 'cl_kernel':
+        kernel = filter(lambda a: a[0] == 'const char *', args)
+    out.write('\t{"%s", ClintAnalyze_%s, %s, %s},\n' % (
+        name, kind, (obj and 'ClintShmObject_' + obj) or '-1', (kernel and '"%s="' % kernel[0][1]) or 'NULL'))
+
+
+def gen_analyze_source(file, funcs):
+    gen_top(file)
+    file.write('#include "clint_opencl_funcs.h"\n')
+    file.write('#include "clint_analyze.h"\n')
+    file.write('#include "clint_shm.h"\n')
+    file.write('\n')
+    gen_prefix(file)
+    file.write('\n')
+    file.write('const ClintAnalyzeFunc g_clint_analyze_funcs[] = {\n')
+    for f in funcs:
+        gen_analyze_func(file, f)
+    file.write('\t{NULL, ClintAnalyze_none, -1, NULL}\n')
+    file.write('};\n')
+    file.write('\n')
+    gen_postfix(file)
+
+
 funcs = []
 typeMap = {}
 typeIncludes = []
@@ -1013,6 +1581,18 @@ if base:
     out = open(os.path.join(base, 'clint_opencl_types.c'), 'w')
 gen_type_source(out, typeMap)
 
+if base:
+    out = open(os.path.join(base, 'clint_opencl_funcs.h'), 'w')
+gen_func_header(out, funcs)
+
 if base:
     out = open(os.path.join(base, 'clint_opencl_funcs.c'), 'w')
 gen_func_source(out, funcs, typeMap)
+
+if base:
+    out = open(os.path.join(base, 'clint_opencl_decode.c'), 'w')
+gen_decode_source(out, funcs, typeMap)
+
+if base:
+    out = open(os.path.join(base, 'clint_opencl_analyze.c'), 'w')
+gen_analyze_source(out, funcs)
@@ -0,0 +1,65 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* cl_CLINT_debugging: annotate the application for CLIntercept's profiling.
+   Get the functions with clGetExtensionFunctionAddress(ForPlatform).  They are
+   no-ops unless CLINT_PROFILE (or an option implying it) is set.
+
+     clintPushRangeCLINT_fn push = (clintPushRangeCLINT_fn)
+       clGetExtensionFunctionAddressForPlatform(platform, "clintPushRangeCLINT");
+     if (push) push("frame 42");
+*/
+
+#ifndef _CL_CLINT_H_
+#define _CL_CLINT_H_
+
+#ifdef __APPLE__
+#include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define cl_CLINT_debugging 1
+
+/* Commands enqueued by this thread until the matching pop are attributed to
+   the range.  Ranges nest; names are copied. */
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clintPushRangeCLINT_fn)(const char *name);
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clintPopRangeCLINT_fn)(void);
+
+/* Log an instant event with the host time. */
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clintMarkerCLINT_fn)(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CL_CLINT_H_
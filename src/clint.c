@@ -33,9 +33,24 @@
 #include "clint.h"
 #include "clint_atomic.h"
 #include "clint_config.h"
+#include "clint_control.h"
 #include "clint_data.h"
 #include "clint_log.h"
 #include "clint_obj.h"
+#include "clint_annotate.h"
+#include "clint_api.h"
+#include "clint_filter.h"
+#include "clint_frame.h"
+#include "clint_info.h"
+#include "clint_kernels.h"
+#include "clint_loop.h"
+#include "clint_markers.h"
+#include "clint_profile.h"
+#include "clint_shm.h"
+#include "clint_slo.h"
+#include "clint_timeline.h"
+#include "clint_trace.h"
+#include "clint_wait.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -204,22 +219,67 @@ void clint_opencl_init()
   }
 #endif
 
+  clint_api_init();
+  clint_annotate_init();
+  clint_wait_init();
+  clint_kernels_init();
+  clint_frame_init();
+  if (clint_get_config(CLINT_TRACE_BINARY) || clint_get_config(CLINT_FLIGHT_RECORDER)) {
+    clint_trace_init();
+  }
+  if (clint_get_config(CLINT_SHM)) {
+    clint_shm_init();
+  }
   clint_log_describe();
 
   if (clint_get_config(CLINT_INFO)) {
-    /* Don't log internally used calls */
-    int enabled = clint_get_config(CLINT_ENABLED);
-    clint_set_config(CLINT_ENABLED, 0);
-    clint_log_platforms();
-    clint_set_config(CLINT_ENABLED, enabled);
+    clint_info_start();
+  }
+  /* Last, so nothing above is traced. */
+  clint_filter_init();
+  if (clint_get_config(CLINT_CONTROL)) {
+    clint_control_init();
+  }
+}
+
+void clint_opencl_report(int final)
+{
+  if (clint_get_config(CLINT_PROFILE)) {
+    clint_profile_report(final);
+  }
+  if (clint_get_config(CLINT_PROFILE_TIMELINE)) {
+    clint_timeline_report();
+  }
+  if (clint_get_config(CLINT_PROFILE_MARKERS)) {
+    clint_markers_report(final);
+  }
+  if (clint_get_config(CLINT_PROFILE_SLO)) {
+    clint_slo_report(final);
+  }
+  if (clint_get_config(CLINT_PROFILE_FRAME)) {
+    clint_frame_report(final);
+  }
+  if (clint_get_config(CLINT_PROFILE_WAIT)) {
+    clint_wait_report(final);
+  }
+  if (clint_get_config(CLINT_PROFILE_API)) {
+    clint_api_report(final);
   }
 }
 
 void clint_opencl_shutdown()
 {
+  clint_control_shutdown();
+  clint_info_shutdown();
+  if (clint_get_config(CLINT_TRACE_LOOPS)) {
+    clint_loop_shutdown();
+  }
   if (clint_get_config(CLINT_LEAKS)) {
     clint_log_leaks_all();
   }
+  clint_opencl_report(1);
+  clint_trace_shutdown();
+  clint_shm_shutdown();
   clint_log("clint_opencl_shutdown()");
   clint_data_shutdown();
   clint_log_shutdown();
@@ -48,9 +48,14 @@ extern "C" {
 
 void clint_opencl_init();
 void clint_opencl_shutdown();
+/* Log the profiling reports enabled.  The final report, at shutdown, starts
+   their counts over and saves the baseline; otherwise this is a snapshot. */
+void clint_opencl_report(int final);
 void* clint_opencl_load(void);
 void* clint_opencl_sym(void *dll, const char *sym);
 void clint_opencl_unload(void *dll);
+/* Real OpenCL entry point, bypassing CLIntercept. */
+void* clint_opencl_func(const char *name);
 
 void clint_opencl_enter();
 void clint_opencl_exit();
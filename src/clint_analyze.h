@@ -0,0 +1,63 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_ANALYZE_H_
+#define _CLINT_ANALYZE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum ClintAnalyzeKind {
+  ClintAnalyze_none,
+  /* Returns the new object, or (nil). */
+  ClintAnalyze_create,
+  /* Returns CL_SUCCESS when the reference count changed. */
+  ClintAnalyze_retain,
+  ClintAnalyze_release
+} ClintAnalyzeKind;
+
+/* How clintanalyze reads the trace lines of a function.  Generated into
+   clint_opencl_analyze.c from the tables behind the wrappers, indexed by
+   ClintFunc. */
+typedef struct ClintAnalyzeFunc {
+  const char *name;
+  ClintAnalyzeKind kind;
+  /* The ClintShmObject created, retained or released, or -1. */
+  int object;
+  /* "kernel=" in kernel launches, "kernel_name=" in clCreateKernel, or NULL. */
+  const char *kernel;
+} ClintAnalyzeFunc;
+
+extern const ClintAnalyzeFunc g_clint_analyze_funcs[];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_ANALYZE_H_
@@ -0,0 +1,258 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_annotate.h"
+#include "clint_atomic.h"
+#include "clint_config.h"
+#include "clint_data.h"
+#include "clint_frame.h"
+#include "clint_log.h"
+#include "clint_thread.h"
+#include "clint_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CLINT_RANGE_DEPTH 64
+#define CLINT_RANGE_BUCKETS 1024
+/* Names like "frame 42" can be unbounded; fold the rest into one range. */
+#define CLINT_RANGE_MAX 4096
+
+typedef struct ClintRangeStack {
+  int depth;
+  ClintRange *ranges[CLINT_RANGE_DEPTH];
+} ClintRangeStack;
+
+static int g_clint_annotate_init = 0;
+static ClintTLS g_clint_annotate_key;
+static ClintRange *g_clint_ranges[CLINT_RANGE_BUCKETS];
+static int g_clint_range_count = 0;
+static int g_clint_range_full = 0;
+static ClintRange g_clint_range_other = { NULL, "(other)", 0, 0 };
+static ClintSpinLock g_clint_annotate_lock;
+
+void clint_annotate_init(void)
+{
+  if (g_clint_annotate_init == 0) {
+    g_clint_annotate_init = 1;
+    clint_tls_create(&g_clint_annotate_key);
+  }
+}
+
+static unsigned int clint_annotate_hash(const char *s)
+{
+  unsigned int h = 2166136261u;
+
+  while (*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+}
+
+static ClintRange *clint_annotate_intern(const char *parent, const char *name)
+{
+  ClintRange *range;
+  char *path;
+  size_t len;
+  unsigned int bucket;
+  int full = 0;
+
+  len = strlen(name) + 1;
+  if (parent != NULL)
+    len += strlen(parent) + 1;
+  path = (char*)malloc(len);
+  if (path == NULL)
+    return &g_clint_range_other;
+  if (parent != NULL) {
+    strcpy(path, parent);
+    strcat(path, "/");
+    strcat(path, name);
+  } else {
+    strcpy(path, name);
+  }
+  bucket = clint_annotate_hash(path) % CLINT_RANGE_BUCKETS;
+
+  CLINT_SPINLOCK_LOCK(g_clint_annotate_lock);
+  for (range = g_clint_ranges[bucket]; range != NULL; range = range->next) {
+    if (strcmp(range->name, path) == 0)
+      break;
+  }
+  if (range == NULL && g_clint_range_count < CLINT_RANGE_MAX) {
+    range = (ClintRange*)calloc(1, sizeof(ClintRange));
+    if (range != NULL) {
+      range->name = path;
+      path = NULL;
+      CLINT_STACK_PUSH(g_clint_ranges[bucket], range);
+      g_clint_range_count++;
+    }
+  } else if (range == NULL) {
+    /* Ranges can't be freed while commands in flight point at them. */
+    full = !g_clint_range_full;
+    g_clint_range_full = 1;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_annotate_lock);
+  if (full)
+    clint_log("Ranges: more than %d distinct names, e.g. \"%s\"; the rest are counted as \"(other)\".\n",
+              CLINT_RANGE_MAX, path);
+  free(path);
+  return (range != NULL) ? range : &g_clint_range_other;
+}
+
+static ClintRangeStack *clint_annotate_stack(void)
+{
+  ClintRangeStack *stack;
+
+  stack = (ClintRangeStack*)clint_tls_get(&g_clint_annotate_key);
+  if (stack == NULL) {
+    stack = (ClintRangeStack*)calloc(1, sizeof(ClintRangeStack));
+    if (stack != NULL)
+      clint_tls_set(&g_clint_annotate_key, stack);
+  }
+  return stack;
+}
+
+CL_API_ENTRY cl_int CL_API_CALL clintPushRangeCLINT(const char *name)
+{
+  ClintRangeStack *stack;
+
+  if (name == NULL)
+    return CL_INVALID_VALUE;
+  if (!g_clint_annotate_init || !clint_get_config(CLINT_PROFILE))
+    return CL_SUCCESS;
+  stack = clint_annotate_stack();
+  if (stack == NULL)
+    return CL_OUT_OF_HOST_MEMORY;
+  /* Past the maximum depth, commands stay in the deepest range we kept. */
+  if (stack->depth < CLINT_RANGE_DEPTH) {
+    ClintRange *parent = (stack->depth > 0) ? stack->ranges[stack->depth - 1] : NULL;
+    stack->ranges[stack->depth] = clint_annotate_intern(parent ? parent->name : NULL, name);
+  }
+  stack->depth++;
+  return CL_SUCCESS;
+}
+
+CL_API_ENTRY cl_int CL_API_CALL clintPopRangeCLINT(void)
+{
+  ClintRangeStack *stack;
+
+  if (!g_clint_annotate_init || !clint_get_config(CLINT_PROFILE))
+    return CL_SUCCESS;
+  stack = (ClintRangeStack*)clint_tls_get(&g_clint_annotate_key);
+  if (stack == NULL || stack->depth == 0)
+    return CL_INVALID_OPERATION;
+  stack->depth--;
+  return CL_SUCCESS;
+}
+
+CL_API_ENTRY cl_int CL_API_CALL clintMarkerCLINT(const char *name)
+{
+  ClintRange *range;
+
+  if (name == NULL)
+    return CL_INVALID_VALUE;
+  if (!g_clint_annotate_init || !clint_get_config(CLINT_PROFILE))
+    return CL_SUCCESS;
+  range = clint_annotate_current();
+  if (range != NULL)
+    clint_log("MARKER: %s %f in %s\n", name, (double)clint_time_now() * 1.0e-9, range->name);
+  else
+    clint_log("MARKER: %s %f\n", name, (double)clint_time_now() * 1.0e-9);
+  if (clint_get_config(CLINT_PROFILE_FRAME))
+    clint_frame_marker(name);
+  return CL_SUCCESS;
+}
+
+ClintRange *clint_annotate_current(void)
+{
+  ClintRangeStack *stack;
+
+  if (!g_clint_annotate_init)
+    return NULL;
+  stack = (ClintRangeStack*)clint_tls_get(&g_clint_annotate_key);
+  if (stack == NULL || stack->depth == 0)
+    return NULL;
+  if (stack->depth > CLINT_RANGE_DEPTH)
+    return stack->ranges[CLINT_RANGE_DEPTH - 1];
+  return stack->ranges[stack->depth - 1];
+}
+
+void clint_annotate_record(ClintRange *range, cl_ulong ns)
+{
+  if (range == NULL)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_annotate_lock);
+  range->commands++;
+  range->device_ns += ns;
+  CLINT_SPINLOCK_UNLOCK(g_clint_annotate_lock);
+}
+
+static int clint_annotate_compare(const void *a, const void *b)
+{
+  const ClintRange *ra = *(const ClintRange**)a;
+  const ClintRange *rb = *(const ClintRange**)b;
+
+  if (ra->device_ns != rb->device_ns)
+    return (ra->device_ns < rb->device_ns) ? 1 : -1;
+  return 0;
+}
+
+void clint_annotate_report(int final)
+{
+  ClintRange **ranges;
+  ClintRange *range;
+  int count = 0;
+  int i;
+
+  CLINT_SPINLOCK_LOCK(g_clint_annotate_lock);
+  ranges = (ClintRange**)malloc(sizeof(ClintRange*) * (g_clint_range_count + 1));
+  if (ranges != NULL) {
+    for (i = 0; i < CLINT_RANGE_BUCKETS; i++) {
+      for (range = g_clint_ranges[i]; range != NULL; range = range->next) {
+        if (range->commands > 0)
+          ranges[count++] = range;
+      }
+    }
+    if (g_clint_range_other.commands > 0)
+      ranges[count++] = &g_clint_range_other;
+    qsort(ranges, count, sizeof(ClintRange*), clint_annotate_compare);
+    if (count > 0) {
+      clint_log("Range statistics:\n");
+      clint_log("%-40s %10s %12s\n", "range", "commands", "device (s)");
+    }
+    for (i = 0; i < count; i++) {
+      clint_log("%-40s %10lu %12.6f\n", ranges[i]->name,
+                (unsigned long)ranges[i]->commands, (double)ranges[i]->device_ns * 1.0e-9);
+      /* Only report once, even if we're shutdown again. */
+      if (final) {
+        ranges[i]->commands = 0;
+        ranges[i]->device_ns = 0;
+      }
+    }
+    free(ranges);
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_annotate_lock);
+}
@@ -0,0 +1,63 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_ANNOTATE_H_
+#define _CLINT_ANNOTATE_H_
+
+#include "cl_clint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* An interned range path, e.g. "frame/shadows", with its totals. */
+typedef struct ClintRange {
+  struct ClintRange *next;
+  char *name;
+  cl_ulong commands;
+  cl_ulong device_ns;
+} ClintRange;
+
+void clint_annotate_init(void);
+
+CL_API_ENTRY cl_int CL_API_CALL clintPushRangeCLINT(const char *name);
+CL_API_ENTRY cl_int CL_API_CALL clintPopRangeCLINT(void);
+CL_API_ENTRY cl_int CL_API_CALL clintMarkerCLINT(const char *name);
+
+/* The innermost range of the calling thread, or NULL. */
+ClintRange *clint_annotate_current(void);
+void clint_annotate_record(ClintRange *range, cl_ulong ns);
+
+/* Log device time per range. */
+void clint_annotate_report(int final);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_ANNOTATE_H_
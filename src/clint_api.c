@@ -0,0 +1,185 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_api.h"
+#include "clint_atomic.h"
+#include "clint_config.h"
+#include "clint_log.h"
+#include "clint_thread.h"
+#include "clint_time.h"
+#include "clint_timeline.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ClintApiStats {
+  cl_ulong calls;
+  cl_ulong driver_ns;
+  cl_ulong max_ns;
+  cl_ulong overhead_ns;
+} ClintApiStats;
+
+/* Each thread only writes its own shard, so its lock is only contended by a
+   report, which CLINT_CONTROL can ask for at any time.  Shards are never
+   freed so counts from exited threads are still reported. */
+typedef struct ClintApiShard {
+  struct ClintApiShard *next;
+  ClintSpinLock lock;
+  ClintApiStats stats[ClintFunc_max];
+} ClintApiShard;
+
+typedef struct ClintApiRow {
+  ClintApiStats stats;
+  int func;
+} ClintApiRow;
+
+static int g_clint_api_init = 0;
+static ClintTLS g_clint_api_key;
+static ClintApiShard *g_clint_api_shards = NULL;
+static ClintSpinLock g_clint_api_lock;
+
+void clint_api_init(void)
+{
+  if (g_clint_api_init == 0) {
+    g_clint_api_init = 1;
+    clint_tls_create(&g_clint_api_key);
+  }
+}
+
+static ClintApiShard *clint_api_shard(void)
+{
+  ClintApiShard *shard;
+
+  shard = (ClintApiShard*)clint_tls_get(&g_clint_api_key);
+  if (shard == NULL) {
+    shard = (ClintApiShard*)calloc(1, sizeof(ClintApiShard));
+    if (shard == NULL)
+      return NULL;
+    clint_tls_set(&g_clint_api_key, shard);
+    CLINT_SPINLOCK_LOCK(g_clint_api_lock);
+    shard->next = g_clint_api_shards;
+    g_clint_api_shards = shard;
+    CLINT_SPINLOCK_UNLOCK(g_clint_api_lock);
+  }
+  return shard;
+}
+
+void clint_api_record(ClintFunc func, const cl_ulong *times)
+{
+  ClintApiShard *shard;
+  ClintApiStats *stats;
+  cl_ulong exit_time = clint_time_now();
+  cl_ulong driver_ns;
+
+  if (!g_clint_api_init || func < 0 || func >= ClintFunc_max)
+    return;
+  if (clint_get_config(CLINT_PROFILE_API) && (shard = clint_api_shard()) != NULL) {
+    stats = &shard->stats[func];
+    driver_ns = times[2] - times[1];
+    CLINT_SPINLOCK_LOCK(shard->lock);
+    stats->calls++;
+    stats->driver_ns += driver_ns;
+    if (driver_ns > stats->max_ns)
+      stats->max_ns = driver_ns;
+    stats->overhead_ns += (exit_time - times[0]) - driver_ns;
+    CLINT_SPINLOCK_UNLOCK(shard->lock);
+  }
+  if (clint_get_config(CLINT_PROFILE_TIMELINE))
+    clint_timeline_host(func, times[0], exit_time);
+}
+
+static int clint_api_compare(const void *a, const void *b)
+{
+  const ClintApiStats *sa = &((const ClintApiRow*)a)->stats;
+  const ClintApiStats *sb = &((const ClintApiRow*)b)->stats;
+
+  if (sa->driver_ns != sb->driver_ns)
+    return (sa->driver_ns < sb->driver_ns) ? 1 : -1;
+  return 0;
+}
+
+void clint_api_report(int final)
+{
+  ClintApiRow rows[ClintFunc_max];
+  ClintApiShard *shard;
+  ClintApiStats total;
+  int count = 0;
+  int i;
+
+  if (!g_clint_api_init)
+    return;
+  memset(rows, 0, sizeof(rows));
+  memset(&total, 0, sizeof(total));
+  CLINT_SPINLOCK_LOCK(g_clint_api_lock);
+  for (shard = g_clint_api_shards; shard != NULL; shard = shard->next) {
+    CLINT_SPINLOCK_LOCK(shard->lock);
+    for (i = 0; i < ClintFunc_max; i++) {
+      ClintApiStats *stats = &shard->stats[i];
+      rows[i].stats.calls += stats->calls;
+      rows[i].stats.driver_ns += stats->driver_ns;
+      rows[i].stats.overhead_ns += stats->overhead_ns;
+      if (stats->max_ns > rows[i].stats.max_ns)
+        rows[i].stats.max_ns = stats->max_ns;
+    }
+    /* Only report once, even if we're shutdown again. */
+    if (final)
+      memset(shard->stats, 0, sizeof(shard->stats));
+    CLINT_SPINLOCK_UNLOCK(shard->lock);
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_api_lock);
+
+  for (i = 0; i < ClintFunc_max; i++) {
+    if (rows[i].stats.calls == 0)
+      continue;
+    rows[count].stats = rows[i].stats;
+    rows[count].func = i;
+    total.calls += rows[i].stats.calls;
+    total.driver_ns += rows[i].stats.driver_ns;
+    total.overhead_ns += rows[i].stats.overhead_ns;
+    count++;
+  }
+  if (count == 0)
+    return;
+  qsort(rows, count, sizeof(ClintApiRow), clint_api_compare);
+
+  clint_log("API statistics:\n");
+  clint_log("%-40s %10s %12s %12s %12s %12s\n",
+            "function", "calls", "total (s)", "mean (us)", "max (us)", "overhead (s)");
+  for (i = 0; i < count; i++) {
+    const ClintApiStats *stats = &rows[i].stats;
+    clint_log("%-40s %10lu %12.6f %12.3f %12.3f %12.6f\n",
+              clint_func_name((ClintFunc)rows[i].func), (unsigned long)stats->calls,
+              (double)stats->driver_ns * 1.0e-9,
+              (double)stats->driver_ns * 1.0e-3 / (double)stats->calls,
+              (double)stats->max_ns * 1.0e-3,
+              (double)stats->overhead_ns * 1.0e-9);
+  }
+  clint_log("%-40s %10lu %12.6f %12s %12s %12.6f\n",
+            "total", (unsigned long)total.calls, (double)total.driver_ns * 1.0e-9,
+            "", "", (double)total.overhead_ns * 1.0e-9);
+}
@@ -46,31 +46,47 @@ extern "C" {
 
 typedef volatile LONG ClintSpinLock;
 typedef LONG ClintAtomicInt;
+typedef volatile LONGLONG ClintAtomicInt64;
 
 #define CLINT_SPINLOCK_LOCK(l) { while (InterlockedCompareExchangeAcquire(&(l), 1, 0) != 0) { while (l) {} } }
 #define CLINT_SPINLOCK_UNLOCK(l) InterlockedCompareExchangeRelease(&(l), 0, 1)
+#define CLINT_SPINLOCK_TRYLOCK(l) (InterlockedCompareExchangeAcquire(&(l), 1, 0) == 0)
 #define CLINT_ATOMIC_ADD(v, a) (InterlockedExchangeAdd(&(a), v) + v)
 #define CLINT_ATOMIC_SUB(v, a) (InterlockedExchangeAdd(&(a), v) - v)
+#define CLINT_ATOMIC_ADD64(v, a) InterlockedExchangeAdd64(&(a), v)
+#define CLINT_MEMORY_BARRIER() MemoryBarrier()
 
 #elif defined(__APPLE__)
 
 typedef OSSpinLock ClintSpinLock;
 typedef int32_t ClintAtomicInt;
+typedef volatile int64_t ClintAtomicInt64;
 
 #define CLINT_SPINLOCK_LOCK(l) OSSpinLockLock(&(l))
 #define CLINT_SPINLOCK_UNLOCK(l) OSSpinLockUnlock(&(l))
+#define CLINT_SPINLOCK_TRYLOCK(l) OSSpinLockTry(&(l))
 #define CLINT_ATOMIC_ADD(v, a) OSAtomicAdd32Barrier(v, &(a))
 #define CLINT_ATOMIC_SUB(v, a) OSAtomicAdd32Barrier(-v, &(a))
+#define CLINT_ATOMIC_ADD64(v, a) OSAtomicAdd64(v, &(a))
+#define CLINT_MEMORY_BARRIER() OSMemoryBarrier()
 
 #elif defined(__GNUC__)
 
 typedef int32_t ClintSpinLock;
 typedef int32_t ClintAtomicInt;
+typedef volatile int64_t ClintAtomicInt64;
 
 #define CLINT_SPINLOCK_LOCK(l) { while (__sync_lock_test_and_set(&(l), 1) != 0) { while (l) {} } }
 #define CLINT_SPINLOCK_UNLOCK(l) __sync_lock_release(&(l))
+#define CLINT_SPINLOCK_TRYLOCK(l) (__sync_lock_test_and_set(&(l), 1) == 0)
 #define CLINT_ATOMIC_ADD(v, a) __sync_add_and_fetch(&(a), v)
 #define CLINT_ATOMIC_SUB(v, a) __sync_sub_and_fetch(&(a), v)
+#if defined(__ATOMIC_RELAXED)
+#define CLINT_ATOMIC_ADD64(v, a) __atomic_add_fetch(&(a), v, __ATOMIC_RELAXED)
+#else
+#define CLINT_ATOMIC_ADD64(v, a) __sync_add_and_fetch(&(a), v)
+#endif
+#define CLINT_MEMORY_BARRIER() __sync_synchronize()
 
 #endif
 
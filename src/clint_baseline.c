@@ -0,0 +1,347 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_baseline.h"
+#include "clint.h"
+#include "clint_config.h"
+#include "clint_data.h"
+#include "clint_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Percentiles from fewer samples than this are too noisy to compare. */
+#define CLINT_BASELINE_MIN_P50 10
+#define CLINT_BASELINE_MIN_P99 100
+
+typedef cl_int (CL_API_CALL *ClintGetDeviceInfoFn)(cl_device_id, cl_device_info, size_t, void *, size_t *);
+
+/* One line of the baseline file: device name, driver version, kernel, NDRange,
+   samples, p50 and p99 in ns, tab separated. */
+typedef struct ClintBaseline {
+  struct ClintBaseline *next;
+  char *device;
+  char *driver;
+  char *kernel;
+  char *shape;
+  cl_ulong samples;
+  double p50;
+  double p99;
+} ClintBaseline;
+
+/* The name and driver version of a device, looked up once. */
+typedef struct ClintBaselineDevice {
+  struct ClintBaselineDevice *next;
+  cl_device_id id;
+  char *name;
+  char *driver;
+  /* Whether a driver change was logged. */
+  int changed;
+} ClintBaselineDevice;
+
+static int g_clint_baseline_loaded = 0;
+static ClintBaseline *g_clint_baselines = NULL;
+static ClintBaselineDevice *g_clint_baseline_devices = NULL;
+static int g_clint_baseline_compared = 0;
+static int g_clint_baseline_regressed = 0;
+
+static char *clint_baseline_strdup(const char *s)
+{
+  char *d = (char*)malloc(strlen(s) + 1);
+
+  if (d != NULL)
+    strcpy(d, s);
+  return d;
+}
+
+static void clint_baseline_format(char *buf, size_t size, const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+#if defined(WIN32)
+  _vsnprintf_s(buf, size, _TRUNCATE, format, args);
+#else
+  vsnprintf(buf, size, format, args);
+#endif
+  va_end(args);
+}
+
+static FILE *clint_baseline_open(const char *mode)
+{
+  const char *path = clint_get_config_string(CLINT_PROFILE_BASELINE);
+  FILE *fp;
+
+  if (path == NULL)
+    return NULL;
+#if defined(WIN32)
+  if (fopen_s(&fp, path, mode) != 0)
+    fp = NULL;
+#else
+  fp = fopen(path, mode);
+#endif
+  return fp;
+}
+
+static ClintBaseline *clint_baseline_add(const char *device, const char *driver, const char *kernel,
+                                         const char *shape, cl_ulong samples, double p50, double p99)
+{
+  ClintBaseline *b = (ClintBaseline*)calloc(1, sizeof(ClintBaseline));
+
+  if (b == NULL)
+    return NULL;
+  b->device = clint_baseline_strdup(device);
+  b->driver = clint_baseline_strdup(driver);
+  b->kernel = clint_baseline_strdup(kernel);
+  b->shape = clint_baseline_strdup(shape);
+  if (b->device == NULL || b->driver == NULL || b->kernel == NULL || b->shape == NULL) {
+    free(b->device);
+    free(b->driver);
+    free(b->kernel);
+    free(b->shape);
+    free(b);
+    return NULL;
+  }
+  b->samples = samples;
+  b->p50 = p50;
+  b->p99 = p99;
+  CLINT_STACK_PUSH(g_clint_baselines, b);
+  return b;
+}
+
+/* Splits off the next tab separated field, or returns NULL at the end of the line. */
+static char *clint_baseline_field(char **line)
+{
+  char *field = *line;
+  char *tab;
+
+  if (field == NULL)
+    return NULL;
+  tab = strchr(field, '\t');
+  if (tab != NULL)
+    *tab++ = 0;
+  *line = tab;
+  return field;
+}
+
+static void clint_baseline_load(void)
+{
+  char line[1024];
+  FILE *fp;
+
+  if (g_clint_baseline_loaded)
+    return;
+  g_clint_baseline_loaded = 1;
+  fp = clint_baseline_open("r");
+  if (fp == NULL)
+    return;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char *device, *driver, *kernel, *shape, *samples, *p50, *p99;
+    char *p = line;
+    if (line[0] == '#')
+      continue;
+    device = clint_baseline_field(&p);
+    driver = clint_baseline_field(&p);
+    kernel = clint_baseline_field(&p);
+    shape = clint_baseline_field(&p);
+    samples = clint_baseline_field(&p);
+    p50 = clint_baseline_field(&p);
+    p99 = clint_baseline_field(&p);
+    if (p99 == NULL)
+      continue;
+    clint_baseline_add(device, driver, kernel, shape,
+                       (cl_ulong)strtod(samples, NULL), strtod(p50, NULL), strtod(p99, NULL));
+  }
+  fclose(fp);
+}
+
+/* Tabs and newlines would break the file format. */
+static char *clint_baseline_device_string(ClintGetDeviceInfoFn get_device_info, cl_device_id device,
+                                          cl_device_info param)
+{
+  size_t size = 0;
+  char *s = NULL;
+  char *p;
+
+  if (get_device_info != NULL && device != NULL &&
+      get_device_info(device, param, 0, NULL, &size) == CL_SUCCESS && size > 0) {
+    s = (char*)malloc(size);
+    if (s != NULL && get_device_info(device, param, size, s, NULL) != CL_SUCCESS) {
+      free(s);
+      s = NULL;
+    }
+  }
+  if (s == NULL)
+    return clint_baseline_strdup("unknown");
+  s[size - 1] = 0;
+  for (p = s; *p; p++) {
+    if (*p == '\t' || *p == '\n')
+      *p = ' ';
+  }
+  return s;
+}
+
+static ClintBaselineDevice *clint_baseline_device(cl_device_id id)
+{
+  ClintGetDeviceInfoFn get_device_info;
+  ClintBaselineDevice *device;
+
+  for (device = g_clint_baseline_devices; device != NULL; device = device->next) {
+    if (device->id == id)
+      return device;
+  }
+  device = (ClintBaselineDevice*)calloc(1, sizeof(ClintBaselineDevice));
+  if (device == NULL)
+    return NULL;
+  get_device_info = (ClintGetDeviceInfoFn)clint_opencl_func("clGetDeviceInfo");
+  device->id = id;
+  device->name = clint_baseline_device_string(get_device_info, id, CL_DEVICE_NAME);
+  device->driver = clint_baseline_device_string(get_device_info, id, CL_DRIVER_VERSION);
+  if (device->name == NULL || device->driver == NULL) {
+    free(device->name);
+    free(device->driver);
+    free(device);
+    return NULL;
+  }
+  CLINT_STACK_PUSH(g_clint_baseline_devices, device);
+  return device;
+}
+
+/* "1024x768 local 16x16", without the local size when the driver picked it. */
+static void clint_baseline_shape(const ClintKernelShape *shape, char *buf, size_t size)
+{
+  size_t len = 0;
+  cl_uint i;
+
+  buf[0] = 0;
+  if (shape->dims == 0) {
+    clint_baseline_format(buf, size, "-");
+    return;
+  }
+  for (i = 0; i < shape->dims && len < size; i++) {
+    clint_baseline_format(buf + len, size - len, "%s%lu", i ? "x" : "", (unsigned long)shape->global[i]);
+    len += strlen(buf + len);
+  }
+  if (shape->local[0] == 0)
+    return;
+  for (i = 0; i < shape->dims && len < size; i++) {
+    clint_baseline_format(buf + len, size - len, "%s%lu", i ? "x" : " local ", (unsigned long)shape->local[i]);
+    len += strlen(buf + len);
+  }
+}
+
+static void clint_baseline_compare(const ClintBaseline *b, const ClintBaselineDevice *device,
+                                   const char *what, double old_ns, double new_ns)
+{
+  int threshold = clint_get_config(CLINT_PROFILE_REGRESSION);
+  int changed = strcmp(b->driver, device->driver) != 0;
+
+  if (threshold <= 0)
+    threshold = 10;
+  if (old_ns > 0 && new_ns > old_ns * (1.0 + threshold * 0.01)) {
+    clint_log("REGRESSION: %s (%s) on %s: %s %.3f us -> %.3f us (+%.1f%%)%s%s%s%s\n",
+              b->kernel, b->shape, b->device, what, old_ns * 1.0e-3, new_ns * 1.0e-3,
+              100.0 * (new_ns - old_ns) / old_ns,
+              changed ? ", driver " : "", changed ? b->driver : "",
+              changed ? " -> " : "", changed ? device->driver : "");
+    g_clint_baseline_regressed++;
+  }
+}
+
+void clint_baseline_kernel(cl_device_id id, const char *kernel, const ClintKernelShape *shape,
+                           cl_ulong samples, double p50, double p99)
+{
+  ClintBaselineDevice *device;
+  ClintBaseline *b;
+  char key[256];
+  char *driver;
+  int regressed;
+
+  clint_baseline_load();
+  device = clint_baseline_device(id);
+  if (device == NULL)
+    return;
+  clint_baseline_shape(shape, key, sizeof(key));
+  for (b = g_clint_baselines; b != NULL; b = b->next) {
+    if (strcmp(b->device, device->name) == 0 && strcmp(b->kernel, kernel) == 0 &&
+        strcmp(b->shape, key) == 0)
+      break;
+  }
+  if (b == NULL) {
+    clint_baseline_add(device->name, device->driver, kernel, key, samples, p50, p99);
+    return;
+  }
+  if (strcmp(b->driver, device->driver) != 0 && !device->changed) {
+    clint_log("Baseline: %s driver changed from %s to %s, comparing with the old driver\n",
+              device->name, b->driver, device->driver);
+    device->changed = 1;
+  }
+  regressed = g_clint_baseline_regressed;
+  if (samples >= CLINT_BASELINE_MIN_P50 && b->samples >= CLINT_BASELINE_MIN_P50) {
+    g_clint_baseline_compared++;
+    clint_baseline_compare(b, device, "p50", b->p50, p50);
+    if (samples >= CLINT_BASELINE_MIN_P99 && b->samples >= CLINT_BASELINE_MIN_P99)
+      clint_baseline_compare(b, device, "p99", b->p99, p99);
+  }
+  /* Keep the old baseline and driver when it regressed, so the alert repeats until
+     it's fixed or the file is deleted. */
+  if (regressed == g_clint_baseline_regressed) {
+    driver = clint_baseline_strdup(device->driver);
+    if (driver != NULL) {
+      free(b->driver);
+      b->driver = driver;
+    }
+    b->samples = samples;
+    b->p50 = p50;
+    b->p99 = p99;
+  }
+}
+
+void clint_baseline_save(void)
+{
+  ClintBaseline *b;
+  FILE *fp;
+
+  if (!g_clint_baseline_loaded)
+    return;
+  clint_log("Baseline: %d kernels compared, %d regressions\n",
+            g_clint_baseline_compared, g_clint_baseline_regressed);
+  fp = clint_baseline_open("w");
+  if (fp == NULL) {
+    clint_log("Baseline: can't write %s\n", clint_get_config_string(CLINT_PROFILE_BASELINE));
+    return;
+  }
+  fprintf(fp, "# CLIntercept kernel baseline: device, driver, kernel, NDRange, samples, p50 (ns), p99 (ns)\n");
+  for (b = g_clint_baselines; b != NULL; b = b->next) {
+    fprintf(fp, "%s\t%s\t%s\t%s\t%lu\t%.0f\t%.0f\n", b->device, b->driver, b->kernel, b->shape,
+            (unsigned long)b->samples, b->p50, b->p99);
+  }
+  fclose(fp);
+}
@@ -0,0 +1,183 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_clock.h"
+#include "clint.h"
+#include "clint_atomic.h"
+#include "clint_data.h"
+#include "clint_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Resynchronize each device this often, to follow drift between the clocks. */
+#define CLINT_CLOCK_INTERVAL 1000000000
+
+typedef cl_int (CL_API_CALL *ClintGetDeviceAndHostTimerFn)(cl_device_id, cl_ulong *, cl_ulong *);
+
+typedef struct ClintClockPoint {
+  cl_ulong device_ns;
+  cl_ulong host_ns;
+  cl_ulong error_ns;
+} ClintClockPoint;
+
+typedef struct ClintClock {
+  CLINT_LIST_ELEMS(struct ClintClock, cl_device_id)
+  int has_timer;
+  /* Mapping currently in use: host = ref.host + (device - ref.device) * slope. */
+  ClintClockPoint ref;
+  double slope;
+  /* Best sample seen since the window opened at window_ns. */
+  ClintClockPoint best;
+  cl_ulong window_ns;
+} ClintClock;
+
+static ClintClock *g_clint_clocks = NULL;
+static ClintSpinLock g_clint_clock_lock;
+static ClintGetDeviceAndHostTimerFn g_clint_get_device_and_host_timer;
+static int g_clint_clock_loaded = 0;
+
+static ClintClock *clint_clock_find(cl_device_id device)
+{
+  ClintClock *clock;
+
+  CLINT_LIST_FIND(clock, g_clint_clocks, device);
+  if (clock != NULL)
+    return clock;
+  clock = (ClintClock*)calloc(1, sizeof(ClintClock));
+  if (clock == NULL)
+    return NULL;
+  clock->has_timer = 1;
+  clock->slope = 1.0;
+  CLINT_LIST_INSERT(g_clint_clocks, device, clock);
+  return clock;
+}
+
+static void clint_clock_commit(ClintClock *clock, const ClintClockPoint *point)
+{
+  if (clock->ref.host_ns != 0 && point->host_ns > clock->ref.host_ns &&
+      point->device_ns > clock->ref.device_ns &&
+      point->host_ns - clock->ref.host_ns >= CLINT_CLOCK_INTERVAL) {
+    /* Drift between the two clocks since the last reference. */
+    clock->slope = (double)(point->host_ns - clock->ref.host_ns) /
+      (double)(point->device_ns - clock->ref.device_ns);
+  }
+  clock->ref = *point;
+  clock->best.host_ns = 0;
+  clock->window_ns = point->host_ns;
+}
+
+/* Called with the lock held. */
+static void clint_clock_add(ClintClock *clock, const ClintClockPoint *point)
+{
+  if (clock->ref.host_ns == 0) {
+    clint_clock_commit(clock, point);
+    return;
+  }
+  /* Keep the tightest bracket in each window. */
+  if (clock->best.host_ns == 0 || point->error_ns <= clock->best.error_ns)
+    clock->best = *point;
+  if (point->host_ns - clock->window_ns >= CLINT_CLOCK_INTERVAL)
+    clint_clock_commit(clock, &clock->best);
+}
+
+void clint_clock_sample(cl_device_id device, cl_ulong device_ns, cl_ulong host_lo, cl_ulong host_hi)
+{
+  ClintClock *clock;
+  ClintClockPoint point;
+
+  if (device == NULL || device_ns == 0 || host_hi < host_lo)
+    return;
+  point.device_ns = device_ns;
+  point.host_ns = host_lo + (host_hi - host_lo) / 2;
+  point.error_ns = (host_hi - host_lo) / 2;
+  CLINT_SPINLOCK_LOCK(g_clint_clock_lock);
+  clock = clint_clock_find(device);
+  if (clock != NULL)
+    clint_clock_add(clock, &point);
+  CLINT_SPINLOCK_UNLOCK(g_clint_clock_lock);
+}
+
+/* Ask the driver when it supports clGetDeviceAndHostTimer (OpenCL 2.1).
+   The driver's host clock may not be ours, so bracket the call instead. */
+static void clint_clock_timer(cl_device_id device)
+{
+  cl_ulong host_lo, host_hi, device_ns, host_ns;
+  cl_int err = CL_INVALID_OPERATION;
+
+  if (!g_clint_clock_loaded) {
+    g_clint_get_device_and_host_timer =
+      (ClintGetDeviceAndHostTimerFn)clint_opencl_func("clGetDeviceAndHostTimer");
+    g_clint_clock_loaded = 1;
+  }
+  host_lo = clint_time_now();
+  if (g_clint_get_device_and_host_timer != NULL)
+    err = g_clint_get_device_and_host_timer(device, &device_ns, &host_ns);
+  host_hi = clint_time_now();
+  if (err == CL_SUCCESS) {
+    clint_clock_sample(device, device_ns, host_lo, host_hi);
+  } else {
+    /* Fall back to the samples offered by profiled commands. */
+    ClintClock *clock;
+    CLINT_SPINLOCK_LOCK(g_clint_clock_lock);
+    clock = clint_clock_find(device);
+    if (clock != NULL)
+      clock->has_timer = 0;
+    CLINT_SPINLOCK_UNLOCK(g_clint_clock_lock);
+  }
+}
+
+cl_ulong clint_clock_to_host(cl_device_id device, cl_ulong device_ns)
+{
+  ClintClock *clock;
+  ClintClockPoint ref;
+  double slope;
+  int resync;
+
+  if (device_ns == 0)
+    return 0;
+  CLINT_SPINLOCK_LOCK(g_clint_clock_lock);
+  clock = clint_clock_find(device);
+  resync = clock != NULL && clock->has_timer &&
+    (clock->ref.host_ns == 0 || clint_time_now() - clock->ref.host_ns >= CLINT_CLOCK_INTERVAL);
+  CLINT_SPINLOCK_UNLOCK(g_clint_clock_lock);
+  if (clock == NULL)
+    return 0;
+  if (resync)
+    clint_clock_timer(device);
+
+  CLINT_SPINLOCK_LOCK(g_clint_clock_lock);
+  ref = clock->ref;
+  slope = clock->slope;
+  CLINT_SPINLOCK_UNLOCK(g_clint_clock_lock);
+  if (ref.host_ns == 0)
+    return 0;
+  if (device_ns >= ref.device_ns)
+    return ref.host_ns + (cl_ulong)((double)(device_ns - ref.device_ns) * slope);
+  return ref.host_ns - (cl_ulong)((double)(ref.device_ns - device_ns) * slope);
+}
@@ -27,6 +27,7 @@
 */
 
 #include "clint_config.h"
+#include "clint_atomic.h"
 #include "clint_data.h"
 #include "clint_log.h"
 #include "clint_thread.h"
@@ -51,12 +52,39 @@ static const char *g_clint_config_names[CLINT_MAX] = {
   "CLINT_ENABLED",
   "CLINT_CONFIG_FILE",
   "CLINT_LOG_FILE",
+  "CLINT_LOG_ASYNC",
+  "CLINT_LOG_DROP",
+  "CLINT_LOG_ROTATE_SIZE",
+  "CLINT_LOG_ROTATE_TIME",
+  "CLINT_LOG_SEGMENTS",
+  "CLINT_LOG_COMPRESS",
   "CLINT_TRACE",
+  "CLINT_TRACE_BINARY",
+  "CLINT_TRACE_LOOPS",
+  "CLINT_TRACE_FUNCS",
+  "CLINT_TRACE_START",
+  "CLINT_TRACE_SECONDS",
+  "CLINT_FLIGHT_RECORDER",
   "CLINT_ERRORS",
   "CLINT_ABORT",
   "CLINT_INFO",
+  "CLINT_INFO_CACHE",
   "CLINT_PROFILE",
+  "CLINT_PROFILE_KERNELS",
   "CLINT_PROFILE_ALL",
+  "CLINT_PROFILE_API",
+  "CLINT_PROFILE_SAMPLE",
+  "CLINT_PROFILE_BUDGET",
+  "CLINT_PROFILE_MARKERS",
+  "CLINT_PROFILE_TIMELINE",
+  "CLINT_PROFILE_WAIT",
+  "CLINT_PROFILE_BASELINE",
+  "CLINT_PROFILE_REGRESSION",
+  "CLINT_PROFILE_STACKS",
+  "CLINT_PROFILE_FRAME",
+  "CLINT_PROFILE_SLO",
+  "CLINT_SHM",
+  "CLINT_CONTROL",
   "CLINT_TRACK",
   "CLINT_ZOMBIES",
   "CLINT_LEAKS",
@@ -73,19 +101,58 @@ static const char *g_clint_config_names[CLINT_MAX] = {
   "CLINT_FORCE_DEVICE"
 };
 
-static int g_clint_config_values[CLINT_MAX];
-static const char *g_clint_config_strings[CLINT_MAX];
+/* Every call reads the config through g_clint_config.  Once running, a change
+   copies the snapshot and swaps the pointer, so readers never take a lock.
+   Replaced snapshots are kept, as a reader may still be using one. */
+typedef struct ClintConfigSnapshot {
+  int values[CLINT_MAX];
+  const char *strings[CLINT_MAX];
+  /* Set for the options changed since startup. */
+  unsigned char changed[CLINT_MAX];
+  struct ClintConfigSnapshot *retired;
+} ClintConfigSnapshot;
+
+static ClintConfigSnapshot g_clint_config_initial;
+static ClintConfigSnapshot *volatile g_clint_config = &g_clint_config_initial;
+static ClintSpinLock g_clint_config_lock;
 
 static const char *g_clint_config_describe[CLINT_MAX] = {
   "CLINT_ENABLED enabled.\n",
   "CLINT_CONFIG_FILE enabled:\n",
   "CLINT_LOG_FILE enabled:\n",
+  "CLINT_LOG_ASYNC enabled: writing the log from a background thread.\n",
+  "CLINT_LOG_DROP enabled: dropping log messages when the writer falls behind.\n",
+  "CLINT_LOG_ROTATE_SIZE enabled: megabytes per log segment.\n",
+  "CLINT_LOG_ROTATE_TIME enabled: seconds per log segment.\n",
+  "CLINT_LOG_SEGMENTS enabled: closed log segments kept.\n",
+  "CLINT_LOG_COMPRESS enabled: compressing closed log segments.\n",
   "CLINT_TRACE enabled: logging all OpenCL calls.\n",
+  "CLINT_TRACE_BINARY enabled: writing a binary trace of all OpenCL calls.\n",
+  "CLINT_TRACE_LOOPS enabled: summarizing repeated call sequences.\n",
+  "CLINT_TRACE_FUNCS enabled: only tracing matching functions.\n",
+  "CLINT_TRACE_START enabled: tracing from a kernel launch on.\n",
+  "CLINT_TRACE_SECONDS enabled: seconds to trace for.\n",
+  "CLINT_FLIGHT_RECORDER enabled: logging the last calls on errors.\n",
   "CLINT_ERRORS enabled: logging all OpenCL errors.\n",
   "CLINT_ABORT enabled: break on OpenCL errors.\n",
   "CLINT_INFO enabled: show device capabilities.\n",
+  "CLINT_INFO_CACHE enabled: caching the device report.\n",
   "CLINT_PROFILE enabled: profile kernel execution.\n",
+  "CLINT_PROFILE_KERNELS enabled: only profile matching kernels.\n",
   "CLINT_PROFILE_ALL enabled: profile OpenCL calls.\n",
+  "CLINT_PROFILE_API enabled: time host API calls.\n",
+  "CLINT_PROFILE_SAMPLE enabled: profile a sample of kernel launches.\n",
+  "CLINT_PROFILE_BUDGET enabled: limit profiled launches per kernel each second.\n",
+  "CLINT_PROFILE_MARKERS enabled: measure batch latency with markers.\n",
+  "CLINT_PROFILE_TIMELINE enabled: analyze device idle time.\n",
+  "CLINT_PROFILE_WAIT enabled: measure host time blocked on the device.\n",
+  "CLINT_PROFILE_BASELINE enabled: compare kernel times with a saved baseline.\n",
+  "CLINT_PROFILE_REGRESSION enabled: percent slowdown reported as a regression.\n",
+  "CLINT_PROFILE_STACKS enabled: attribute device time to host stacks.\n",
+  "CLINT_PROFILE_FRAME enabled: report per-frame statistics.\n",
+  "CLINT_PROFILE_SLO enabled: monitor p99 queue latency.\n",
+  "CLINT_SHM enabled: publish live counters for clinttop.\n",
+  "CLINT_CONTROL enabled: taking commands from a socket.\n",
   "CLINT_TRACK enabled: track all OpenCL objects.\n",
   "CLINT_ZOMBIES enabled: remember released objects.\n",
   "CLINT_LEAKS enabled: report any leaked objects.\n",
@@ -209,13 +276,30 @@ void clint_config_init(const ClintPathChar *path)
                     logfile_ptr = logfile;
                   }
                   break;
+                case CLINT_TRACE_BINARY:
+                case CLINT_TRACE_FUNCS:
+                case CLINT_TRACE_START:
+                case CLINT_INFO_CACHE:
+                case CLINT_CONTROL:
+                case CLINT_PROFILE_KERNELS:
+                case CLINT_PROFILE_BASELINE:
+                case CLINT_PROFILE_STACKS:
+                case CLINT_PROFILE_FRAME:
+                  clint_set_config(i, 1);
+                  strbuf = malloc(strlen(s)+1);
+                  if (clint_config_parse_string(strbuf, s, 1)) {
+                    g_clint_config->strings[i] = strbuf;
+                  } else {
+                    free(strbuf);
+                  }
+                  break;
                 case CLINT_CHECK_MAPPING:
                 case CLINT_DISABLE_EXTENSION:
                 case CLINT_FORCE_DEVICE:
                   clint_set_config(i, 1);
                   strbuf = malloc(strlen(s)+1);
                   if (clint_config_parse_string(strbuf, s, 0)) {
-                    g_clint_config_strings[i] = strbuf;
+                    g_clint_config->strings[i] = strbuf;
                   } else {
                     free(strbuf);
                   }
@@ -248,8 +332,17 @@ void clint_config_init(const ClintPathChar *path)
       case CLINT_CHECK_MAPPING:
       case CLINT_DISABLE_EXTENSION:
       case CLINT_FORCE_DEVICE:
+      case CLINT_TRACE_BINARY:
+      case CLINT_TRACE_FUNCS:
+      case CLINT_TRACE_START:
+      case CLINT_INFO_CACHE:
+      case CLINT_CONTROL:
+      case CLINT_PROFILE_KERNELS:
+      case CLINT_PROFILE_BASELINE:
+      case CLINT_PROFILE_STACKS:
+      case CLINT_PROFILE_FRAME:
         clint_set_config(i, 1);
-        g_clint_config_strings[i] = envstr;
+        g_clint_config->strings[i] = envstr;
         break;
       default:
         clint_set_config(i, clint_config_parse_flag(envstr));
@@ -322,13 +415,25 @@ void clint_config_init(const ClintPathChar *path)
   /* Finally set any implied config items. */
   for (i = 0; i < CLINT_MAX; i++) {
     if (i != CLINT_ENABLED) {
-      if (g_clint_config_values[i]) {
+      if (g_clint_config->values[i]) {
         clint_set_config(CLINT_ENABLED, 1);
         break;
       }
     }
   }
-  if (clint_get_config(CLINT_TRACE)) {
+  if (clint_get_config(CLINT_TRACE_LOOPS)) {
+    clint_set_config(CLINT_TRACE, 1);
+  }
+  if ((clint_get_config(CLINT_TRACE_FUNCS) ||
+       clint_get_config(CLINT_TRACE_START) ||
+       clint_get_config(CLINT_TRACE_SECONDS)) &&
+      !clint_get_config(CLINT_TRACE_BINARY)) {
+    clint_set_config(CLINT_TRACE, 1);
+  }
+  if (clint_get_config(CLINT_INFO_CACHE)) {
+    clint_set_config(CLINT_INFO, 1);
+  }
+  if (clint_get_config(CLINT_TRACE) || clint_get_config(CLINT_FLIGHT_RECORDER)) {
     clint_set_config(CLINT_ERRORS, 1);
   }
   if (clint_get_config(CLINT_STRICT_THREAD)) {
@@ -346,28 +451,80 @@ void clint_config_init(const ClintPathChar *path)
       clint_get_config(CLINT_CHECK_BOUNDS)) {
     clint_set_config(CLINT_TRACK, 1);
   }
-  if (clint_get_config(CLINT_PROFILE_ALL)) {
+  if (clint_get_config(CLINT_PROFILE_ALL) ||
+      clint_get_config(CLINT_PROFILE_SAMPLE) ||
+      clint_get_config(CLINT_PROFILE_BUDGET) ||
+      clint_get_config(CLINT_PROFILE_TIMELINE) ||
+      clint_get_config(CLINT_PROFILE_BASELINE) ||
+      clint_get_config(CLINT_PROFILE_STACKS) ||
+      clint_get_config(CLINT_PROFILE_FRAME) ||
+      clint_get_config(CLINT_PROFILE_SLO) ||
+      clint_get_config(CLINT_PROFILE_KERNELS)) {
     clint_set_config(CLINT_PROFILE, 1);
   }
 }
 
 int clint_get_config(ClintConfig which)
 {
-  if (!g_clint_config_values[CLINT_ENABLED])
+  const ClintConfigSnapshot *config = g_clint_config;
+
+  if (!config->values[CLINT_ENABLED])
     return 0;
-  return g_clint_config_values[which];
+  return config->values[which];
 }
 
 const char *clint_get_config_string(ClintConfig which)
 {
-  if (!g_clint_config_values[CLINT_ENABLED])
+  const ClintConfigSnapshot *config = g_clint_config;
+
+  if (!config->values[CLINT_ENABLED])
     return NULL;
-  return g_clint_config_strings[which];
+  return config->strings[which];
 }
 
 void clint_set_config(ClintConfig which, int v)
 {
-  g_clint_config_values[which] = v;
+  g_clint_config->values[which] = v;
+}
+
+int clint_publish_config(ClintConfig which, int v)
+{
+  ClintConfigSnapshot *config = (ClintConfigSnapshot*)malloc(sizeof(ClintConfigSnapshot));
+
+  if (config == NULL)
+    return 0;
+  CLINT_SPINLOCK_LOCK(g_clint_config_lock);
+  memcpy(config, g_clint_config, sizeof(ClintConfigSnapshot));
+  config->values[which] = v;
+  config->changed[which] = 1;
+  config->retired = g_clint_config;
+  /* The copy must be complete before anyone can see it. */
+  CLINT_MEMORY_BARRIER();
+  g_clint_config = config;
+  CLINT_SPINLOCK_UNLOCK(g_clint_config_lock);
+  return 1;
+}
+
+int clint_config_changed(ClintConfig which)
+{
+  return g_clint_config->changed[which];
+}
+
+int clint_find_config(const char *name)
+{
+  int i;
+
+  for (i = 0; i < CLINT_MAX; i++) {
+    if (strcasecmp(name, g_clint_config_names[i]) == 0 ||
+        strcasecmp(name, g_clint_config_names[i] + 6 /* without CLINT_ */) == 0)
+      return i;
+  }
+  return -1;
+}
+
+const char *clint_config_name(ClintConfig which)
+{
+  return g_clint_config_names[which];
 }
 
 int clint_cmp_config_string(ClintConfig which, const char *s)
@@ -38,18 +38,72 @@ typedef enum ClintConfig {
   CLINT_CONFIG_FILE,
   /* Path for log file */
   CLINT_LOG_FILE,
+  /* Write the log from a background thread. */
+  CLINT_LOG_ASYNC,
+  /* Drop messages instead of waiting when CLINT_LOG_ASYNC falls behind. */
+  CLINT_LOG_DROP,
+  /* Start a new log segment after this many megabytes. */
+  CLINT_LOG_ROTATE_SIZE,
+  /* Start a new log segment after this many seconds. */
+  CLINT_LOG_ROTATE_TIME,
+  /* Keep at most this many closed log segments. */
+  CLINT_LOG_SEGMENTS,
+  /* Compress closed log segments in the background. */
+  CLINT_LOG_COMPRESS,
   /* Log all OpenCL calls. */
   CLINT_TRACE,
+  /* Write calls to a compact binary file, decoded offline by clintdecode. */
+  CLINT_TRACE_BINARY,
+  /* Summarize call sequences that CLINT_TRACE would log over and over. */
+  CLINT_TRACE_LOOPS,
+  /* Only trace the functions matching these patterns. */
+  CLINT_TRACE_FUNCS,
+  /* Start tracing at the given launch of a kernel. */
+  CLINT_TRACE_START,
+  /* Stop tracing this many seconds after it started. */
+  CLINT_TRACE_SECONDS,
+  /* Remember the last calls of each thread, and log them on errors. */
+  CLINT_FLIGHT_RECORDER,
   /* Log all OpenCL errors. */
   CLINT_ERRORS,
   /* Abort when an error is encountered. */
   CLINT_ABORT,
   /* Print OpenCL device info at startup. */
   CLINT_INFO,
+  /* Keep the CLINT_INFO report in this directory, keyed by driver version. */
+  CLINT_INFO_CACHE,
   /* Profile kernel execution. */
   CLINT_PROFILE,
+  /* Only profile the kernels matching these patterns. */
+  CLINT_PROFILE_KERNELS,
   /* Profile all calls. */
   CLINT_PROFILE_ALL,
+  /* Time every call on the host and report driver time and overhead. */
+  CLINT_PROFILE_API,
+  /* Profile about 1 in N launches of each kernel. */
+  CLINT_PROFILE_SAMPLE,
+  /* Profile at most N launches of each kernel per second. */
+  CLINT_PROFILE_BUDGET,
+  /* Measure batch latency with a marker every N commands. */
+  CLINT_PROFILE_MARKERS,
+  /* Report device idle gaps and what the host was doing in them. */
+  CLINT_PROFILE_TIMELINE,
+  /* Report host time blocked waiting on the device. */
+  CLINT_PROFILE_WAIT,
+  /* Compare kernel times with the baseline in this file. */
+  CLINT_PROFILE_BASELINE,
+  /* Percent slowdown against the baseline to report. */
+  CLINT_PROFILE_REGRESSION,
+  /* Write device time per host stack to this folded stacks file. */
+  CLINT_PROFILE_STACKS,
+  /* Report per-frame statistics; the value is the call that ends a frame. */
+  CLINT_PROFILE_FRAME,
+  /* Log when a queue's p99 latency exceeds this many microseconds. */
+  CLINT_PROFILE_SLO,
+  /* Publish live counters in shared memory for clinttop. */
+  CLINT_SHM,
+  /* Take commands at runtime from a socket in this directory. */
+  CLINT_CONTROL,
   /* Track all OpenCL resources. */
   CLINT_TRACK,
   /* Remember deallocated resources. */
@@ -85,7 +139,15 @@ typedef enum ClintConfig {
 void clint_config_init(const ClintPathChar *path);
 int clint_get_config(ClintConfig which);
 const char *clint_get_config_string(ClintConfig which);
+/* Only while starting up; clint_publish_config() once calls may be running. */
 void clint_set_config(ClintConfig which, int v);
+/* Change a setting for every thread without stopping any of them. */
+int clint_publish_config(ClintConfig which, int v);
+/* Whether which was changed by clint_publish_config() since startup. */
+int clint_config_changed(ClintConfig which);
+/* The option called name, with or without CLINT_, or -1. */
+int clint_find_config(const char *name);
+const char *clint_config_name(ClintConfig which);
 int clint_cmp_config_string(ClintConfig which, const char *s);
 const char *clint_config_describe(ClintConfig which);
 
@@ -0,0 +1,395 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_control.h"
+#include "clint.h"
+#include "clint_config.h"
+#include "clint_data.h"
+#include "clint_filter.h"
+#include "clint_log.h"
+#include "clint_obj.h"
+#include "clint_thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32)
+
+void clint_control_init(void)
+{
+  clint_log("Control: CLINT_CONTROL is not supported on Windows.\n");
+}
+
+void clint_control_shutdown(void)
+{
+}
+
+#else
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define CLINT_CONTROL_LINE 256
+
+/* The options that take effect without a restart. */
+static const ClintConfig g_clint_control_options[] = {
+  CLINT_TRACE,
+  CLINT_TRACE_SECONDS,
+  CLINT_ERRORS,
+  CLINT_ABORT,
+  CLINT_PROFILE,
+  CLINT_PROFILE_API,
+  CLINT_PROFILE_SAMPLE,
+  CLINT_PROFILE_BUDGET,
+  CLINT_TRACK,
+  CLINT_LEAKS,
+  CLINT_STACK_LOGGING
+};
+
+/* The socket is created in a directory only we can enter, so nobody can
+   connect before it is ready. */
+static char g_clint_control_dir[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static char g_clint_control_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static int g_clint_control_fd = -1;
+/* Written by clint_control_shutdown() to wake the listener. */
+static int g_clint_control_wake[2] = { -1, -1 };
+static pthread_t g_clint_control_thread;
+static int g_clint_control_started;
+
+static void clint_control_reply(int fd, const char *fmt, ...)
+{
+  char line[CLINT_CONTROL_LINE];
+  const char *p = line;
+  va_list ap;
+  int size;
+
+  va_start(ap, fmt);
+  size = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  if (size < 0)
+    return;
+  if (size >= (int)sizeof(line))
+    size = sizeof(line) - 1;
+  while (size > 0) {
+    ssize_t n = send(fd, p, (size_t)size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    p += n;
+    size -= (int)n;
+  }
+}
+
+static int clint_control_option(ClintConfig which)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(g_clint_control_options) / sizeof(g_clint_control_options[0]); i++) {
+    if (g_clint_control_options[i] == which)
+      return 1;
+  }
+  return 0;
+}
+
+static int clint_control_value(const char *s, int *v)
+{
+  char *end;
+  long n;
+
+  if (strcasecmp(s, "on") == 0 || strcasecmp(s, "true") == 0) {
+    *v = 1;
+    return 1;
+  }
+  if (strcasecmp(s, "off") == 0 || strcasecmp(s, "false") == 0) {
+    *v = 0;
+    return 1;
+  }
+  n = strtol(s, &end, 0);
+  if (end == s || *end != 0)
+    return 0;
+  *v = (int)n;
+  return 1;
+}
+
+static void clint_control_get(int fd, const char *name)
+{
+  size_t i;
+  int which;
+
+  if (name == NULL) {
+    for (i = 0; i < sizeof(g_clint_control_options) / sizeof(g_clint_control_options[0]); i++) {
+      which = g_clint_control_options[i];
+      clint_control_reply(fd, "%s = %d\n", clint_config_name(which), clint_get_config(which));
+    }
+  } else {
+    which = clint_find_config(name);
+    if (which < 0) {
+      clint_control_reply(fd, "error: unknown option %s\n", name);
+      return;
+    }
+    clint_control_reply(fd, "%s = %d\n", clint_config_name(which), clint_get_config(which));
+  }
+  clint_control_reply(fd, "ok\n");
+}
+
+static void clint_control_set(int fd, const char *name, const char *value)
+{
+  int which;
+  int v;
+
+  if (name == NULL || value == NULL) {
+    clint_control_reply(fd, "error: usage: set <option> <value>\n");
+    return;
+  }
+  which = clint_find_config(name);
+  if (which < 0) {
+    clint_control_reply(fd, "error: unknown option %s\n", name);
+    return;
+  }
+  if (!clint_control_option(which)) {
+    clint_control_reply(fd, "error: %s can only be set at startup\n", clint_config_name(which));
+    return;
+  }
+  if (!clint_control_value(value, &v)) {
+    clint_control_reply(fd, "error: %s is not a number, on or off\n", value);
+    return;
+  }
+  if (!clint_publish_config(which, v)) {
+    clint_control_reply(fd, "error: out of memory\n");
+    return;
+  }
+  if (which == CLINT_TRACE || which == CLINT_TRACE_SECONDS)
+    clint_filter_update();
+  clint_log("Control: %s = %d\n", clint_config_name(which), v);
+  clint_control_reply(fd, "ok\n");
+}
+
+static void clint_control_command(int fd, char *line)
+{
+  const char *words[3] = { NULL, NULL, NULL };
+  char *save = NULL;
+  char *word;
+  int count = 0;
+
+  for (word = strtok_r(line, " \t\r", &save); word != NULL && count < 3; word = strtok_r(NULL, " \t\r", &save))
+    words[count++] = word;
+  if (count == 0)
+    return;
+  if (strcasecmp(words[0], "get") == 0) {
+    clint_control_get(fd, words[1]);
+  } else if (strcasecmp(words[0], "set") == 0) {
+    clint_control_set(fd, words[1], words[2]);
+  } else if (strcasecmp(words[0], "report") == 0) {
+    clint_opencl_report(0);
+    clint_control_reply(fd, "ok\n");
+  } else if (strcasecmp(words[0], "leaks") == 0) {
+    if (clint_get_config(CLINT_TRACK)) {
+      clint_log_leaks_all();
+      clint_control_reply(fd, "ok\n");
+    } else {
+      clint_control_reply(fd, "error: CLINT_TRACK is off\n");
+    }
+  } else if (strcasecmp(words[0], "help") == 0) {
+    clint_control_reply(fd, "get [<option>]\nset <option> <value>\nreport\nleaks\nok\n");
+  } else {
+    clint_control_reply(fd, "error: unknown command %s\n", words[0]);
+  }
+}
+
+/* Serve one client until it hangs up, or we are shutting down. */
+static int clint_control_serve(int fd)
+{
+  char buf[CLINT_CONTROL_LINE];
+  size_t used = 0;
+
+  for (;;) {
+    struct pollfd fds[2];
+    ssize_t n;
+    char *end;
+
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = g_clint_control_wake[0];
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return 0;
+    }
+    if (fds[1].revents != 0)
+      return 1;
+    n = recv(fd, buf + used, sizeof(buf) - 1 - used, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    used += (size_t)n;
+    buf[used] = 0;
+    while ((end = strchr(buf, '\n')) != NULL) {
+      ClintAutopool pool;
+      *end = 0;
+      clint_autopool_begin(&pool);
+      clint_control_command(fd, buf);
+      clint_autopool_end(&pool);
+      used -= (size_t)(end + 1 - buf);
+      memmove(buf, end + 1, used + 1);
+    }
+    if (used == sizeof(buf) - 1) {
+      clint_control_reply(fd, "error: line too long\n");
+      used = 0;
+    }
+  }
+}
+
+static void *clint_control_listen(void *arg)
+{
+  (void)arg;
+  for (;;) {
+    struct pollfd fds[2];
+    int client;
+    int stop;
+
+    fds[0].fd = g_clint_control_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = g_clint_control_wake[0];
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents != 0)
+      break;
+    client = accept(g_clint_control_fd, NULL, NULL);
+    if (client < 0)
+      continue;
+    stop = clint_control_serve(client);
+    close(client);
+    if (stop)
+      break;
+  }
+  return NULL;
+}
+
+/* A directory left by an earlier process with our pid is reused only if it is
+   still private to us. */
+static int clint_control_mkdir(const char *dir)
+{
+  struct stat st;
+
+  if (mkdir(dir, 0700) == 0)
+    return 1;
+  if (errno != EEXIST || lstat(dir, &st) != 0)
+    return 0;
+  if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 077) != 0) {
+    errno = EPERM;
+    return 0;
+  }
+  return 1;
+}
+
+void clint_control_init(void)
+{
+  const char *dir = clint_get_config_string(CLINT_CONTROL);
+  struct sockaddr_un addr;
+  struct stat st;
+  int size;
+
+  /* Also for CLINT_CONTROL = 1. */
+  if (dir == NULL || stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+    dir = "/tmp";
+  snprintf(g_clint_control_dir, sizeof(g_clint_control_dir), "%s/clint.%ld", dir, (long)clint_get_process_id());
+  size = snprintf(g_clint_control_path, sizeof(g_clint_control_path), "%s/sock", g_clint_control_dir);
+  if (size < 0 || size >= (int)sizeof(g_clint_control_path)) {
+    clint_log("Control: socket path in %s is too long.\n", dir);
+    return;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, g_clint_control_path, (size_t)size + 1);
+
+  if (!clint_control_mkdir(g_clint_control_dir)) {
+    clint_log("Control: unable to create %s: %s\n", g_clint_control_dir, strerror(errno));
+    return;
+  }
+  g_clint_control_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (g_clint_control_fd < 0) {
+    clint_log("Control: socket() failed: %s\n", strerror(errno));
+    rmdir(g_clint_control_dir);
+    return;
+  }
+  unlink(g_clint_control_path);
+  if (bind(g_clint_control_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(g_clint_control_fd, 4) != 0 ||
+      pipe(g_clint_control_wake) != 0) {
+    clint_log("Control: unable to listen on %s: %s\n", g_clint_control_path, strerror(errno));
+    close(g_clint_control_fd);
+    g_clint_control_fd = -1;
+    unlink(g_clint_control_path);
+    rmdir(g_clint_control_dir);
+    return;
+  }
+  if (pthread_create(&g_clint_control_thread, NULL, clint_control_listen, NULL) != 0) {
+    clint_log("Control: unable to start a thread.\n");
+    clint_control_shutdown();
+    return;
+  }
+  g_clint_control_started = 1;
+  clint_log("Control: listening on %s\n", g_clint_control_path);
+}
+
+void clint_control_shutdown(void)
+{
+  if (g_clint_control_fd < 0)
+    return;
+  if (g_clint_control_started) {
+    ssize_t n;
+    do {
+      n = write(g_clint_control_wake[1], "", 1);
+    } while (n < 0 && errno == EINTR);
+    pthread_join(g_clint_control_thread, NULL);
+    g_clint_control_started = 0;
+  }
+  close(g_clint_control_fd);
+  g_clint_control_fd = -1;
+  if (g_clint_control_wake[0] >= 0) {
+    close(g_clint_control_wake[0]);
+    close(g_clint_control_wake[1]);
+    g_clint_control_wake[0] = g_clint_control_wake[1] = -1;
+  }
+  unlink(g_clint_control_path);
+  rmdir(g_clint_control_dir);
+}
+
+#endif
@@ -118,12 +118,13 @@ const char *clint_string_vsprintf(const char *fmt, va_list ap)
 {
   size_t size;
   char *buf;
-  char tmp[8];
+  char tmp[256];
   va_list ap2;
 
+  /* Most strings fit in tmp, so they are formatted only once. */
   va_copy(ap2, ap);
 #if defined(WIN32)
-  size = (size_t)vsprintf_s(tmp, sizeof(tmp), fmt, ap2) + 1;
+  size = (size_t)_vscprintf(fmt, ap2) + 1;
 #else
   size = (size_t)vsnprintf(tmp, sizeof(tmp), fmt, ap2) + 1;
 #endif
@@ -132,7 +133,10 @@ const char *clint_string_vsprintf(const char *fmt, va_list ap)
 #if defined(WIN32)
   vsprintf_s(buf, size, fmt, ap);
 #else
-  vsnprintf(buf, size, fmt, ap);
+  if (size <= sizeof(tmp))
+    memcpy(buf, tmp, size);
+  else
+    vsnprintf(buf, size, fmt, ap);
 #endif
 
   return buf;
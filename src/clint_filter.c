@@ -0,0 +1,181 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_filter.h"
+#include "clint_atomic.h"
+#include "clint_config.h"
+#include "clint_filter_rules.h"
+#include "clint_kernels.h"
+#include "clint_log.h"
+#include "clint_opencl_funcs.h"
+#include "clint_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+unsigned char g_clint_filter_funcs[ClintFunc_max];
+volatile cl_ulong g_clint_filter_stop = 0;
+
+/* The bits set when the trace starts, and cleared again when it stops. */
+static unsigned char g_clint_filter_traced[ClintFunc_max];
+static ClintFilterRules g_clint_filter_trace;
+static ClintFilterRules g_clint_filter_kernels;
+static ClintFilterRules g_clint_filter_start;
+static cl_ulong g_clint_filter_start_launch = 0;
+static cl_ulong g_clint_filter_launches = 0;
+static ClintSpinLock g_clint_filter_lock;
+
+static void clint_filter_start_trace(void)
+{
+  int seconds = clint_get_config(CLINT_TRACE_SECONDS);
+  int i;
+
+  CLINT_SPINLOCK_LOCK(g_clint_filter_lock);
+  if (seconds > 0)
+    g_clint_filter_stop = clint_time_now() + (cl_ulong)seconds * 1000000000;
+  CLINT_MEMORY_BARRIER();
+  for (i = 0; i < ClintFunc_max; i++)
+    g_clint_filter_funcs[i] = (g_clint_filter_funcs[i] & CLINT_FILTER_RECORD) | g_clint_filter_traced[i];
+  CLINT_SPINLOCK_UNLOCK(g_clint_filter_lock);
+}
+
+void clint_filter_init(void)
+{
+  const char *start = clint_get_config_string(CLINT_TRACE_START);
+  int trace = clint_get_config(CLINT_TRACE);
+  int binary = clint_get_config(CLINT_TRACE_BINARY);
+  int record = clint_get_config(CLINT_FLIGHT_RECORDER);
+  int i;
+
+  clint_filter_compile(&g_clint_filter_trace, clint_get_config_string(CLINT_TRACE_FUNCS));
+  clint_filter_compile(&g_clint_filter_kernels, clint_get_config_string(CLINT_PROFILE_KERNELS));
+  for (i = 0; i < ClintFunc_max; i++) {
+    unsigned char bits = 0;
+    if (clint_filter_match(&g_clint_filter_trace, clint_func_name((ClintFunc)i))) {
+      if (trace)
+        bits |= CLINT_FILTER_TRACE;
+      if (binary)
+        bits |= CLINT_FILTER_BINARY;
+    }
+    g_clint_filter_traced[i] = bits;
+    g_clint_filter_funcs[i] = record ? CLINT_FILTER_RECORD : 0;
+  }
+
+  if (start != NULL) {
+    /* "<kernel>:<launch>", or just "<kernel>" for its first launch. */
+    const char *colon = strrchr(start, ':');
+    size_t len = (colon != NULL) ? (size_t)(colon - start) : strlen(start);
+    char *name = (char*)malloc(len + 1);
+    if (name != NULL) {
+      memcpy(name, start, len);
+      name[len] = 0;
+    }
+    if (colon != NULL)
+      g_clint_filter_start_launch = strtoul(colon + 1, NULL, 0);
+    if (g_clint_filter_start_launch == 0)
+      g_clint_filter_start_launch = 1;
+    clint_filter_compile(&g_clint_filter_start, name);
+    free(name);
+    if (g_clint_filter_start.count > 0) {
+      g_clint_filter_funcs[ClintFunc_clEnqueueNDRangeKernel] |= CLINT_FILTER_LAUNCH;
+      g_clint_filter_funcs[ClintFunc_clEnqueueTask] |= CLINT_FILTER_LAUNCH;
+      return;
+    }
+  }
+  clint_filter_start_trace();
+}
+
+void clint_filter_update(void)
+{
+  int trace = clint_get_config(CLINT_TRACE);
+  int binary = clint_get_config(CLINT_TRACE_BINARY);
+  int waiting;
+  int i;
+
+  CLINT_SPINLOCK_LOCK(g_clint_filter_lock);
+  for (i = 0; i < ClintFunc_max; i++) {
+    unsigned char bits = 0;
+    if (clint_filter_match(&g_clint_filter_trace, clint_func_name((ClintFunc)i))) {
+      if (trace)
+        bits |= CLINT_FILTER_TRACE;
+      if (binary)
+        bits |= CLINT_FILTER_BINARY;
+    }
+    g_clint_filter_traced[i] = bits;
+  }
+  waiting = (g_clint_filter_start.count > 0 && g_clint_filter_launches < g_clint_filter_start_launch);
+  CLINT_SPINLOCK_UNLOCK(g_clint_filter_lock);
+  /* Otherwise the new bits go in when CLINT_TRACE_START triggers. */
+  if (!waiting)
+    clint_filter_start_trace();
+}
+
+int clint_filter_live(void)
+{
+  int i;
+
+  if (clint_time_now() < g_clint_filter_stop)
+    return 1;
+  CLINT_SPINLOCK_LOCK(g_clint_filter_lock);
+  if (g_clint_filter_stop != 0) {
+    for (i = 0; i < ClintFunc_max; i++)
+      g_clint_filter_funcs[i] &= ~(CLINT_FILTER_TRACE | CLINT_FILTER_BINARY);
+    g_clint_filter_stop = 0;
+    clint_log("Trace: stopped after %d seconds\n", clint_get_config(CLINT_TRACE_SECONDS));
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_filter_lock);
+  return 0;
+}
+
+int clint_filter_kernel(const char *name)
+{
+  int bits = 0;
+
+  if (clint_filter_match(&g_clint_filter_kernels, name))
+    bits |= CLINT_FILTER_PROFILE;
+  if (g_clint_filter_start.count > 0 && clint_filter_match(&g_clint_filter_start, name))
+    bits |= CLINT_FILTER_START;
+  return bits;
+}
+
+void clint_filter_launch(cl_kernel kernel)
+{
+  ClintKernelStats *stats = clint_kernels_lookup(kernel);
+  int start = 0;
+
+  if (stats == NULL || (stats->filter & CLINT_FILTER_START) == 0)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_filter_lock);
+  if (g_clint_filter_launches < g_clint_filter_start_launch)
+    start = (++g_clint_filter_launches == g_clint_filter_start_launch);
+  CLINT_SPINLOCK_UNLOCK(g_clint_filter_lock);
+  if (start) {
+    clint_log("Trace: started at launch %lu of %s\n", (unsigned long)g_clint_filter_launches, stats->name);
+    clint_filter_start_trace();
+  }
+}
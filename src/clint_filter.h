@@ -0,0 +1,75 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_FILTER_H_
+#define _CLINT_FILTER_H_
+
+#ifdef __APPLE__
+#include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What each function is traced for, indexed by ClintFunc.  Compiled from the
+   config by clint_filter_init(), so a call that is filtered out only tests a
+   bit.  All clear until then, and after CLINT_TRACE_SECONDS. */
+#define CLINT_FILTER_TRACE 1
+#define CLINT_FILTER_BINARY 2
+#define CLINT_FILTER_RECORD 4
+/* Kernel launches counted for CLINT_TRACE_START until it triggers. */
+#define CLINT_FILTER_LAUNCH 8
+
+extern unsigned char g_clint_filter_funcs[];
+extern volatile cl_ulong g_clint_filter_stop;
+
+#define CLINT_FILTER(func, bits) (g_clint_filter_funcs[func] & (bits))
+/* As CLINT_FILTER, but also ends the trace once CLINT_TRACE_SECONDS are up. */
+#define CLINT_FILTER_LIVE(func, bits) \
+  (CLINT_FILTER(func, bits) && (g_clint_filter_stop == 0 || clint_filter_live()))
+
+/* Bits of ClintKernelStats.filter, matched once per kernel name. */
+#define CLINT_FILTER_PROFILE 1
+#define CLINT_FILTER_START 2
+
+void clint_filter_init(void);
+/* Apply a change to CLINT_TRACE made at runtime, restarting CLINT_TRACE_SECONDS. */
+void clint_filter_update(void);
+int clint_filter_live(void);
+int clint_filter_kernel(const char *name);
+/* Count a launch for CLINT_TRACE_START. */
+void clint_filter_launch(cl_kernel kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_FILTER_H_
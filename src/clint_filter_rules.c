@@ -0,0 +1,114 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_filter_rules.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+void clint_filter_compile(ClintFilterRules *rules, const char *s)
+{
+  const char *end;
+  int n = 0;
+
+  memset(rules, 0, sizeof(ClintFilterRules));
+  if (s == NULL)
+    return;
+  for (end = s; *end; end++) {
+    if (isspace(*end) || *end == ',' || *end == ';')
+      n++;
+  }
+  rules->patterns = (char**)calloc(n + 1, sizeof(char*));
+  rules->exclude = (int*)calloc(n + 1, sizeof(int));
+  if (rules->patterns == NULL || rules->exclude == NULL)
+    return;
+  while (*s) {
+    int exclude = 0;
+    while (isspace(*s) || *s == ',' || *s == ';')
+      s++;
+    if (*s == '-') {
+      exclude = 1;
+      s++;
+    }
+    for (end = s; *end && !isspace(*end) && *end != ',' && *end != ';'; end++)
+      ;
+    if (end > s && rules->count <= n) {
+      char *pattern = (char*)malloc(end - s + 1);
+      if (pattern == NULL)
+        return;
+      memcpy(pattern, s, end - s);
+      pattern[end - s] = 0;
+      rules->patterns[rules->count] = pattern;
+      rules->exclude[rules->count] = exclude;
+      rules->count++;
+    }
+    s = end;
+  }
+}
+
+int clint_filter_glob(const char *pattern, const char *name)
+{
+  const char *star = NULL;
+  const char *retry = NULL;
+
+  while (*name) {
+    if (*pattern == '*') {
+      star = ++pattern;
+      retry = name;
+    } else if (*pattern == '?' || *pattern == *name) {
+      pattern++;
+      name++;
+    } else if (star != NULL) {
+      pattern = star;
+      name = ++retry;
+    } else {
+      return 0;
+    }
+  }
+  while (*pattern == '*')
+    pattern++;
+  return *pattern == 0;
+}
+
+int clint_filter_match(const ClintFilterRules *rules, const char *name)
+{
+  int match;
+  int i;
+
+  if (rules->count == 0)
+    return 1;
+  if (name == NULL)
+    return 0;
+  match = rules->exclude[0];
+  for (i = 0; i < rules->count; i++) {
+    if (clint_filter_glob(rules->patterns[i], name))
+      match = !rules->exclude[i];
+  }
+  return match;
+}
@@ -0,0 +1,55 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_FILTER_RULES_H_
+#define _CLINT_FILTER_RULES_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A list of patterns such as "clEnqueue*, -clEnqueueMarker*", split once at
+   init.  The last pattern that matches a name decides: included, or excluded
+   with a leading '-'.  Names no pattern matches are included only if the first
+   pattern is an exclusion.  An empty list matches everything. */
+typedef struct ClintFilterRules {
+  int count;
+  char **patterns;
+  int *exclude;
+} ClintFilterRules;
+
+void clint_filter_compile(ClintFilterRules *rules, const char *s);
+/* '*' matches any run of characters and '?' any one. */
+int clint_filter_glob(const char *pattern, const char *name);
+int clint_filter_match(const ClintFilterRules *rules, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_FILTER_RULES_H_
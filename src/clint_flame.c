@@ -0,0 +1,170 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_flame.h"
+#include "clint_atomic.h"
+#include "clint_config.h"
+#include "clint_log.h"
+#include "clint_stack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CLINT_FLAME_DEPTH 64
+#define CLINT_FLAME_BUCKETS 1024
+
+struct ClintFlameStack {
+  struct ClintFlameStack *next;
+  const char *name;
+  unsigned int hash;
+  int depth;
+  cl_ulong device_ns;
+  void *frames[1];
+};
+
+static ClintFlameStack *g_clint_flame_stacks[CLINT_FLAME_BUCKETS];
+static ClintSpinLock g_clint_flame_lock;
+
+static unsigned int clint_flame_hash(void **frames, int depth, const char *name)
+{
+  size_t h = (size_t)name;
+  int i;
+
+  for (i = 0; i < depth; i++)
+    h = h * 31 + (size_t)frames[i];
+  return (unsigned int)(h ^ (h >> 16));
+}
+
+/* Stacks are interned when captured, so recording only adds to the totals.
+   name must outlive the stack; command and kernel names do. */
+ClintFlameStack *clint_flame_capture(const char *name)
+{
+  void *frames[CLINT_FLAME_DEPTH];
+  ClintFlameStack *stack;
+  unsigned int hash;
+  int depth;
+
+  depth = clint_get_frames(frames, CLINT_FLAME_DEPTH);
+  if (depth <= 0)
+    return NULL;
+  hash = clint_flame_hash(frames, depth, name);
+
+  CLINT_SPINLOCK_LOCK(g_clint_flame_lock);
+  for (stack = g_clint_flame_stacks[hash % CLINT_FLAME_BUCKETS]; stack != NULL; stack = stack->next) {
+    if (stack->hash == hash && stack->depth == depth && stack->name == name &&
+        memcmp(stack->frames, frames, sizeof(void*) * depth) == 0)
+      break;
+  }
+  if (stack == NULL) {
+    stack = (ClintFlameStack*)calloc(1, sizeof(ClintFlameStack) + sizeof(void*) * (depth - 1));
+    if (stack != NULL) {
+      stack->name = name;
+      stack->hash = hash;
+      stack->depth = depth;
+      memcpy(stack->frames, frames, sizeof(void*) * depth);
+      stack->next = g_clint_flame_stacks[hash % CLINT_FLAME_BUCKETS];
+      g_clint_flame_stacks[hash % CLINT_FLAME_BUCKETS] = stack;
+    }
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_flame_lock);
+  return stack;
+}
+
+void clint_flame_record(ClintFlameStack *stack, cl_ulong ns)
+{
+  if (stack == NULL)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_flame_lock);
+  stack->device_ns += ns;
+  CLINT_SPINLOCK_UNLOCK(g_clint_flame_lock);
+}
+
+/* Folded stacks are outermost first, separated by ';', followed by a space and
+   the weight, here device time in microseconds. */
+static void clint_flame_write(FILE *fp, const ClintFlameStack *stack)
+{
+  char function[256];
+  char *p;
+  int top = stack->depth;
+  int bottom = 0;
+  int i;
+
+  /* Skip our own frames: the capture and the intercepted entry point. */
+  while (bottom < top && clint_is_own_frame(stack->frames[bottom]))
+    bottom++;
+  for (i = top - 1; i >= bottom; i--) {
+    clint_get_function(stack->frames[i], function, sizeof(function));
+    for (p = function; *p; p++) {
+      if (*p == ';' || *p == ' ')
+        *p = '_';
+    }
+    fprintf(fp, "%s;", function);
+  }
+  fprintf(fp, "%s %lu\n", stack->name, (unsigned long)((stack->device_ns + 500) / 1000));
+}
+
+void clint_flame_report(int final)
+{
+  const char *path = clint_get_config_string(CLINT_PROFILE_STACKS);
+  ClintFlameStack *stack;
+  cl_ulong stacks = 0;
+  cl_ulong device_ns = 0;
+  FILE *fp;
+  int i;
+
+  if (path == NULL)
+    return;
+#if defined(WIN32)
+  if (fopen_s(&fp, path, "w") != 0)
+    fp = NULL;
+#else
+  fp = fopen(path, "w");
+#endif
+  if (fp == NULL) {
+    clint_log("Stacks: can't write %s\n", path);
+    return;
+  }
+  CLINT_SPINLOCK_LOCK(g_clint_flame_lock);
+  for (i = 0; i < CLINT_FLAME_BUCKETS; i++) {
+    for (stack = g_clint_flame_stacks[i]; stack != NULL; stack = stack->next) {
+      if (stack->device_ns == 0)
+        continue;
+      clint_flame_write(fp, stack);
+      stacks++;
+      device_ns += stack->device_ns;
+      /* Only report once, even if we're shutdown again. */
+      if (final)
+        stack->device_ns = 0;
+    }
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_flame_lock);
+  fclose(fp);
+  clint_log("Stacks: %lu stacks with %f s of device time written to %s\n",
+            (unsigned long)stacks, (double)device_ns * 1.0e-9, path);
+}
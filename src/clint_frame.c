@@ -0,0 +1,237 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_frame.h"
+#include "clint_atomic.h"
+#include "clint_config.h"
+#include "clint_log.h"
+#include "clint_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Commands finish after their frame has ended, so a frame is only final once
+   CLINT_FRAME_LAG more have started.  Later completions are dropped. */
+#define CLINT_FRAME_RING 256
+#define CLINT_FRAME_LAG 128
+#define CLINT_FRAME_WORST 10
+
+typedef struct ClintFrame {
+  cl_uint frame;
+  cl_ulong begin;
+  cl_ulong host_ns;
+  cl_ulong device_ns;
+  cl_ulong bytes;
+  cl_uint commands;
+  cl_uint kernels;
+} ClintFrame;
+
+static int g_clint_frame_func = -1;
+static int g_clint_frame_marker = 0;
+static const char *g_clint_frame_marker_name = NULL;
+
+static ClintSpinLock g_clint_frame_lock;
+static volatile cl_uint g_clint_frame = 0;
+static ClintFrame g_clint_frames[CLINT_FRAME_RING];
+/* Host time of every final frame, for percentiles. */
+static cl_ulong *g_clint_frame_times = NULL;
+static size_t g_clint_frame_count = 0;
+static size_t g_clint_frame_capacity = 0;
+static cl_ulong g_clint_frame_device_ns = 0;
+static ClintFrame g_clint_frame_worst[CLINT_FRAME_WORST];
+
+void clint_frame_init(void)
+{
+  const char *trigger = clint_get_config_string(CLINT_PROFILE_FRAME);
+  int i;
+
+  if (trigger == NULL)
+    return;
+  if (strncmp(trigger, "marker", 6) == 0) {
+    g_clint_frame_marker = 1;
+    if (trigger[6] == ':' && trigger[7] != 0)
+      g_clint_frame_marker_name = trigger + 7;
+    return;
+  }
+  for (i = 0; i < ClintFunc_max; i++) {
+    if (strcmp(trigger, clint_func_name((ClintFunc)i)) == 0) {
+      g_clint_frame_func = i;
+      return;
+    }
+  }
+  clint_log("CLINT_PROFILE_FRAME: unknown trigger %s\n", trigger);
+}
+
+/* Called with the lock held. */
+static void clint_frame_finish(ClintFrame *f)
+{
+  int i, j;
+
+  if (f->frame == 0 || f->host_ns == 0)
+    return;
+  if (g_clint_frame_count == g_clint_frame_capacity) {
+    size_t capacity = g_clint_frame_capacity ? g_clint_frame_capacity * 2 : 1024;
+    cl_ulong *times = (cl_ulong*)realloc(g_clint_frame_times, sizeof(cl_ulong) * capacity);
+    if (times == NULL)
+      return;
+    g_clint_frame_times = times;
+    g_clint_frame_capacity = capacity;
+  }
+  g_clint_frame_times[g_clint_frame_count++] = f->host_ns;
+  g_clint_frame_device_ns += f->device_ns;
+  for (i = 0; i < CLINT_FRAME_WORST && g_clint_frame_worst[i].host_ns >= f->host_ns; i++)
+    ;
+  if (i < CLINT_FRAME_WORST) {
+    for (j = CLINT_FRAME_WORST - 1; j > i; j--)
+      g_clint_frame_worst[j] = g_clint_frame_worst[j - 1];
+    g_clint_frame_worst[i] = *f;
+  }
+  f->frame = 0;
+}
+
+static void clint_frame_boundary(void)
+{
+  cl_ulong now = clint_time_now();
+  ClintFrame *f;
+  cl_uint frame;
+
+  CLINT_SPINLOCK_LOCK(g_clint_frame_lock);
+  frame = g_clint_frame;
+  if (frame != 0)
+    g_clint_frames[frame % CLINT_FRAME_RING].host_ns = now - g_clint_frames[frame % CLINT_FRAME_RING].begin;
+  if (frame >= CLINT_FRAME_LAG)
+    clint_frame_finish(&g_clint_frames[(frame - CLINT_FRAME_LAG) % CLINT_FRAME_RING]);
+  frame++;
+  f = &g_clint_frames[frame % CLINT_FRAME_RING];
+  clint_frame_finish(f);
+  memset(f, 0, sizeof(ClintFrame));
+  f->frame = frame;
+  f->begin = now;
+  g_clint_frame = frame;
+  CLINT_SPINLOCK_UNLOCK(g_clint_frame_lock);
+}
+
+void clint_frame_call(ClintFunc func)
+{
+  if ((int)func == g_clint_frame_func)
+    clint_frame_boundary();
+}
+
+void clint_frame_marker(const char *name)
+{
+  if (g_clint_frame_marker &&
+      (g_clint_frame_marker_name == NULL || strcmp(name, g_clint_frame_marker_name) == 0))
+    clint_frame_boundary();
+}
+
+cl_uint clint_frame_current(void)
+{
+  return g_clint_frame;
+}
+
+void clint_frame_enqueue(cl_uint frame, int kernel)
+{
+  ClintFrame *f = &g_clint_frames[frame % CLINT_FRAME_RING];
+
+  if (frame == 0)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_frame_lock);
+  if (f->frame == frame) {
+    f->commands++;
+    if (kernel)
+      f->kernels++;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_frame_lock);
+}
+
+void clint_frame_command(cl_uint frame, cl_ulong ns, size_t bytes)
+{
+  ClintFrame *f = &g_clint_frames[frame % CLINT_FRAME_RING];
+
+  if (frame == 0)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_frame_lock);
+  if (f->frame == frame) {
+    f->device_ns += ns;
+    f->bytes += bytes;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_frame_lock);
+}
+
+static int clint_frame_compare(const void *a, const void *b)
+{
+  cl_ulong ta = *(const cl_ulong*)a;
+  cl_ulong tb = *(const cl_ulong*)b;
+
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+static double clint_frame_percentile(double q)
+{
+  size_t rank = (size_t)(q * (double)g_clint_frame_count);
+
+  if (rank >= g_clint_frame_count)
+    rank = g_clint_frame_count - 1;
+  return (double)g_clint_frame_times[rank] * 1.0e-6;
+}
+
+void clint_frame_report(int final)
+{
+  int i;
+
+  CLINT_SPINLOCK_LOCK(g_clint_frame_lock);
+  /* The frame in progress never ended, so it isn't counted.  A snapshot
+     leaves the frames still in flight to finish on their own. */
+  for (i = 0; final && i < CLINT_FRAME_RING; i++)
+    clint_frame_finish(&g_clint_frames[i]);
+  if (g_clint_frame_count > 0) {
+    qsort(g_clint_frame_times, g_clint_frame_count, sizeof(cl_ulong), clint_frame_compare);
+    clint_log("Frame statistics: %lu frames, mean device time %.3f ms\n",
+              (unsigned long)g_clint_frame_count,
+              (double)g_clint_frame_device_ns * 1.0e-6 / (double)g_clint_frame_count);
+    clint_log("\tframe time p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+              clint_frame_percentile(0.5), clint_frame_percentile(0.9),
+              clint_frame_percentile(0.99), clint_frame_percentile(1.0));
+    clint_log("\tworst frames:\n");
+    clint_log("\t%10s %12s %12s %10s %10s %12s\n",
+              "frame", "host (ms)", "device (ms)", "commands", "kernels", "bytes");
+    for (i = 0; i < CLINT_FRAME_WORST && g_clint_frame_worst[i].host_ns > 0; i++) {
+      const ClintFrame *f = &g_clint_frame_worst[i];
+      clint_log("\t%10u %12.3f %12.3f %10u %10u %12lu\n",
+                f->frame, (double)f->host_ns * 1.0e-6, (double)f->device_ns * 1.0e-6,
+                f->commands, f->kernels, (unsigned long)f->bytes);
+    }
+  }
+  /* Only report once, even if we're shutdown again. */
+  if (final) {
+    g_clint_frame_count = 0;
+    g_clint_frame_device_ns = 0;
+    memset(g_clint_frame_worst, 0, sizeof(g_clint_frame_worst));
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_frame_lock);
+}
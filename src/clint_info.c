@@ -0,0 +1,289 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_info.h"
+#include "clint.h"
+#include "clint_config.h"
+#include "clint_data.h"
+#include "clint_info_handles.h"
+#include "clint_log.h"
+#include "clint_thread.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Bump when the report format changes, so old cache files are not used. */
+#define CLINT_INFO_CACHE_VERSION 1
+
+#if defined(WIN32)
+static HANDLE g_clint_info_thread;
+#else
+static pthread_t g_clint_info_thread;
+#endif
+static int g_clint_info_started;
+
+static void clint_info_hash(cl_ulong *hash, const void *data, size_t size)
+{
+  const unsigned char *p = (const unsigned char*)data;
+  size_t i;
+
+  /* FNV-1a */
+  for (i = 0; i < size; i++) {
+    *hash ^= p[i];
+    *hash *= 1099511628211ULL;
+  }
+}
+
+static void clint_info_hash_platform(const ClintLogApi *api, cl_ulong *hash, cl_platform_id platform,
+                                     cl_platform_info param)
+{
+  char buf[1024];
+  size_t size = 0;
+
+  if (api->GetPlatformInfo(platform, param, sizeof(buf), buf, &size) == CL_SUCCESS && size <= sizeof(buf))
+    clint_info_hash(hash, buf, size);
+  clint_info_hash(hash, "\n", 1);
+}
+
+static void clint_info_hash_device(const ClintLogApi *api, cl_ulong *hash, cl_device_id device,
+                                   cl_device_info param)
+{
+  char buf[1024];
+  size_t size = 0;
+
+  if (api->GetDeviceInfo(device, param, sizeof(buf), buf, &size) == CL_SUCCESS && size <= sizeof(buf))
+    clint_info_hash(hash, buf, size);
+  clint_info_hash(hash, "\n", 1);
+}
+
+/* List the platforms and devices, and key the report by what it depends on. */
+static cl_ulong clint_info_identify(const ClintLogApi *api, ClintInfoHandles *handles)
+{
+  cl_ulong hash = 14695981039346656037ULL;
+  int version = CLINT_INFO_CACHE_VERSION;
+  cl_platform_id *platforms;
+  cl_uint count = 0, i;
+  int devices_seen = 0;
+
+  clint_info_hash(&hash, &version, sizeof(version));
+  if (api->GetPlatformIDs(0, NULL, &count) != CL_SUCCESS || count == 0)
+    return hash;
+  platforms = (cl_platform_id*)malloc(sizeof(cl_platform_id) * count);
+  if (platforms == NULL)
+    return hash;
+  if (api->GetPlatformIDs(count, platforms, NULL) == CL_SUCCESS) {
+    clint_info_hash(&hash, &count, sizeof(count));
+    for (i = 0; i < count; i++) {
+      cl_device_id *devices;
+      cl_uint num = 0, j;
+
+      clint_info_add(handles, platforms[i], "platform", (int)i);
+      clint_info_hash_platform(api, &hash, platforms[i], CL_PLATFORM_NAME);
+      clint_info_hash_platform(api, &hash, platforms[i], CL_PLATFORM_VERSION);
+      if (api->GetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, 0, NULL, &num) != CL_SUCCESS || num == 0)
+        continue;
+      devices = (cl_device_id*)malloc(sizeof(cl_device_id) * num);
+      if (devices == NULL)
+        continue;
+      if (api->GetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, num, devices, NULL) == CL_SUCCESS) {
+        clint_info_hash(&hash, &num, sizeof(num));
+        for (j = 0; j < num; j++) {
+          clint_info_add(handles, devices[j], "device", devices_seen++);
+          clint_info_hash_device(api, &hash, devices[j], CL_DEVICE_NAME);
+          clint_info_hash_device(api, &hash, devices[j], CL_DEVICE_VERSION);
+          clint_info_hash_device(api, &hash, devices[j], CL_DRIVER_VERSION);
+        }
+      }
+      free(devices);
+    }
+  }
+  free(platforms);
+  return hash;
+}
+
+static char *clint_info_read(const char *path)
+{
+  FILE *fp;
+  char *text = NULL;
+  long size;
+
+#if defined(WIN32)
+  if (fopen_s(&fp, path, "rb") != 0)
+    return NULL;
+#else
+  if ((fp = fopen(path, "rb")) == NULL)
+    return NULL;
+#endif
+  if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+    text = (char*)malloc((size_t)size + 1);
+    if (text != NULL) {
+      if (fread(text, 1, (size_t)size, fp) == (size_t)size) {
+        text[size] = 0;
+      } else {
+        free(text);
+        text = NULL;
+      }
+    }
+  }
+  fclose(fp);
+  return text;
+}
+
+/* Write to a temporary name first, so a reader never sees half a report. */
+static void clint_info_write(const char *path, const char *text)
+{
+  const char *tmp = clint_string_sprintf("%s.%u.tmp", path, (unsigned int)clint_get_process_id());
+  size_t size = strlen(text);
+  FILE *fp;
+  int ok;
+
+#if defined(WIN32)
+  if (fopen_s(&fp, tmp, "wb") != 0)
+    return;
+#else
+  if ((fp = fopen(tmp, "wb")) == NULL)
+    return;
+#endif
+  ok = (fwrite(text, 1, size, fp) == size);
+  if (fclose(fp) != 0)
+    ok = 0;
+  if (!ok || rename(tmp, path) != 0)
+    remove(tmp);
+}
+
+static void clint_info_report(void)
+{
+  ClintLogApi api;
+  ClintInfoHandles handles;
+  const char *dir = clint_get_config_string(CLINT_INFO_CACHE);
+  const char *path = NULL;
+  char *cached = NULL;
+  char *text;
+
+  /* Query the driver directly, so none of this is traced or checked. */
+  api.GetPlatformIDs = (cl_int (CL_API_CALL *)(cl_uint, cl_platform_id *, cl_uint *))
+    clint_opencl_func("clGetPlatformIDs");
+  api.GetPlatformInfo = (cl_int (CL_API_CALL *)(cl_platform_id, cl_platform_info, size_t, void *, size_t *))
+    clint_opencl_func("clGetPlatformInfo");
+  api.GetDeviceIDs = (cl_int (CL_API_CALL *)(cl_platform_id, cl_device_type, cl_uint, cl_device_id *, cl_uint *))
+    clint_opencl_func("clGetDeviceIDs");
+  api.GetDeviceInfo = (cl_int (CL_API_CALL *)(cl_device_id, cl_device_info, size_t, void *, size_t *))
+    clint_opencl_func("clGetDeviceInfo");
+  api.CreateContext = (cl_context (CL_API_CALL *)(const cl_context_properties *, cl_uint, const cl_device_id *,
+                                                  void (CL_CALLBACK *)(const char *, const void *, size_t, void *),
+                                                  void *, cl_int *))
+    clint_opencl_func("clCreateContext");
+  api.GetSupportedImageFormats = (cl_int (CL_API_CALL *)(cl_context, cl_mem_flags, cl_mem_object_type,
+                                                         cl_uint, cl_image_format *, cl_uint *))
+    clint_opencl_func("clGetSupportedImageFormats");
+  api.ReleaseContext = (cl_int (CL_API_CALL *)(cl_context))clint_opencl_func("clReleaseContext");
+  if (api.GetPlatformIDs == NULL || api.GetPlatformInfo == NULL || api.GetDeviceIDs == NULL ||
+      api.GetDeviceInfo == NULL || api.CreateContext == NULL || api.GetSupportedImageFormats == NULL ||
+      api.ReleaseContext == NULL) {
+    clint_log("CLINT_INFO: the driver is missing platform or device queries.\n");
+    return;
+  }
+  clint_log_platform_api(&api);
+
+  handles.count = 0;
+  handles.pointers = NULL;
+  handles.tokens = NULL;
+  if (dir != NULL && *dir != 0) {
+    cl_ulong key = clint_info_identify(&api, &handles);
+    path = clint_string_sprintf("%s/clint_info_%08x%08x.txt", dir,
+                                (unsigned int)(key >> 32), (unsigned int)key);
+    cached = clint_info_read(path);
+  }
+
+  if (cached != NULL) {
+    text = clint_info_replace(cached, handles.tokens, handles.pointers, handles.count);
+    free(cached);
+  } else {
+    text = clint_log_platforms_string();
+    if (text != NULL && path != NULL) {
+      char *generic = clint_info_replace(text, handles.pointers, handles.tokens, handles.count);
+      if (generic != NULL) {
+        clint_info_write(path, generic);
+        free(generic);
+      }
+    }
+  }
+  if (text != NULL) {
+    /* One write, so the report isn't interleaved with the application's calls. */
+    clint_log("%s", text);
+    free(text);
+  }
+  free(handles.pointers);
+  free(handles.tokens);
+}
+
+#if defined(WIN32)
+static DWORD WINAPI clint_info_thread(LPVOID arg)
+#else
+static void *clint_info_thread(void *arg)
+#endif
+{
+  ClintAutopool pool;
+
+  (void)arg;
+  clint_autopool_begin(&pool);
+  clint_info_report();
+  clint_autopool_end(&pool);
+  return 0;
+}
+
+void clint_info_start(void)
+{
+#if defined(WIN32)
+  g_clint_info_thread = CreateThread(NULL, 0, clint_info_thread, NULL, 0, NULL);
+  g_clint_info_started = (g_clint_info_thread != NULL);
+#else
+  g_clint_info_started = (pthread_create(&g_clint_info_thread, NULL, clint_info_thread, NULL) == 0);
+#endif
+  if (!g_clint_info_started)
+    clint_info_thread(NULL);
+}
+
+void clint_info_shutdown(void)
+{
+  if (!g_clint_info_started)
+    return;
+  g_clint_info_started = 0;
+#if defined(WIN32)
+  /* Waiting here could deadlock on the loader lock, from DllMain. */
+  CloseHandle(g_clint_info_thread);
+#else
+  pthread_join(g_clint_info_thread, NULL);
+#endif
+}
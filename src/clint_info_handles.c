@@ -0,0 +1,103 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_info_handles.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void clint_info_add(ClintInfoHandles *handles, void *p, const char *kind, int index)
+{
+  char (*pointers)[32];
+  char (*tokens)[32];
+
+  pointers = (char(*)[32])realloc(handles->pointers, sizeof(*pointers) * (handles->count + 1));
+  if (pointers == NULL)
+    return;
+  handles->pointers = pointers;
+  tokens = (char(*)[32])realloc(handles->tokens, sizeof(*tokens) * (handles->count + 1));
+  if (tokens == NULL)
+    return;
+  handles->tokens = tokens;
+  sprintf(pointers[handles->count], "%p", p);
+  sprintf(tokens[handles->count], "{%s %d}", kind, index);
+  handles->count++;
+}
+
+static int clint_info_word_char(char c)
+{
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+char *clint_info_replace(const char *text, char (*from)[32], char (*to)[32], int count)
+{
+  size_t size = strlen(text) + 1;
+  size_t len = 0;
+  char *out = (char*)malloc(size);
+  const char *p = text;
+  int i;
+
+  if (out == NULL)
+    return NULL;
+  while (*p != 0) {
+    const char *word = NULL;
+    size_t skip = 1;
+    if (p == text || !clint_info_word_char(p[-1])) {
+      for (i = 0; i < count; i++) {
+        size_t n = strlen(from[i]);
+        if (*p == from[i][0] && strncmp(p, from[i], n) == 0 && !clint_info_word_char(p[n])) {
+          word = to[i];
+          skip = n;
+          break;
+        }
+      }
+    }
+    if (word == NULL)
+      word = p;
+    if (len + (word == p ? 1 : strlen(word)) + 1 > size) {
+      char *grow;
+      size = size * 2 + strlen(word);
+      grow = (char*)realloc(out, size);
+      if (grow == NULL) {
+        free(out);
+        return NULL;
+      }
+      out = grow;
+    }
+    if (word == p) {
+      out[len++] = *p;
+    } else {
+      memcpy(out + len, word, strlen(word));
+      len += strlen(word);
+    }
+    p += skip;
+  }
+  out[len] = 0;
+  return out;
+}
@@ -0,0 +1,53 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_INFO_HANDLES_H_
+#define _CLINT_INFO_HANDLES_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The platforms and devices of this process, and how the report names them
+   in the cache: a handle is different every run, the report otherwise isn't. */
+typedef struct ClintInfoHandles {
+  int count;
+  char (*pointers)[32];
+  char (*tokens)[32];
+} ClintInfoHandles;
+
+/* Name handle p "{<kind> <index>}" in the cached report. */
+void clint_info_add(ClintInfoHandles *handles, void *p, const char *kind, int index);
+/* Copy text, replacing each whole word from[i] with to[i]; the copy is malloc'd. */
+char *clint_info_replace(const char *text, char (*from)[32], char (*to)[32], int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_INFO_HANDLES_H_
@@ -0,0 +1,505 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_kernels.h"
+#include "clint.h"
+#include "clint_atomic.h"
+#include "clint_baseline.h"
+#include "clint_config.h"
+#include "clint_data.h"
+#include "clint_filter.h"
+#include "clint_log.h"
+#include "clint_thread.h"
+#include "clint_time.h"
+#include "clint_tree.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Exact below 16 ns, then 16 buckets per doubling: about 6% wide, up to hours. */
+#define CLINT_KERNEL_STEPS 16
+#define CLINT_KERNEL_BUCKETS (CLINT_KERNEL_STEPS * 41)
+/* Devices and NDRange shapes with their own baseline, per kernel. */
+#define CLINT_KERNEL_VARIANTS 16
+/* Kernels each thread looks up without the lock. */
+#define CLINT_KERNEL_CACHE 64
+
+typedef cl_int (CL_API_CALL *ClintGetKernelInfoFn)(cl_kernel, cl_kernel_info, size_t, void *, size_t *);
+
+/* A baseline to compare once the lock is dropped. */
+typedef struct ClintKernelPercentiles {
+  cl_device_id device;
+  const char *name;
+  ClintKernelShape shape;
+  cl_ulong sampled;
+  double p50;
+  double p99;
+} ClintKernelPercentiles;
+
+typedef struct ClintKernel {
+  CLINT_TREE_ELEMS(struct ClintKernel, cl_kernel);
+  ClintKernelStats *stats;
+} ClintKernel;
+
+CLINT_DEFINE_TREE_FUNCS(ClintKernel, cl_kernel);
+CLINT_IMPL_TREE_FUNCS(ClintKernel, cl_kernel);
+
+/* A thread's recent lookups.  An entry is only valid while g_clint_kernels_generation
+   hasn't changed since, which it does whenever a handle is forgotten or reused. */
+typedef struct ClintKernelCache {
+  cl_kernel kernel;
+  ClintKernelStats *stats;
+  ClintAtomicInt generation;
+} ClintKernelCache;
+
+static ClintKernel *g_clint_kernels;
+static ClintKernelStats *g_clint_kernel_stats;
+static ClintSpinLock g_clint_kernels_lock;
+static ClintGetKernelInfoFn g_clint_get_kernel_info;
+static cl_ulong g_clint_kernels_random = 88172645463325252ULL;
+static int g_clint_kernels_init = 0;
+static ClintTLS g_clint_kernels_key;
+static ClintAtomicInt g_clint_kernels_generation = 0;
+
+void clint_kernels_init(void)
+{
+  if (g_clint_kernels_init == 0) {
+    g_clint_kernels_init = 1;
+    clint_tls_create(&g_clint_kernels_key);
+  }
+}
+
+static char *clint_kernels_name(cl_kernel kernel)
+{
+  size_t size = 0;
+  char *name;
+
+  if (g_clint_get_kernel_info == NULL)
+    g_clint_get_kernel_info = (ClintGetKernelInfoFn)clint_opencl_func("clGetKernelInfo");
+  if (g_clint_get_kernel_info == NULL ||
+      g_clint_get_kernel_info(kernel, CL_KERNEL_FUNCTION_NAME, 0, NULL, &size) != CL_SUCCESS ||
+      size == 0)
+    return NULL;
+  name = (char*)malloc(size);
+  if (name == NULL)
+    return NULL;
+  if (g_clint_get_kernel_info(kernel, CL_KERNEL_FUNCTION_NAME, size, name, NULL) != CL_SUCCESS) {
+    free(name);
+    return NULL;
+  }
+  name[size - 1] = 0;
+  return name;
+}
+
+/* Called with the lock held.  Uniform in [1, 2 * n - 1], so the mean gap is n
+   and periodic workloads don't alias with the sampling. */
+static cl_ulong clint_kernels_gap(cl_ulong n)
+{
+  cl_ulong x = g_clint_kernels_random;
+
+  if (n <= 1)
+    return 1;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  g_clint_kernels_random = x;
+  return 1 + x % (2 * n - 1);
+}
+
+/* Called with the lock held.  Takes ownership of name. */
+static ClintKernelStats *clint_kernels_stats(char *name)
+{
+  ClintKernelStats *stats;
+
+  for (stats = g_clint_kernel_stats; stats != NULL; stats = stats->next) {
+    if (strcmp(stats->name, name) == 0) {
+      free(name);
+      return stats;
+    }
+  }
+  stats = (ClintKernelStats*)calloc(1, sizeof(ClintKernelStats));
+  if (stats == NULL) {
+    free(name);
+    return NULL;
+  }
+  stats->name = name;
+  stats->filter = clint_filter_kernel(name);
+  stats->countdown = (ClintAtomicInt)clint_kernels_gap(clint_get_config(CLINT_PROFILE_SAMPLE));
+  CLINT_STACK_PUSH(g_clint_kernel_stats, stats);
+  return stats;
+}
+
+static ClintKernelStats *clint_kernels_insert(cl_kernel kernel)
+{
+  ClintKernel *k;
+  ClintKernelStats *stats = NULL;
+  char *name = clint_kernels_name(kernel);
+
+  if (name == NULL)
+    return NULL;
+  CLINT_SPINLOCK_LOCK(g_clint_kernels_lock);
+  stats = clint_kernels_stats(name);
+  /* A new kernel may reuse the handle of a released one. */
+  k = clint_tree_find_ClintKernel(g_clint_kernels, kernel);
+  if (k == NULL) {
+    k = (ClintKernel*)calloc(1, sizeof(ClintKernel));
+    if (k != NULL)
+      clint_tree_insert_ClintKernel(&g_clint_kernels, kernel, k);
+  } else if (k->stats != stats) {
+    CLINT_ATOMIC_ADD(1, g_clint_kernels_generation);
+  }
+  if (k != NULL)
+    k->stats = stats;
+  CLINT_SPINLOCK_UNLOCK(g_clint_kernels_lock);
+  return stats;
+}
+
+void clint_kernels_add(cl_kernel kernel)
+{
+  if (kernel != NULL)
+    clint_kernels_insert(kernel);
+}
+
+void clint_kernels_add_all(cl_uint num_kernels, const cl_kernel *kernels)
+{
+  cl_uint i;
+
+  if (kernels == NULL)
+    return;
+  for (i = 0; i < num_kernels; i++)
+    clint_kernels_add(kernels[i]);
+}
+
+ClintKernelStats *clint_kernels_lookup(cl_kernel kernel)
+{
+  ClintKernelCache *cache = NULL;
+  ClintKernelCache *entry = NULL;
+  ClintKernel *k;
+  ClintKernelStats *stats = NULL;
+  ClintAtomicInt generation = g_clint_kernels_generation;
+
+  if (kernel == NULL)
+    return NULL;
+  /* Launches look up the same few kernels over and over, so most never take the lock. */
+  if (g_clint_kernels_init) {
+    cache = (ClintKernelCache*)clint_tls_get(&g_clint_kernels_key);
+    if (cache == NULL) {
+      cache = (ClintKernelCache*)calloc(CLINT_KERNEL_CACHE, sizeof(ClintKernelCache));
+      if (cache != NULL)
+        clint_tls_set(&g_clint_kernels_key, cache);
+    }
+  }
+  if (cache != NULL) {
+    entry = &cache[((size_t)kernel >> 4) % CLINT_KERNEL_CACHE];
+    if (entry->kernel == kernel && entry->generation == generation)
+      return entry->stats;
+  }
+  CLINT_SPINLOCK_LOCK(g_clint_kernels_lock);
+  k = clint_tree_find_ClintKernel(g_clint_kernels, kernel);
+  if (k != NULL)
+    stats = k->stats;
+  CLINT_SPINLOCK_UNLOCK(g_clint_kernels_lock);
+  if (k == NULL) {
+    /* Created before we were loaded, or released and the handle reused. */
+    stats = clint_kernels_insert(kernel);
+  }
+  if (entry != NULL && stats != NULL) {
+    /* Stale from the start if the generation moved meanwhile. */
+    entry->kernel = kernel;
+    entry->stats = stats;
+    entry->generation = generation;
+  }
+  return stats;
+}
+
+void clint_kernels_release(cl_kernel kernel)
+{
+  ClintKernel *k;
+  cl_uint count = 0;
+
+  if (kernel == NULL)
+    return;
+  if (g_clint_get_kernel_info == NULL)
+    g_clint_get_kernel_info = (ClintGetKernelInfoFn)clint_opencl_func("clGetKernelInfo");
+  if (g_clint_get_kernel_info == NULL ||
+      g_clint_get_kernel_info(kernel, CL_KERNEL_REFERENCE_COUNT, sizeof(cl_uint), &count, NULL) != CL_SUCCESS ||
+      count != 1)
+    return;
+  /* If another thread retains it meanwhile, the next lookup just finds the name again. */
+  CLINT_SPINLOCK_LOCK(g_clint_kernels_lock);
+  k = clint_tree_find_ClintKernel(g_clint_kernels, kernel);
+  if (k != NULL) {
+    clint_tree_erase_ClintKernel(&g_clint_kernels, k);
+    CLINT_ATOMIC_ADD(1, g_clint_kernels_generation);
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_kernels_lock);
+  free(k);
+}
+
+int clint_kernels_sample(ClintKernelStats *stats)
+{
+  int rate = clint_get_config(CLINT_PROFILE_SAMPLE);
+  int budget = clint_get_config(CLINT_PROFILE_BUDGET);
+  ClintAtomicInt left;
+
+  if (stats == NULL)
+    return 1;
+  CLINT_ATOMIC_ADD64(1, stats->launches);
+  if (rate > 1) {
+    /* Only the launch that takes the countdown to zero is sampled, and refills it.
+       Launches racing with the refill count against the next gap. */
+    left = CLINT_ATOMIC_SUB(1, stats->countdown);
+    if (left != 0)
+      return 0;
+    CLINT_SPINLOCK_LOCK(g_clint_kernels_lock);
+    CLINT_ATOMIC_ADD((ClintAtomicInt)clint_kernels_gap(rate), stats->countdown);
+    CLINT_SPINLOCK_UNLOCK(g_clint_kernels_lock);
+  }
+  if (budget > 0) {
+    cl_ulong now = clint_time_now();
+    if (now - stats->window_ns >= 1000000000) {
+      CLINT_SPINLOCK_LOCK(g_clint_kernels_lock);
+      if (now - stats->window_ns >= 1000000000) {
+        stats->window_ns = now;
+        stats->window_samples = 0;
+      }
+      CLINT_SPINLOCK_UNLOCK(g_clint_kernels_lock);
+    }
+    if (CLINT_ATOMIC_ADD(1, stats->window_samples) > budget)
+      return 0;
+  }
+  return 1;
+}
+
+static int clint_kernels_bucket(cl_ulong ns)
+{
+  int octave = 0;
+  int bucket;
+
+  if (ns < CLINT_KERNEL_STEPS)
+    return (int)ns;
+  while ((ns >> octave) >= 2 * CLINT_KERNEL_STEPS)
+    octave++;
+  bucket = (octave + 1) * CLINT_KERNEL_STEPS + (int)(ns >> octave) - CLINT_KERNEL_STEPS;
+  return (bucket < CLINT_KERNEL_BUCKETS) ? bucket : CLINT_KERNEL_BUCKETS - 1;
+}
+
+/* The middle of a bucket. */
+static double clint_kernels_bucket_ns(int bucket)
+{
+  int octave;
+
+  if (bucket < CLINT_KERNEL_STEPS)
+    return (double)bucket;
+  octave = bucket / CLINT_KERNEL_STEPS - 1;
+  return ((double)(bucket % CLINT_KERNEL_STEPS + CLINT_KERNEL_STEPS) + 0.5) * (double)((cl_ulong)1 << octave);
+}
+
+/* Called with the lock held. */
+static double clint_kernels_percentile(const ClintKernelVariant *variant, double q)
+{
+  cl_ulong rank = (cl_ulong)ceil(q * (double)variant->sampled);
+  cl_ulong count = 0;
+  int i;
+
+  if (rank == 0)
+    rank = 1;
+  for (i = 0; i < CLINT_KERNEL_BUCKETS; i++) {
+    count += variant->histogram[i];
+    if (count >= rank)
+      return clint_kernels_bucket_ns(i);
+  }
+  return clint_kernels_bucket_ns(CLINT_KERNEL_BUCKETS - 1);
+}
+
+/* Called with the lock held.  NULL once a kernel has too many variants. */
+static ClintKernelVariant *clint_kernels_variant(ClintKernelStats *stats, cl_device_id device,
+                                                const ClintKernelShape *shape)
+{
+  ClintKernelVariant *variant;
+
+  for (variant = stats->variants; variant != NULL; variant = variant->next) {
+    if (variant->device == device && memcmp(&variant->shape, shape, sizeof(ClintKernelShape)) == 0)
+      return variant;
+  }
+  if (stats->num_variants >= CLINT_KERNEL_VARIANTS)
+    return NULL;
+  variant = (ClintKernelVariant*)calloc(1, sizeof(ClintKernelVariant));
+  if (variant == NULL)
+    return NULL;
+  variant->histogram = (cl_uint*)calloc(CLINT_KERNEL_BUCKETS, sizeof(cl_uint));
+  if (variant->histogram == NULL) {
+    free(variant);
+    return NULL;
+  }
+  variant->device = device;
+  variant->shape = *shape;
+  CLINT_STACK_PUSH(stats->variants, variant);
+  stats->num_variants++;
+  return variant;
+}
+
+void clint_kernels_record(ClintKernelStats *stats, cl_device_id device, const ClintKernelShape *shape,
+                          cl_ulong ns, cl_ulong launch_ns, cl_ulong host_ns)
+{
+  ClintKernelVariant *variant;
+
+  if (stats == NULL)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_kernels_lock);
+  if (clint_get_config_string(CLINT_PROFILE_BASELINE) != NULL) {
+    variant = clint_kernels_variant(stats, device, shape);
+    if (variant != NULL) {
+      variant->sampled++;
+      variant->histogram[clint_kernels_bucket(ns)]++;
+    }
+  }
+  stats->sampled++;
+  stats->sum_ns += (double)ns;
+  stats->sum_sq_ns += (double)ns * (double)ns;
+  stats->launch_ns += (double)launch_ns;
+  if (stats->first_ns == 0 || host_ns < stats->first_ns)
+    stats->first_ns = host_ns;
+  if (host_ns > stats->last_ns)
+    stats->last_ns = host_ns;
+  CLINT_SPINLOCK_UNLOCK(g_clint_kernels_lock);
+}
+
+/* Called with the lock held.  Kernels that wait longer to start than they run
+   are better fused or batched. */
+static void clint_kernels_report_launch(void)
+{
+  ClintKernelStats *stats;
+  int header = 0;
+
+  for (stats = g_clint_kernel_stats; stats != NULL; stats = stats->next) {
+    double n, mean, launch, rate;
+    if (stats->sampled == 0)
+      continue;
+    n = (double)stats->sampled;
+    mean = stats->sum_ns / n;
+    launch = stats->launch_ns / n;
+    if (launch <= mean)
+      continue;
+    if (!header) {
+      clint_log("Launch-bound kernels:\n");
+      clint_log("%-40s %12s %12s %12s %8s %12s\n",
+                "kernel", "launches/s", "launch (us)", "run (us)", "ratio", "overhead (s)");
+      header = 1;
+    }
+    rate = (stats->last_ns > stats->first_ns) ?
+      (double)stats->launches * 1.0e9 / (double)(stats->last_ns - stats->first_ns) : 0.0;
+    clint_log("%-40s %12.1f %12.3f %12.3f %8.1f %12.6f\n",
+              stats->name, rate, launch * 1.0e-3, mean * 1.0e-3,
+              (mean > 0) ? launch / mean : 0.0, launch * (double)stats->launches * 1.0e-9);
+  }
+}
+
+void clint_kernels_report(int final)
+{
+  ClintKernelStats *stats;
+  ClintKernelVariant *variant;
+  ClintKernelPercentiles *baselines = NULL;
+  int num_baselines = 0;
+  int header = 0;
+  int i;
+
+  CLINT_SPINLOCK_LOCK(g_clint_kernels_lock);
+  for (stats = g_clint_kernel_stats; stats != NULL; stats = stats->next) {
+    double n, mean, var, total, error;
+    if (stats->sampled == 0)
+      continue;
+    if (!header) {
+      clint_log("Kernel statistics:\n");
+      clint_log("%-40s %10s %10s %12s %12s %12s\n",
+                "kernel", "launches", "profiled", "mean (us)", "total (s)", "+/- (s)");
+      header = 1;
+    }
+    n = (double)stats->sampled;
+    mean = stats->sum_ns / n;
+    var = (n > 1) ? (stats->sum_sq_ns - n * mean * mean) / (n - 1) : 0.0;
+    if (var < 0)
+      var = 0;
+    /* Extrapolate to every launch.  The 95% interval uses the finite
+       population correction, so it is zero when every launch was profiled. */
+    total = mean * (double)stats->launches;
+    error = 1.0 - n / (double)stats->launches;
+    error = (error > 0) ? 1.96 * (double)stats->launches * sqrt(var / n * error) : 0.0;
+    clint_log("%-40s %10lu %10lu %12.3f %12.6f %12.6f\n",
+              stats->name, (unsigned long)stats->launches, (unsigned long)stats->sampled,
+              mean * 1.0e-3, total * 1.0e-9, error * 1.0e-9);
+  }
+  clint_kernels_report_launch();
+  /* The baseline queries the devices, so compare after dropping the lock.  A
+     snapshot is only part of the run, so it leaves the baseline alone. */
+  if (final && clint_get_config_string(CLINT_PROFILE_BASELINE) != NULL) {
+    for (stats = g_clint_kernel_stats; stats != NULL; stats = stats->next)
+      num_baselines += stats->num_variants;
+    baselines = (ClintKernelPercentiles*)malloc(sizeof(ClintKernelPercentiles) * (num_baselines + 1));
+    num_baselines = 0;
+    for (stats = g_clint_kernel_stats; stats != NULL && baselines != NULL; stats = stats->next) {
+      for (variant = stats->variants; variant != NULL; variant = variant->next) {
+        ClintKernelPercentiles *b;
+        if (variant->sampled == 0)
+          continue;
+        b = &baselines[num_baselines++];
+        b->device = variant->device;
+        b->name = stats->name;
+        b->shape = variant->shape;
+        b->sampled = variant->sampled;
+        b->p50 = clint_kernels_percentile(variant, 0.5);
+        b->p99 = clint_kernels_percentile(variant, 0.99);
+      }
+    }
+  }
+  /* Only report once, even if we're shutdown again. */
+  for (stats = g_clint_kernel_stats; final && stats != NULL; stats = stats->next) {
+    /* Launches are counted without the lock. */
+    CLINT_ATOMIC_ADD64(-stats->launches, stats->launches);
+    stats->sampled = 0;
+    stats->sum_ns = 0;
+    stats->sum_sq_ns = 0;
+    stats->launch_ns = 0;
+    stats->first_ns = 0;
+    stats->last_ns = 0;
+    for (variant = stats->variants; variant != NULL; variant = variant->next) {
+      variant->sampled = 0;
+      memset(variant->histogram, 0, sizeof(cl_uint) * CLINT_KERNEL_BUCKETS);
+    }
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_kernels_lock);
+  if (baselines != NULL) {
+    for (i = 0; i < num_baselines; i++) {
+      clint_baseline_kernel(baselines[i].device, baselines[i].name, &baselines[i].shape,
+                            baselines[i].sampled, baselines[i].p50, baselines[i].p99);
+    }
+    clint_baseline_save();
+  }
+  free(baselines);
+}
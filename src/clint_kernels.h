@@ -0,0 +1,108 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_KERNELS_H_
+#define _CLINT_KERNELS_H_
+
+#include "clint_atomic.h"
+
+#ifdef __APPLE__
+#include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The NDRange of a launch.  local is all zero when the driver picks it. */
+typedef struct ClintKernelShape {
+  cl_uint dims;
+  size_t global[3];
+  size_t local[3];
+} ClintKernelShape;
+
+/* Profiled run times of a kernel on one device with one shape, for CLINT_PROFILE_BASELINE. */
+typedef struct ClintKernelVariant {
+  struct ClintKernelVariant *next;
+  cl_device_id device;
+  ClintKernelShape shape;
+  cl_ulong sampled;
+  /* Log-scale histogram of the run times. */
+  cl_uint *histogram;
+} ClintKernelVariant;
+
+/* Launch statistics, shared by all kernels with the same name. */
+typedef struct ClintKernelStats {
+  struct ClintKernelStats *next;
+  char *name;
+  /* CLINT_FILTER_* bits of the name. */
+  int filter;
+  ClintAtomicInt64 launches;
+  cl_ulong sampled;
+  double sum_ns;
+  double sum_sq_ns;
+  /* START - QUEUED of the profiled launches, and when the first and last were enqueued. */
+  double launch_ns;
+  cl_ulong first_ns;
+  cl_ulong last_ns;
+  /* Per device and shape, only kept for CLINT_PROFILE_BASELINE. */
+  ClintKernelVariant *variants;
+  int num_variants;
+  /* Sampling state, updated without the lock so unsampled launches don't contend. */
+  ClintAtomicInt countdown;
+  cl_ulong window_ns;
+  ClintAtomicInt window_samples;
+} ClintKernelStats;
+
+void clint_kernels_init(void);
+/* Remember the name of a newly created kernel. */
+void clint_kernels_add(cl_kernel kernel);
+void clint_kernels_add_all(cl_uint num_kernels, const cl_kernel *kernels);
+/* Lock free while the kernel is in the calling thread's cache. */
+ClintKernelStats *clint_kernels_lookup(cl_kernel kernel);
+/* Forget a kernel before its final release, since the handle may be reused. */
+void clint_kernels_release(cl_kernel kernel);
+
+/* Count a launch and decide whether to profile it, from CLINT_PROFILE_SAMPLE
+   and CLINT_PROFILE_BUDGET. */
+int clint_kernels_sample(ClintKernelStats *stats);
+void clint_kernels_record(ClintKernelStats *stats, cl_device_id device, const ClintKernelShape *shape,
+                          cl_ulong ns, cl_ulong launch_ns, cl_ulong host_ns);
+
+/* Log per kernel statistics, extrapolated from the sampled launches, and the
+   kernels that take longer to start than to run.  Only the final report
+   compares with CLINT_PROFILE_BASELINE and saves it. */
+void clint_kernels_report(int final);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_KERNELS_H_
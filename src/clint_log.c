@@ -26,12 +26,18 @@
 ** THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#if !defined(__APPLE__) && !defined(WIN32)
+#define _GNU_SOURCE
+#endif
+
 #include "clint_log.h"
+#include "clint_atomic.h"
 #include "clint_config.h"
 #include "clint_opencl_types.h"
 #include "clint_thread.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #ifdef __APPLE__
 
@@ -105,6 +111,20 @@ typedef cl_bitfield         cl_device_affinity_domain;
 
 static FILE *g_clint_log_fp;
 static int g_clint_log_fp_close;
+static void (*g_clint_log_abort_handler)(void) = NULL;
+
+#if !defined(WIN32)
+#if defined(__GLIBC__) && !defined(getprogname)
+#include <errno.h>
+#define getprogname() program_invocation_short_name
+#endif
+
+/* so we can tell which log file came from which process */
+static int clint_log_header(FILE *fp)
+{
+  return fprintf(fp, "Process %ld, %s\n", (long)clint_get_process_id(), getprogname());
+}
+#endif
 
 #ifdef __APPLE__
 
@@ -136,6 +156,7 @@ void clint_log(const char *fmt, ...)
 #elif defined(WIN32)
 
 #include <windows.h>
+#include <io.h>
 
 void clint_log(const char *fmt, ...)
 {
@@ -158,16 +179,501 @@ void clint_log(const char *fmt, ...)
 
 #else
 
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/* CLINT_LOG_ASYNC: each thread formats into its own single producer, single
+   consumer ring, and a writer thread drains them all with batched write(2)s.
+   The writer sleeps until a producer finds it idle.  Rings of exited threads
+   are reused once they are empty. */
+#define CLINT_LOG_RING (64 * 1024)
+#define CLINT_LOG_BATCH (64 * 1024)
+
+typedef struct ClintLogRing {
+  struct ClintLogRing *next;
+  /* Total bytes ever written and read; the producer owns head, the writer tail. */
+  volatile size_t head;
+  volatile size_t tail;
+  volatile int exited;
+  char buf[CLINT_LOG_RING];
+} ClintLogRing;
+
+static ClintLogRing *g_clint_log_rings = NULL;
+static pthread_key_t g_clint_log_key;
+static pthread_t g_clint_log_writer;
+static pthread_mutex_t g_clint_log_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Only used by whoever holds the drain lock, so application threads that drain
+   a full ring don't need the space on their stacks. */
+static char g_clint_log_batch[CLINT_LOG_BATCH];
+static pthread_mutex_t g_clint_log_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_clint_log_wake_cond = PTHREAD_COND_INITIALIZER;
+static volatile int g_clint_log_idle = 0;
+static ClintSpinLock g_clint_log_lock;
+static volatile int g_clint_log_async = 0;
+static volatile int g_clint_log_stop = 0;
+static ClintAtomicInt g_clint_log_dropped = 0;
+
+/* CLINT_LOG_ROTATE_SIZE, CLINT_LOG_ROTATE_TIME: the log file is renamed to
+   <file>.<n> and a new one started, always between messages.  Closed segments
+   are compressed to <file>.<n>.gz by a background thread, then all but the last
+   CLINT_LOG_SEGMENTS removed.  Every write to a rotating log holds the lock. */
+#define CLINT_LOG_QUEUE 16
+
+static pthread_mutex_t g_clint_log_rotate_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *g_clint_log_path = NULL;
+static size_t g_clint_log_size = 0;
+static time_t g_clint_log_opened = 0;
+static unsigned int g_clint_log_segment = 0;
+
+#if HAVE_ZLIB
+static pthread_mutex_t g_clint_log_compress_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_clint_log_compress_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_clint_log_compressor;
+static unsigned int g_clint_log_queue[CLINT_LOG_QUEUE];
+static unsigned int g_clint_log_queue_head = 0;
+static unsigned int g_clint_log_queue_tail = 0;
+static int g_clint_log_compressing = 0;
+static int g_clint_log_compress_stop = 0;
+#endif
+
+static int clint_log_rotating(void)
+{
+  return g_clint_log_path != NULL &&
+    (clint_get_config(CLINT_LOG_ROTATE_SIZE) > 0 || clint_get_config(CLINT_LOG_ROTATE_TIME) > 0);
+}
+
+static char *clint_log_segment_path(unsigned int segment, const char *suffix)
+{
+  size_t size = strlen(g_clint_log_path) + strlen(suffix) + 16;
+  char *path = (char*)malloc(size);
+
+  if (path != NULL)
+    snprintf(path, size, "%s.%u%s", g_clint_log_path, segment, suffix);
+  return path;
+}
+
+/* Remove whichever form of the segment that just fell out of CLINT_LOG_SEGMENTS. */
+static void clint_log_prune(unsigned int segment)
+{
+  int keep = clint_get_config(CLINT_LOG_SEGMENTS);
+  char *path;
+
+  if (keep <= 0 || segment <= (unsigned int)keep)
+    return;
+  segment -= (unsigned int)keep;
+  if ((path = clint_log_segment_path(segment, "")) != NULL) {
+    unlink(path);
+    free(path);
+  }
+  if ((path = clint_log_segment_path(segment, ".gz")) != NULL) {
+    unlink(path);
+    free(path);
+  }
+}
+
+#if HAVE_ZLIB
+static void clint_log_compress(unsigned int segment)
+{
+  char buf[CLINT_LOG_BATCH];
+  char *src = clint_log_segment_path(segment, "");
+  char *dst = clint_log_segment_path(segment, ".gz");
+  FILE *in = NULL;
+  gzFile out = NULL;
+  size_t n;
+  int ok = 0;
+
+  if (src != NULL && dst != NULL && (in = fopen(src, "rb")) != NULL &&
+      (out = gzopen(dst, "wb")) != NULL) {
+    ok = 1;
+    while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+      ok = gzwrite(out, buf, (unsigned int)n) == (int)n;
+  }
+  if (in != NULL)
+    fclose(in);
+  if (out != NULL && gzclose(out) != Z_OK)
+    ok = 0;
+  /* Keep the uncompressed segment if anything went wrong. */
+  if (ok)
+    unlink(src);
+  else if (out != NULL)
+    unlink(dst);
+  free(src);
+  free(dst);
+}
+
+static void *clint_log_compressor(void *arg)
+{
+  unsigned int segment;
+
+  (void)arg;
+  pthread_mutex_lock(&g_clint_log_compress_lock);
+  for (;;) {
+    while (g_clint_log_queue_head == g_clint_log_queue_tail && !g_clint_log_compress_stop)
+      pthread_cond_wait(&g_clint_log_compress_cond, &g_clint_log_compress_lock);
+    if (g_clint_log_queue_head == g_clint_log_queue_tail)
+      break;
+    segment = g_clint_log_queue[g_clint_log_queue_tail % CLINT_LOG_QUEUE];
+    pthread_mutex_unlock(&g_clint_log_compress_lock);
+    clint_log_compress(segment);
+    clint_log_prune(segment);
+    pthread_mutex_lock(&g_clint_log_compress_lock);
+    g_clint_log_queue_tail++;
+    pthread_cond_broadcast(&g_clint_log_compress_cond);
+  }
+  pthread_mutex_unlock(&g_clint_log_compress_lock);
+  return NULL;
+}
+
+/* Hand a closed segment to the compressor, waiting if it's far behind. */
+static int clint_log_queue_segment(unsigned int segment)
+{
+  pthread_mutex_lock(&g_clint_log_compress_lock);
+  if (!g_clint_log_compressing) {
+    g_clint_log_compress_stop = 0;
+    if (pthread_create(&g_clint_log_compressor, NULL, clint_log_compressor, NULL) != 0) {
+      pthread_mutex_unlock(&g_clint_log_compress_lock);
+      return 0;
+    }
+    g_clint_log_compressing = 1;
+  }
+  while (g_clint_log_queue_head - g_clint_log_queue_tail == CLINT_LOG_QUEUE)
+    pthread_cond_wait(&g_clint_log_compress_cond, &g_clint_log_compress_lock);
+  g_clint_log_queue[g_clint_log_queue_head % CLINT_LOG_QUEUE] = segment;
+  g_clint_log_queue_head++;
+  pthread_cond_broadcast(&g_clint_log_compress_cond);
+  pthread_mutex_unlock(&g_clint_log_compress_lock);
+  return 1;
+}
+
+static void clint_log_compress_stop(void)
+{
+  if (g_clint_log_compressing) {
+    pthread_mutex_lock(&g_clint_log_compress_lock);
+    g_clint_log_compress_stop = 1;
+    pthread_cond_broadcast(&g_clint_log_compress_cond);
+    pthread_mutex_unlock(&g_clint_log_compress_lock);
+    pthread_join(g_clint_log_compressor, NULL);
+    g_clint_log_compressing = 0;
+  }
+}
+#endif
+
+static void clint_log_rotate(void)
+{
+  unsigned int segment = ++g_clint_log_segment;
+  char *closed = clint_log_segment_path(segment, "");
+  int size;
+
+  if (closed == NULL)
+    return;
+  if (g_clint_log_fp != NULL)
+    fclose(g_clint_log_fp);
+  rename(g_clint_log_path, closed);
+  free(closed);
+  g_clint_log_fp = fopen(g_clint_log_path, "w");
+  g_clint_log_fp_close = g_clint_log_fp != NULL;
+  g_clint_log_size = 0;
+  g_clint_log_opened = time(NULL);
+  if (g_clint_log_fp != NULL) {
+    size = clint_log_header(g_clint_log_fp);
+    size += fprintf(g_clint_log_fp, "Log segment %u, previous segment %s.%u\n",
+                    segment + 1, g_clint_log_path, segment);
+#if !HAVE_ZLIB
+    if (clint_get_config(CLINT_LOG_COMPRESS))
+      size += fprintf(g_clint_log_fp, "clint_log: built without zlib, segments are not compressed\n");
+#endif
+    if (size > 0)
+      g_clint_log_size = (size_t)size;
+  }
+#if HAVE_ZLIB
+  if (clint_get_config(CLINT_LOG_COMPRESS) && clint_log_queue_segment(segment))
+    return;
+#endif
+  clint_log_prune(segment);
+}
+
+/* Account for size bytes written, with g_clint_log_rotate_lock held. */
+static void clint_log_written(size_t size)
+{
+  int megabytes = clint_get_config(CLINT_LOG_ROTATE_SIZE);
+  int seconds = clint_get_config(CLINT_LOG_ROTATE_TIME);
+
+  g_clint_log_size += size;
+  if ((megabytes > 0 && g_clint_log_size >= ((size_t)megabytes << 20)) ||
+      (seconds > 0 && time(NULL) - g_clint_log_opened >= seconds))
+    clint_log_rotate();
+}
+
+static void clint_log_thread_exit(void *ring)
+{
+  ((ClintLogRing*)ring)->exited = 1;
+}
+
+static ClintLogRing *clint_log_ring(void)
+{
+  ClintLogRing *ring = (ClintLogRing*)pthread_getspecific(g_clint_log_key);
+
+  if (ring != NULL)
+    return ring;
+  CLINT_SPINLOCK_LOCK(g_clint_log_lock);
+  for (ring = g_clint_log_rings; ring != NULL; ring = ring->next) {
+    if (ring->exited && ring->head == ring->tail) {
+      ring->exited = 0;
+      break;
+    }
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_log_lock);
+  if (ring == NULL) {
+    ring = (ClintLogRing*)malloc(sizeof(ClintLogRing));
+    if (ring == NULL)
+      return NULL;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->exited = 0;
+    CLINT_SPINLOCK_LOCK(g_clint_log_lock);
+    ring->next = g_clint_log_rings;
+    g_clint_log_rings = ring;
+    CLINT_SPINLOCK_UNLOCK(g_clint_log_lock);
+  }
+  pthread_setspecific(g_clint_log_key, ring);
+  return ring;
+}
+
+static void clint_log_write_fd(int fd, const char *buf, size_t size)
+{
+  while (size > 0) {
+    ssize_t n = write(fd, buf, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    buf += n;
+    size -= (size_t)n;
+  }
+}
+
+/* Copy everything queued so far to fd, with g_clint_log_drain_lock held. */
+static size_t clint_log_drain_rings(int fd)
+{
+  char *batch = g_clint_log_batch;
+  size_t used = 0;
+  size_t total = 0;
+  ClintLogRing *ring;
+  int dropped;
+
+  for (ring = g_clint_log_rings; ring != NULL; ring = ring->next) {
+    size_t head = ring->head;
+    size_t tail = ring->tail;
+    CLINT_MEMORY_BARRIER();
+    while (tail != head) {
+      size_t pos = tail % CLINT_LOG_RING;
+      size_t n = head - tail;
+      if (n > CLINT_LOG_RING - pos)
+        n = CLINT_LOG_RING - pos;
+      if (n > CLINT_LOG_BATCH - used)
+        n = CLINT_LOG_BATCH - used;
+      memcpy(batch + used, ring->buf + pos, n);
+      used += n;
+      tail += n;
+      if (used == CLINT_LOG_BATCH) {
+        clint_log_write_fd(fd, batch, used);
+        total += used;
+        used = 0;
+      }
+    }
+    CLINT_MEMORY_BARRIER();
+    ring->tail = tail;
+  }
+  if (used > 0) {
+    clint_log_write_fd(fd, batch, used);
+    total += used;
+  }
+  dropped = g_clint_log_dropped;
+  if (dropped > 0) {
+    char msg[64];
+    int len = snprintf(msg, sizeof(msg), "clint_log: dropped %d messages\n", dropped);
+    CLINT_ATOMIC_SUB(dropped, g_clint_log_dropped);
+    clint_log_write_fd(fd, msg, (size_t)len);
+    total += (size_t)len;
+  }
+  return total;
+}
+
+/* Copy everything queued so far to the log.  Only one thread drains at a time. */
+static size_t clint_log_drain(void)
+{
+  size_t total;
+
+  pthread_mutex_lock(&g_clint_log_drain_lock);
+  pthread_mutex_lock(&g_clint_log_rotate_lock);
+  total = clint_log_drain_rings(fileno(g_clint_log_fp ? g_clint_log_fp : stderr));
+  /* Rings only hold whole messages, so this is between lines. */
+  if (total > 0 && clint_log_rotating())
+    clint_log_written(total);
+  pthread_mutex_unlock(&g_clint_log_rotate_lock);
+  pthread_mutex_unlock(&g_clint_log_drain_lock);
+  return total;
+}
+
+static int clint_log_pending(void)
+{
+  ClintLogRing *ring;
+
+  for (ring = g_clint_log_rings; ring != NULL; ring = ring->next) {
+    if (ring->head != ring->tail)
+      return 1;
+  }
+  return g_clint_log_dropped > 0;
+}
+
+/* Wake the writer if it's waiting for messages. */
+static void clint_log_wake(void)
+{
+  CLINT_MEMORY_BARRIER();
+  if (g_clint_log_idle) {
+    pthread_mutex_lock(&g_clint_log_wake_lock);
+    pthread_cond_signal(&g_clint_log_wake_cond);
+    pthread_mutex_unlock(&g_clint_log_wake_lock);
+  }
+}
+
+static void *clint_log_writer(void *arg)
+{
+  (void)arg;
+  while (!g_clint_log_stop) {
+    if (clint_log_drain() > 0)
+      continue;
+    /* Producers check idle after queueing, and we check the rings after
+       setting it, so either they see it or we see their message. */
+    pthread_mutex_lock(&g_clint_log_wake_lock);
+    g_clint_log_idle = 1;
+    CLINT_MEMORY_BARRIER();
+    if (!g_clint_log_stop && !clint_log_pending())
+      pthread_cond_wait(&g_clint_log_wake_cond, &g_clint_log_wake_lock);
+    g_clint_log_idle = 0;
+    pthread_mutex_unlock(&g_clint_log_wake_lock);
+  }
+  clint_log_drain();
+  return NULL;
+}
+
+static void clint_log_start(void)
+{
+  CLINT_SPINLOCK_LOCK(g_clint_log_lock);
+  if (!g_clint_log_async) {
+    /* Anything already buffered by stdio goes first. */
+    fflush(g_clint_log_fp ? g_clint_log_fp : stderr);
+    g_clint_log_stop = 0;
+    if (pthread_key_create(&g_clint_log_key, clint_log_thread_exit) == 0) {
+      if (pthread_create(&g_clint_log_writer, NULL, clint_log_writer, NULL) == 0)
+        g_clint_log_async = 1;
+      else
+        pthread_key_delete(g_clint_log_key);
+    }
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_log_lock);
+}
+
+static void clint_log_stop(void)
+{
+  if (g_clint_log_async) {
+    pthread_mutex_lock(&g_clint_log_wake_lock);
+    g_clint_log_stop = 1;
+    pthread_cond_signal(&g_clint_log_wake_cond);
+    pthread_mutex_unlock(&g_clint_log_wake_lock);
+    pthread_join(g_clint_log_writer, NULL);
+    /* Catch anything queued while the writer was finishing. */
+    clint_log_drain();
+    g_clint_log_async = 0;
+  }
+}
+
+static int clint_log_enqueue(const char *msg, size_t size)
+{
+  ClintLogRing *ring = clint_log_ring();
+  size_t head, pos, n;
+
+  if (ring == NULL || size > CLINT_LOG_RING)
+    return 0;
+  head = ring->head;
+  while (head - ring->tail + size > CLINT_LOG_RING) {
+    if (clint_get_config(CLINT_LOG_DROP)) {
+      CLINT_ATOMIC_ADD(1, g_clint_log_dropped);
+      clint_log_wake();
+      return 1;
+    }
+    clint_log_drain();
+  }
+  CLINT_MEMORY_BARRIER();
+  pos = head % CLINT_LOG_RING;
+  n = (size < CLINT_LOG_RING - pos) ? size : CLINT_LOG_RING - pos;
+  memcpy(ring->buf + pos, msg, n);
+  memcpy(ring->buf, msg + n, size - n);
+  CLINT_MEMORY_BARRIER();
+  ring->head = head + size;
+  clint_log_wake();
+  return 1;
+}
+
 void clint_log(const char *fmt, ...)
 {
   va_list ap;
-  FILE *fp = g_clint_log_fp;
-  if (fp == NULL)
-    fp = stderr;
+  FILE *fp;
+  int size;
+
+  if (clint_get_config(CLINT_LOG_ASYNC) && !g_clint_log_stop) {
+    char line[1024];
+    char *msg = line;
+    if (!g_clint_log_async)
+      clint_log_start();
+    va_start(ap, fmt);
+    size = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (size >= (int)sizeof(line)) {
+      msg = (char*)malloc(size + 1);
+      if (msg != NULL) {
+        va_start(ap, fmt);
+        vsnprintf(msg, size + 1, fmt, ap);
+        va_end(ap);
+      }
+    }
+    if (g_clint_log_async && msg != NULL && size >= 0 && clint_log_enqueue(msg, (size_t)size)) {
+      if (msg != line)
+        free(msg);
+      return;
+    }
+    if (msg != line)
+      free(msg);
+    /* Too long for a ring, or no writer thread: write it ourselves, after what's queued. */
+    if (g_clint_log_async)
+      clint_log_drain();
+  }
 
+  if (clint_log_rotating()) {
+    pthread_mutex_lock(&g_clint_log_rotate_lock);
+    fp = g_clint_log_fp ? g_clint_log_fp : stderr;
+    va_start(ap, fmt);
+    size = vfprintf(fp, fmt, ap);
+    va_end(ap);
+    if (g_clint_log_async)
+      fflush(fp);
+    if (size > 0)
+      clint_log_written((size_t)size);
+    pthread_mutex_unlock(&g_clint_log_rotate_lock);
+    return;
+  }
+
+  fp = g_clint_log_fp ? g_clint_log_fp : stderr;
   va_start(ap, fmt);
   vfprintf(fp, fmt, ap);
   va_end(ap);
+  if (g_clint_log_async)
+    fflush(fp);
 }
 
 #endif
@@ -188,9 +694,17 @@ void clint_log_init(const char *filename)
               (long)clint_get_process_id(), processName);
 #else
     g_clint_log_fp = fopen(filename, "w");
-    /* so we can tell which log file came from which process */
-    fprintf(g_clint_log_fp, "Process %ld, %s\n",
-            (long)clint_get_process_id(), getprogname());
+    if (g_clint_log_fp != NULL) {
+      int size = clint_log_header(g_clint_log_fp);
+#if !defined(__APPLE__)
+      g_clint_log_path = strdup(filename);
+      g_clint_log_size = size > 0 ? (size_t)size : 0;
+      g_clint_log_opened = time(NULL);
+      g_clint_log_segment = 0;
+#else
+      (void)size;
+#endif
+    }
 #endif
     g_clint_log_fp_close = 1;
   }
@@ -205,16 +719,105 @@ void clint_log_init_fp(FILE *fp)
 
 void clint_log_shutdown()
 {
+#if !defined(__APPLE__) && !defined(WIN32)
+  clint_log_stop();
+  pthread_mutex_lock(&g_clint_log_rotate_lock);
+#endif
   if (g_clint_log_fp != NULL && g_clint_log_fp_close) {
     fclose(g_clint_log_fp);
     g_clint_log_fp = NULL;
     g_clint_log_fp_close = 0;
   }
+#if !defined(__APPLE__) && !defined(WIN32)
+#if HAVE_ZLIB
+  /* Finish compressing the closed segments, which still needs the path. */
+  clint_log_compress_stop();
+#endif
+  free(g_clint_log_path);
+  g_clint_log_path = NULL;
+  pthread_mutex_unlock(&g_clint_log_rotate_lock);
+#endif
+}
+
+static int g_clint_log_signal_fd = -1;
+#if !defined(__APPLE__) && !defined(WIN32)
+static int g_clint_log_signal_locked = 0;
+#endif
+
+int clint_log_signal_begin()
+{
+  FILE *fp = g_clint_log_fp ? g_clint_log_fp : stderr;
+
+#if !defined(__APPLE__) && !defined(WIN32)
+  /* The file only changes while rotating. */
+  g_clint_log_signal_locked = 0;
+  if (clint_log_rotating()) {
+    if (pthread_mutex_trylock(&g_clint_log_rotate_lock) != 0)
+      return 0;
+    g_clint_log_signal_locked = 1;
+  }
+#endif
+#if defined(WIN32)
+  g_clint_log_signal_fd = _fileno(fp);
+#else
+  /* What stdio still buffers goes first, unless another thread is writing it. */
+  if (ftrylockfile(fp) == 0) {
+    fflush(fp);
+    funlockfile(fp);
+  }
+  g_clint_log_signal_fd = fileno(fp);
+#endif
+#if !defined(__APPLE__) && !defined(WIN32)
+  /* So does the queue, unless the writer is draining it right now. */
+  if (g_clint_log_async && pthread_mutex_trylock(&g_clint_log_drain_lock) == 0) {
+    clint_log_drain_rings(g_clint_log_signal_fd);
+    pthread_mutex_unlock(&g_clint_log_drain_lock);
+  }
+#endif
+  return g_clint_log_signal_fd >= 0;
+}
+
+void clint_log_signal_write(const char *msg, size_t size)
+{
+#if defined(WIN32)
+  _write(g_clint_log_signal_fd, msg, (unsigned int)size);
+#elif defined(__APPLE__)
+  while (size > 0) {
+    ssize_t n = write(g_clint_log_signal_fd, msg, size);
+    if (n <= 0)
+      return;
+    msg += n;
+    size -= (size_t)n;
+  }
+#else
+  clint_log_write_fd(g_clint_log_signal_fd, msg, size);
+#endif
+}
+
+void clint_log_signal_end()
+{
+#if !defined(__APPLE__) && !defined(WIN32)
+  if (g_clint_log_signal_locked)
+    pthread_mutex_unlock(&g_clint_log_rotate_lock);
+  g_clint_log_signal_locked = 0;
+#endif
+}
+
+void clint_log_abort_handler(void (*handler)(void))
+{
+  g_clint_log_abort_handler = handler;
 }
 
 void clint_log_abort()
 {
+  if (g_clint_log_abort_handler != NULL)
+    g_clint_log_abort_handler();
   if (clint_get_config(CLINT_ABORT)) {
+#if !defined(__APPLE__) && !defined(WIN32)
+    /* Don't lose the message explaining why. */
+    if (g_clint_log_async)
+      clint_log_drain();
+#endif
     abort();
   }
 }
@@ -232,9 +835,79 @@ void clint_log_describe()
   }
 }
 
+/* The device report calls the driver through this table, so the
+   interceptor can point it past its own entry points. */
+static ClintLogApi g_clint_log_api = {
+  clGetPlatformIDs,
+  clGetPlatformInfo,
+  clGetDeviceIDs,
+  clGetDeviceInfo,
+  clCreateContext,
+  clGetSupportedImageFormats,
+  clReleaseContext
+};
+
+typedef struct ClintLogBuffer {
+  char *buf;
+  size_t len;
+  size_t size;
+} ClintLogBuffer;
+
+/* Set while clint_log_platforms_string() renders the report. */
+static ClintLogBuffer *g_clint_log_capture;
+
+static void clint_log_report(const char *fmt, ...)
+{
+  ClintLogBuffer *out = g_clint_log_capture;
+  char line[1024];
+  char *msg = line;
+  va_list ap;
+  int size;
+
+  va_start(ap, fmt);
+  size = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  if (size < 0)
+    return;
+  if (size >= (int)sizeof(line)) {
+    msg = (char*)malloc((size_t)size + 1);
+    if (msg == NULL)
+      return;
+    va_start(ap, fmt);
+    vsnprintf(msg, (size_t)size + 1, fmt, ap);
+    va_end(ap);
+  }
+  if (out == NULL) {
+    clint_log("%s", msg);
+  } else {
+    if (out->len + (size_t)size + 1 > out->size) {
+      size_t grow = out->size ? out->size * 2 : 16384;
+      char *buf;
+      while (grow < out->len + (size_t)size + 1)
+        grow *= 2;
+      buf = (char*)realloc(out->buf, grow);
+      if (buf != NULL) {
+        out->buf = buf;
+        out->size = grow;
+      }
+    }
+    if (out->len + (size_t)size + 1 <= out->size) {
+      memcpy(out->buf + out->len, msg, (size_t)size + 1);
+      out->len += (size_t)size;
+    }
+  }
+  if (msg != line)
+    free(msg);
+}
+
+void clint_log_platform_api(const ClintLogApi *api)
+{
+  g_clint_log_api = *api;
+}
+
 static void clint_log_device_raw(cl_device_id device, cl_device_info param, const char *name, const char *value)
 {
-  clint_log("\tdevice[%p]: %s = %s\n", device, name, value);
+  clint_log_report("\tdevice[%p]: %s = %s\n", device, name, value);
 }
 
 static cl_bool clint_get_device_int(cl_device_id device, cl_device_info param, const char *name, void *v, size_t size_v)
@@ -242,13 +915,13 @@ static cl_bool clint_get_device_int(cl_device_id device, cl_device_info param, c
   cl_int err;
   size_t size;
 
-  if ((err = clGetDeviceInfo(device, param, size_v, v, &size)) == CL_SUCCESS) {
+  if ((err = g_clint_log_api.GetDeviceInfo(device, param, size_v, v, &size)) == CL_SUCCESS) {
     if (size > size_v) {
-      clint_log("\tdevice[%p]: %s unexpected size: %lu\n", device, name, (unsigned long)size);
+      clint_log_report("\tdevice[%p]: %s unexpected size: %lu\n", device, name, (unsigned long)size);
     }
     return CL_TRUE;
   } else {
-    clint_log("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
+    clint_log_report("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
     return CL_FALSE;
   }
 }
@@ -258,16 +931,16 @@ static void clint_log_device_string(cl_device_id device, cl_device_info param, c
   cl_int err;
   size_t size;
 
-  if ((err = clGetDeviceInfo(device, param, 0, NULL, &size)) == CL_SUCCESS) {
+  if ((err = g_clint_log_api.GetDeviceInfo(device, param, 0, NULL, &size)) == CL_SUCCESS) {
     void *buf = malloc(size);
     if (buf != NULL) {
-      if ((err = clGetDeviceInfo(device, param, size, buf, NULL)) == CL_SUCCESS) {
-        clint_log("\tdevice[%p]: %s = %s\n", device, name, (const char*)buf);
+      if ((err = g_clint_log_api.GetDeviceInfo(device, param, size, buf, NULL)) == CL_SUCCESS) {
+        clint_log_report("\tdevice[%p]: %s = %s\n", device, name, (const char*)buf);
       }
       free(buf);
     }
   } else {
-    clint_log("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
+    clint_log_report("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
   }
 }
 
@@ -279,10 +952,10 @@ static void clint_log_device_version(cl_device_id device, cl_device_info param,
 
   *major = 1;
   *minor = 0;
-  if ((err = clGetDeviceInfo(device, param, 0, NULL, &size)) == CL_SUCCESS) {
+  if ((err = g_clint_log_api.GetDeviceInfo(device, param, 0, NULL, &size)) == CL_SUCCESS) {
     void *buf = malloc(size);
     if (buf != NULL) {
-      if ((err = clGetDeviceInfo(device, param, size, buf, NULL)) == CL_SUCCESS) {
+      if ((err = g_clint_log_api.GetDeviceInfo(device, param, size, buf, NULL)) == CL_SUCCESS) {
         int scan_count;
 #if defined(WIN32)
         scan_count = sscanf_s((const char*)buf, " OpenCL %d.%d", major, minor);
@@ -293,12 +966,12 @@ static void clint_log_device_version(cl_device_id device, cl_device_info param,
           *major = 1;
           *minor = 0;
         }
-        clint_log("\tdevice[%p]: %s = %s\n", device, name, (const char*)buf);
+        clint_log_report("\tdevice[%p]: %s = %s\n", device, name, (const char*)buf);
       }
       free(buf);
     }
   } else {
-    clint_log("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
+    clint_log_report("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
   }
 }
 
@@ -315,51 +988,51 @@ static void clint_log_device_int(cl_device_id device, cl_device_info param, cons
     cl_uint clui;
   } v;
 
-  if ((err = clGetDeviceInfo(device, param, size_v, &v, &size)) == CL_SUCCESS) {
+  if ((err = g_clint_log_api.GetDeviceInfo(device, param, size_v, &v, &size)) == CL_SUCCESS) {
     if (size > size_v) {
-      clint_log("\tdevice[%p]: %s unexpected size: %lu\n", device, name, (unsigned long)size);
+      clint_log_report("\tdevice[%p]: %s unexpected size: %lu\n", device, name, (unsigned long)size);
     }
     if (size_v == sizeof(char)) {
       if (asHex) {
-        clint_log("\tdevice[%p]: %s = 0x%x\n", device, name, (int)v.c);
+        clint_log_report("\tdevice[%p]: %s = 0x%x\n", device, name, (int)v.c);
       } else {
-        clint_log("\tdevice[%p]: %s = %d\n", device, name, (int)v.c);
+        clint_log_report("\tdevice[%p]: %s = %d\n", device, name, (int)v.c);
       }
     } else if (size_v == sizeof(short)) {
       if (asHex) {
-        clint_log("\tdevice[%p]: %s = 0x%x\n", device, name, (int)v.s);
+        clint_log_report("\tdevice[%p]: %s = 0x%x\n", device, name, (int)v.s);
       } else {
-        clint_log("\tdevice[%p]: %s = %d\n", device, name, (int)v.s);
+        clint_log_report("\tdevice[%p]: %s = %d\n", device, name, (int)v.s);
       }
     } else if (size_v == sizeof(int)) {
       if (asHex) {
-        clint_log("\tdevice[%p]: %s = 0x%x\n", device, name, v.i);
+        clint_log_report("\tdevice[%p]: %s = 0x%x\n", device, name, v.i);
       } else {
-        clint_log("\tdevice[%p]: %s = %d\n", device, name, v.i);
+        clint_log_report("\tdevice[%p]: %s = %d\n", device, name, v.i);
       }
     } else if (size_v == sizeof(long)) {
       if (asHex) {
-        clint_log("\tdevice[%p]: %s = 0x%lx\n", device, name, v.l);
+        clint_log_report("\tdevice[%p]: %s = 0x%lx\n", device, name, v.l);
       } else {
-        clint_log("\tdevice[%p]: %s = %ld\n", device, name, v.l);
+        clint_log_report("\tdevice[%p]: %s = %ld\n", device, name, v.l);
       }
     } else if (size_v == sizeof(long long)) {
       if (asHex) {
-        clint_log("\tdevice[%p]: %s = 0x%llx\n", device, name, v.ll);
+        clint_log_report("\tdevice[%p]: %s = 0x%llx\n", device, name, v.ll);
       } else {
-        clint_log("\tdevice[%p]: %s = %lld\n", device, name, v.ll);
+        clint_log_report("\tdevice[%p]: %s = %lld\n", device, name, v.ll);
       }
     }
     if (param == CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS) {
       size_t items[3];
       items[0] = items[1] = items[2] = 0;
-      if ((err = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(size_t)*(size_t)v.clui, items, &size)) == CL_SUCCESS) {
-        clint_log("\tdevice[%p]: %s: (%lu, %lu, %lu)\n",
-                  device, "CL_MAX_WORK_ITEM_SIZES", (unsigned long)items[0], (unsigned long)items[1], (unsigned long)items[2]);
+      if ((err = g_clint_log_api.GetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(size_t)*(size_t)v.clui, items, &size)) == CL_SUCCESS) {
+        clint_log_report("\tdevice[%p]: %s: (%lu, %lu, %lu)\n",
+                         device, "CL_MAX_WORK_ITEM_SIZES", (unsigned long)items[0], (unsigned long)items[1], (unsigned long)items[2]);
       }
     }
   } else {
-    clint_log("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
+    clint_log_report("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
   }
 }
 
@@ -368,20 +1041,20 @@ static void clint_log_device_partition(cl_device_id device, cl_device_info param
   cl_int err;
   size_t i, size;
 
-  if ((err = clGetDeviceInfo(device, param, 0, NULL, &size)) == CL_SUCCESS) {
+  if ((err = g_clint_log_api.GetDeviceInfo(device, param, 0, NULL, &size)) == CL_SUCCESS) {
     cl_device_partition_property *buf = (cl_device_partition_property*)malloc(size);
     if (buf != NULL) {
-      if ((err = clGetDeviceInfo(device, param, size, buf, NULL)) == CL_SUCCESS) {
+      if ((err = g_clint_log_api.GetDeviceInfo(device, param, size, buf, NULL)) == CL_SUCCESS) {
         size /= sizeof(cl_device_partition_property);
         for (i = 0; i < size; i++) {
-          clint_log("\tdevice[%p]: %s[%ld] = %s\n", device, name, (unsigned long)i,
-                    (buf[i] ? clint_string_device_partition_property(buf[i]) : "0"));
+          clint_log_report("\tdevice[%p]: %s[%ld] = %s\n", device, name, (unsigned long)i,
+                           (buf[i] ? clint_string_device_partition_property(buf[i]) : "0"));
         }
       }
       free(buf);
     }
   } else {
-    clint_log("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
+    clint_log_report("\tdevice[%p]: %s: %s\n", device, name, clint_string_error(err));
   }
 }
 
@@ -390,16 +1063,16 @@ static void clint_log_platform_string(cl_platform_id platform, cl_platform_info
   cl_int err;
   size_t size;
 
-  if ((err = clGetPlatformInfo(platform, param, 0, NULL, &size)) == CL_SUCCESS) {
+  if ((err = g_clint_log_api.GetPlatformInfo(platform, param, 0, NULL, &size)) == CL_SUCCESS) {
     void *buf = malloc(size);
     if (buf != NULL) {
-      if ((err = clGetPlatformInfo(platform, param, size, buf, NULL)) == CL_SUCCESS) {
-        clint_log("platform[%p]: %s = %s\n", platform, name, (const char*)buf);
+      if ((err = g_clint_log_api.GetPlatformInfo(platform, param, size, buf, NULL)) == CL_SUCCESS) {
+        clint_log_report("platform[%p]: %s = %s\n", platform, name, (const char*)buf);
       }
       free(buf);
     }
   } else {
-    clint_log("platform[%p]: %s: %s\n", platform, name, clint_string_error(err));
+    clint_log_report("platform[%p]: %s: %s\n", platform, name, clint_string_error(err));
   }
 }
 
@@ -417,7 +1090,7 @@ void clint_log_device_formats(cl_platform_id platform, cl_device_id device)
    properties[i++] = (cl_context_properties)platform;
    properties[i++] = (cl_context_properties)0;
 
-   context = clCreateContext(properties, 1, &device, NULL, NULL, &err);
+   context = g_clint_log_api.CreateContext(properties, 1, &device, NULL, NULL, &err);
    if (err == CL_SUCCESS) {
      cl_mem_flags flags;
      cl_mem_object_type type;
@@ -444,37 +1117,37 @@ void clint_log_device_formats(cl_platform_id platform, cl_device_id device)
            type = CL_MEM_OBJECT_IMAGE3D;
            break;
          }
-         clint_log("\tdevice[%p]: %s %s.\n",
-                   device,
-                   clint_string_mem_flags(flags),
-                   clint_string_mem_object_type(type));
-         if ((err = clGetSupportedImageFormats(context, flags, type, 0, NULL, &numFormats)) == CL_SUCCESS) {
-           clint_log("\tdevice[%p]: Found %d format(s).\n", device, numFormats);
+         clint_log_report("\tdevice[%p]: %s %s.\n",
+                          device,
+                          clint_string_mem_flags(flags),
+                          clint_string_mem_object_type(type));
+         if ((err = g_clint_log_api.GetSupportedImageFormats(context, flags, type, 0, NULL, &numFormats)) == CL_SUCCESS) {
+           clint_log_report("\tdevice[%p]: Found %d format(s).\n", device, numFormats);
            if (numFormats > 0) {
              formatList = (cl_image_format*)malloc(numFormats * sizeof(cl_image_format));
-             if ((err = clGetSupportedImageFormats(context, flags, type, numFormats, formatList, NULL)) == CL_SUCCESS) {
+             if ((err = g_clint_log_api.GetSupportedImageFormats(context, flags, type, numFormats, formatList, NULL)) == CL_SUCCESS) {
                cl_uint k;
                for (k = 0; k < numFormats; k++) {
-                 clint_log("\tdevice[%p]: %s\t%s\n",
-                           device,
-                           clint_string_channel_order(formatList[k].image_channel_order),
-                           clint_string_channel_type(formatList[k].image_channel_data_type));
+                 clint_log_report("\tdevice[%p]: %s\t%s\n",
+                                  device,
+                                  clint_string_channel_order(formatList[k].image_channel_order),
+                                  clint_string_channel_type(formatList[k].image_channel_data_type));
                }
              } else {
-               clint_log("\tdevice[%p]: Unable to enumerate the formats: %s\n",
-                         device, clint_string_error(err));
+               clint_log_report("\tdevice[%p]: Unable to enumerate the formats: %s\n",
+                                device, clint_string_error(err));
                free(formatList);
              }
              free(formatList);
            }
          } else {
-           clint_log("\tdevice[%p]: Unable to query the number of formats: %s\n", device, clint_string_error(err));
+           clint_log_report("\tdevice[%p]: Unable to query the number of formats: %s\n", device, clint_string_error(err));
          }
        }
      }
-     clReleaseContext(context);
+     g_clint_log_api.ReleaseContext(context);
    } else {
-     clint_log("\tdevice[%p]: Unable to create context: %s\n", device, clint_string_error(err));
+     clint_log_report("\tdevice[%p]: Unable to create context: %s\n", device, clint_string_error(err));
    }
 }
 
@@ -591,8 +1264,8 @@ void clint_log_device(cl_platform_id platform, cl_device_id device)
   if (major >= 2 || (major == 1 && minor >= 2))
     clint_log_device_string(device, DEVICE_ARGS(BUILT_IN_KERNELS));
   else
-    clint_log("\tdevice[%p]: %s: %s\n",
-              device, "CL_BUILT_IN_KERNELS", clint_string_error(CL_INVALID_VALUE));
+    clint_log_report("\tdevice[%p]: %s: %s\n",
+                     device, "CL_BUILT_IN_KERNELS", clint_string_error(CL_INVALID_VALUE));
   clint_log_device_int(device, DEVICE_ARGS(IMAGE_MAX_BUFFER_SIZE), sizeof(size_t), CL_FALSE);
   clint_log_device_int(device, DEVICE_ARGS(IMAGE_MAX_ARRAY_SIZE), sizeof(size_t), CL_FALSE);
   clint_log_device_int(device, DEVICE_ARGS(PARENT_DEVICE), sizeof(cl_device_id), CL_TRUE);
@@ -617,17 +1290,17 @@ void clint_log_platform(cl_platform_id platform)
   cl_uint count;
   cl_device_id *devices;
 
-  if ((err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, NULL, &count)) == CL_SUCCESS) {
+  if ((err = g_clint_log_api.GetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, NULL, &count)) == CL_SUCCESS) {
     clint_log_platform_string(platform, PLATFORM_ARGS(NAME));
     clint_log_platform_string(platform, PLATFORM_ARGS(VENDOR));
     clint_log_platform_string(platform, PLATFORM_ARGS(PROFILE));
     clint_log_platform_string(platform, PLATFORM_ARGS(VERSION));
     clint_log_platform_string(platform, PLATFORM_ARGS(EXTENSIONS));
 
-    clint_log("Found %u devices(s).\n", (unsigned int)count);
+    clint_log_report("Found %u devices(s).\n", (unsigned int)count);
     devices = (cl_device_id*)malloc(sizeof(cl_device_id) * count);
     if (devices != NULL) {
-      if ((err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, count, devices, NULL)) == CL_SUCCESS) {
+      if ((err = g_clint_log_api.GetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, count, devices, NULL)) == CL_SUCCESS) {
         cl_uint i;
         for (i = 0; i < count; i++) {
           clint_log_device(platform, devices[i]);
@@ -637,7 +1310,7 @@ void clint_log_platform(cl_platform_id platform)
     }
   }
   if (err != CL_SUCCESS) {
-    clint_log("clint_log_platform() failed: %s\n", clint_string_error(err));
+    clint_log_report("clint_log_platform() failed: %s\n", clint_string_error(err));
   }
 }
 
@@ -647,11 +1320,11 @@ void clint_log_platforms()
   cl_uint count;
   cl_platform_id *platforms;
 
-  if ((err = clGetPlatformIDs(0, NULL, &count)) == CL_SUCCESS) {
-    clint_log("Found %u platform(s).\n", (unsigned int)count);
+  if ((err = g_clint_log_api.GetPlatformIDs(0, NULL, &count)) == CL_SUCCESS) {
+    clint_log_report("Found %u platform(s).\n", (unsigned int)count);
     platforms = (cl_platform_id*)malloc(sizeof(cl_platform_id) * count);
     if (platforms != NULL) {
-      if ((err = clGetPlatformIDs(count, platforms, NULL)) == CL_SUCCESS) {
+      if ((err = g_clint_log_api.GetPlatformIDs(count, platforms, NULL)) == CL_SUCCESS) {
         cl_uint i;
         for (i = 0; i < count; i++) {
           clint_log_platform(platforms[i]);
@@ -661,6 +1334,19 @@ void clint_log_platforms()
     }
   }
   if (err != CL_SUCCESS) {
-    clint_log("clint_log_platforms() failed: %s\n", clint_string_error(err));
+    clint_log_report("clint_log_platforms() failed: %s\n", clint_string_error(err));
   }
 }
+
+char *clint_log_platforms_string()
+{
+  ClintLogBuffer out;
+
+  out.buf = NULL;
+  out.len = 0;
+  out.size = 0;
+  g_clint_log_capture = &out;
+  clint_log_platforms();
+  g_clint_log_capture = NULL;
+  return out.buf;
+}
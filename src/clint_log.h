@@ -43,16 +43,43 @@
 extern "C" {
 #endif
 
+/* The driver entry points used by the platform and device report. */
+typedef struct ClintLogApi {
+  cl_int (CL_API_CALL *GetPlatformIDs)(cl_uint, cl_platform_id *, cl_uint *);
+  cl_int (CL_API_CALL *GetPlatformInfo)(cl_platform_id, cl_platform_info, size_t, void *, size_t *);
+  cl_int (CL_API_CALL *GetDeviceIDs)(cl_platform_id, cl_device_type, cl_uint, cl_device_id *, cl_uint *);
+  cl_int (CL_API_CALL *GetDeviceInfo)(cl_device_id, cl_device_info, size_t, void *, size_t *);
+  cl_context (CL_API_CALL *CreateContext)(const cl_context_properties *, cl_uint, const cl_device_id *,
+                                          void (CL_CALLBACK *)(const char *, const void *, size_t, void *),
+                                          void *, cl_int *);
+  cl_int (CL_API_CALL *GetSupportedImageFormats)(cl_context, cl_mem_flags, cl_mem_object_type,
+                                                 cl_uint, cl_image_format *, cl_uint *);
+  cl_int (CL_API_CALL *ReleaseContext)(cl_context);
+} ClintLogApi;
+
 void clint_log_init(const char *filename);
 void clint_log_init_fp(FILE *fp);
 void clint_log_shutdown();
+/* For fatal signal handlers, which may have interrupted a thread holding any
+   lock: only tries locks, and writes with write(2).  Returns 0 if the log
+   can't be written without waiting; otherwise write lines with
+   clint_log_signal_write() and finish with clint_log_signal_end(). */
+int clint_log_signal_begin();
+void clint_log_signal_write(const char *msg, size_t size);
+void clint_log_signal_end();
 void clint_log_abort();
+/* Called by clint_log_abort() whenever an error is detected, aborting or not. */
+void clint_log_abort_handler(void (*handler)(void));
 void clint_log_describe();
 void clint_log(const char *fmt, ...);
 void clint_log_device_formats(cl_platform_id platform, cl_device_id device);
 void clint_log_device(cl_platform_id platform, cl_device_id device);
 void clint_log_platform(cl_platform_id platform);
 void clint_log_platforms();
+/* Route the report's driver calls through api instead of the exported names. */
+void clint_log_platform_api(const ClintLogApi *api);
+/* The report clint_log_platforms() would log, as a malloc'd string, or NULL. */
+char *clint_log_platforms_string();
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,339 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_loop.h"
+#include "clint_atomic.h"
+#include "clint_data.h"
+#include "clint_log.h"
+#include "clint_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Sequences of up to CLINT_LOOP_PERIOD calls are recognized once they have
+   been seen twice in a row.  Further repeats are held back until the pattern
+   breaks, then replaced by a count, the fields that changed, and the last
+   repeat in full.  Everything held back is still in the history, which is
+   long enough for the last repeat, a partial one, and the one before. */
+#define CLINT_LOOP_PERIOD 16
+#define CLINT_LOOP_HISTORY (2 * CLINT_LOOP_PERIOD)
+#define CLINT_LOOP_FIELDS 32
+#define CLINT_LOOP_VARYING 6
+
+typedef struct ClintLoopCall {
+  /* The function and its line with handles masked out. */
+  unsigned int key;
+  char *line;
+} ClintLoopCall;
+
+typedef struct ClintLoopState {
+  struct ClintLoopState *next;
+  ClintSpinLock lock;
+  ClintLoopCall history[CLINT_LOOP_HISTORY];
+  unsigned int count;
+  /* Length of the repeating sequence, or 0. */
+  int period;
+  /* Calls into the current repeat, and complete repeats held back. */
+  int pos;
+  unsigned int repeats;
+  int num_varying;
+  char varying[CLINT_LOOP_VARYING + 1][32];
+} ClintLoopState;
+
+typedef struct ClintLoopField {
+  const char *name;
+  size_t name_len;
+  const char *value;
+  size_t value_len;
+} ClintLoopField;
+
+static int g_clint_loop_init = 0;
+static ClintTLS g_clint_loop_key;
+static ClintLoopState *g_clint_loop_states = NULL;
+static ClintSpinLock g_clint_loop_lock;
+
+#define CLINT_LOOP_CALL(state, i) (&(state)->history[(i) % CLINT_LOOP_HISTORY])
+
+static int clint_loop_is_hex(char c)
+{
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static int clint_loop_is_ident(char c)
+{
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/* Handles change every iteration, so pointers don't count towards the pattern. */
+static unsigned int clint_loop_hash(int func, const char *s)
+{
+  unsigned int h = 2166136261u ^ (unsigned int)func;
+
+  while (*s) {
+    if (s[0] == '0' && s[1] == 'x') {
+      s += 2;
+      while (clint_loop_is_hex(*s))
+        s++;
+      h = (h ^ '*') * 16777619u;
+    } else if (strncmp(s, "(nil)", 5) == 0) {
+      s += 5;
+      h = (h ^ '*') * 16777619u;
+    } else {
+      h = (h ^ (unsigned char)*s++) * 16777619u;
+    }
+  }
+  return h;
+}
+
+/* Split "f(a=1, b=2)" or "f returned 0 a=1 b=2" into its named values; the
+   return value is called retval. */
+static int clint_loop_fields(const char *line, ClintLoopField *fields)
+{
+  const char *p = line + strcspn(line, "( ");
+  const char *end = line + strlen(line);
+  int n = 0;
+
+  if (strncmp(p, " returned ", 10) == 0) {
+    fields[n].name = "retval";
+    fields[n].name_len = 6;
+    fields[n].value = p + 10;
+    n++;
+  }
+  for (; *p; p++) {
+    const char *name = p + 1;
+    const char *q = name;
+    if (*p != '(' && *p != ' ')
+      continue;
+    while (clint_loop_is_ident(*q))
+      q++;
+    if (q == name || *q != '=' || n == CLINT_LOOP_FIELDS)
+      continue;
+    fields[n].name = name;
+    fields[n].name_len = q - name;
+    fields[n].value = q + 1;
+    n++;
+  }
+  while (end > line && (end[-1] == '\n' || end[-1] == ')'))
+    end--;
+  /* Each value ends at the separator before the next name. */
+  for (p = end; n > 0 && fields[n - 1].value > p; n--)
+    ;
+  if (n > 0) {
+    int i;
+    for (i = 0; i < n - 1; i++) {
+      const char *next = fields[i + 1].name - 1;
+      if (next > fields[i].value && next[-1] == ',')
+        next--;
+      fields[i].value_len = next > fields[i].value ? next - fields[i].value : 0;
+    }
+    fields[n - 1].value_len = end - fields[n - 1].value;
+  }
+  return n;
+}
+
+static void clint_loop_vary(ClintLoopState *state, const char *name, size_t len)
+{
+  int i;
+
+  for (i = 0; i < state->num_varying; i++) {
+    if (strlen(state->varying[i]) == len && strncmp(state->varying[i], name, len) == 0)
+      return;
+  }
+  if (state->num_varying < CLINT_LOOP_VARYING) {
+    if (len >= sizeof(state->varying[0]))
+      len = sizeof(state->varying[0]) - 1;
+    memcpy(state->varying[state->num_varying], name, len);
+    state->varying[state->num_varying][len] = 0;
+  } else if (state->num_varying == CLINT_LOOP_VARYING) {
+    strcpy(state->varying[state->num_varying], "...");
+  } else {
+    return;
+  }
+  state->num_varying++;
+}
+
+/* Note which fields differ between the last two repeats. */
+static void clint_loop_compare(ClintLoopState *state)
+{
+  ClintLoopField a[CLINT_LOOP_FIELDS];
+  ClintLoopField b[CLINT_LOOP_FIELDS];
+  int i, j, na, nb;
+
+  for (i = 0; i < state->period; i++) {
+    const char *prev = CLINT_LOOP_CALL(state, state->count - 2 * state->period + i)->line;
+    const char *line = CLINT_LOOP_CALL(state, state->count - state->period + i)->line;
+    if (strcmp(prev, line) == 0)
+      continue;
+    na = clint_loop_fields(prev, a);
+    nb = clint_loop_fields(line, b);
+    if (na != nb) {
+      clint_loop_vary(state, "arguments", 9);
+      continue;
+    }
+    for (j = 0; j < na; j++) {
+      if (a[j].value_len != b[j].value_len || memcmp(a[j].value, b[j].value, a[j].value_len) != 0)
+        clint_loop_vary(state, b[j].name, b[j].name_len);
+    }
+  }
+}
+
+static void clint_loop_log(ClintLoopState *state, unsigned int first)
+{
+  for (; first != state->count; first++)
+    clint_log("%s", CLINT_LOOP_CALL(state, first)->line);
+}
+
+/* Called with the state locked. */
+static void clint_loop_end(ClintLoopState *state)
+{
+  unsigned int first = state->count - state->pos;
+  char varying[sizeof(state->varying) + 2 * (CLINT_LOOP_VARYING + 1)];
+  int i;
+
+  if (state->period == 0)
+    return;
+  if (state->repeats > 1) {
+    varying[0] = 0;
+    for (i = 0; i < state->num_varying; i++) {
+      strcat(varying, ", ");
+      strcat(varying, state->varying[i]);
+    }
+    clint_log("... x%u (%d calls)%s%s\n", state->repeats - 1, state->period, varying,
+              state->num_varying ? " vary" : "");
+  }
+  if (state->repeats > 0)
+    first -= state->period;
+  clint_loop_log(state, first);
+  state->period = 0;
+  state->pos = 0;
+  state->repeats = 0;
+  state->num_varying = 0;
+}
+
+static void clint_loop_detect(ClintLoopState *state)
+{
+  int p, i;
+
+  for (p = 1; p <= CLINT_LOOP_PERIOD && (unsigned int)(2 * p) <= state->count; p++) {
+    for (i = p - 1; i >= 0; i--) {
+      if (CLINT_LOOP_CALL(state, state->count - 2 * p + i)->key !=
+          CLINT_LOOP_CALL(state, state->count - p + i)->key)
+        break;
+    }
+    if (i < 0) {
+      state->period = p;
+      clint_loop_compare(state);
+      return;
+    }
+  }
+}
+
+static ClintLoopState *clint_loop_state(void)
+{
+  ClintLoopState *state;
+
+  CLINT_SPINLOCK_LOCK(g_clint_loop_lock);
+  if (g_clint_loop_init == 0) {
+    g_clint_loop_init = 1;
+    clint_tls_create(&g_clint_loop_key);
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_loop_lock);
+  state = (ClintLoopState*)clint_tls_get(&g_clint_loop_key);
+  if (state == NULL) {
+    state = (ClintLoopState*)calloc(1, sizeof(ClintLoopState));
+    if (state == NULL)
+      return NULL;
+    CLINT_SPINLOCK_LOCK(g_clint_loop_lock);
+    CLINT_STACK_PUSH(g_clint_loop_states, state);
+    CLINT_SPINLOCK_UNLOCK(g_clint_loop_lock);
+    clint_tls_set(&g_clint_loop_key, state);
+  }
+  return state;
+}
+
+void clint_loop_trace(int func, const char *line)
+{
+  ClintLoopState *state = clint_loop_state();
+  ClintLoopCall *call;
+  unsigned int key;
+  char *copy;
+
+  if (state == NULL || (copy = strdup(line)) == NULL) {
+    clint_log("%s", line);
+    return;
+  }
+  key = clint_loop_hash(func, line);
+
+  CLINT_SPINLOCK_LOCK(state->lock);
+  if (state->period != 0 && CLINT_LOOP_CALL(state, state->count - state->period)->key != key)
+    clint_loop_end(state);
+  call = CLINT_LOOP_CALL(state, state->count);
+  free(call->line);
+  call->key = key;
+  call->line = copy;
+  state->count++;
+  if (state->period != 0) {
+    if (++state->pos == state->period) {
+      state->pos = 0;
+      state->repeats++;
+      clint_loop_compare(state);
+    }
+  } else {
+    clint_log("%s", line);
+    clint_loop_detect(state);
+  }
+  CLINT_SPINLOCK_UNLOCK(state->lock);
+}
+
+void clint_loop_flush(void)
+{
+  ClintLoopState *state;
+
+  if (!g_clint_loop_init)
+    return;
+  state = (ClintLoopState*)clint_tls_get(&g_clint_loop_key);
+  if (state != NULL) {
+    CLINT_SPINLOCK_LOCK(state->lock);
+    clint_loop_end(state);
+    CLINT_SPINLOCK_UNLOCK(state->lock);
+  }
+}
+
+void clint_loop_shutdown(void)
+{
+  ClintLoopState *state;
+
+  CLINT_SPINLOCK_LOCK(g_clint_loop_lock);
+  state = g_clint_loop_states;
+  CLINT_SPINLOCK_UNLOCK(g_clint_loop_lock);
+  for (; state != NULL; state = state->next) {
+    CLINT_SPINLOCK_LOCK(state->lock);
+    clint_loop_end(state);
+    CLINT_SPINLOCK_UNLOCK(state->lock);
+  }
+}
@@ -0,0 +1,454 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_markers.h"
+#include "clint.h"
+#include "clint_atomic.h"
+#include "clint_clock.h"
+#include "clint_config.h"
+#include "clint_data.h"
+#include "clint_log.h"
+#include "clint_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+#if !defined(WIN32)
+#include <time.h>
+#endif
+
+typedef cl_int (CL_API_CALL *ClintEnqueueMarkerWithWaitListFn)(cl_command_queue, cl_uint, const cl_event *, cl_event *);
+typedef cl_int (CL_API_CALL *ClintEnqueueMarkerFn)(cl_command_queue, cl_event *);
+typedef cl_int (CL_API_CALL *ClintGetEventInfoFn)(cl_event, cl_event_info, size_t, void *, size_t *);
+typedef cl_int (CL_API_CALL *ClintGetEventProfilingInfoFn)(cl_event, cl_profiling_info, size_t, void *, size_t *);
+typedef cl_int (CL_API_CALL *ClintReleaseEventFn)(cl_event);
+typedef cl_int (CL_API_CALL *ClintGetCommandQueueInfoFn)(cl_command_queue, cl_command_queue_info, size_t, void *, size_t *);
+typedef cl_int (CL_API_CALL *ClintFlushFn)(cl_command_queue);
+
+static ClintEnqueueMarkerWithWaitListFn g_clint_enqueue_marker_with_wait_list;
+static ClintEnqueueMarkerFn g_clint_enqueue_marker;
+static ClintGetEventInfoFn g_clint_get_event_info;
+static ClintGetEventProfilingInfoFn g_clint_get_event_profiling_info;
+static ClintReleaseEventFn g_clint_release_event;
+static ClintGetCommandQueueInfoFn g_clint_get_command_queue_info;
+static ClintFlushFn g_clint_flush;
+
+/* A marker waits for every command enqueued before it, so its END is when
+   the batch of commands before it finished on the device.  That is latency
+   from the batch's first enqueue to completion, not device busy time: a host
+   that enqueues slowly keeps batches open while the device idles. */
+typedef struct ClintMarker {
+  struct ClintMarker *next;
+  cl_event event;
+  cl_ulong batch_ns;
+  cl_uint commands;
+  /* clint_time_now() around the marker's enqueue. */
+  cl_ulong host_lo;
+  cl_ulong host_hi;
+} ClintMarker;
+
+typedef struct ClintMarkerStats {
+  cl_ulong first_ns;
+  cl_ulong last_end_ns;
+  cl_ulong latency_ns;
+  cl_ulong markers;
+  cl_ulong completed_commands;
+} ClintMarkerStats;
+
+typedef struct ClintMarkerQueue {
+  CLINT_LIST_ELEMS(struct ClintMarkerQueue, cl_command_queue)
+  cl_device_id device;
+  cl_uint commands;
+  cl_ulong batch_ns;
+  /* Set while a thread polls and enqueues outside the lock. */
+  int busy;
+  ClintMarker *pending;
+  ClintMarker *pending_tail;
+  ClintMarkerStats stats;
+} ClintMarkerQueue;
+
+static ClintMarkerQueue *g_clint_marker_queues = NULL;
+/* Released queues whose markers haven't all completed yet. */
+static ClintMarkerQueue *g_clint_marker_released = NULL;
+/* Everything measured on released queues. */
+static ClintMarkerStats g_clint_marker_retired;
+static ClintSpinLock g_clint_markers_lock;
+
+static void clint_markers_load(void)
+{
+  if (g_clint_get_event_info == NULL) {
+    g_clint_enqueue_marker_with_wait_list =
+      (ClintEnqueueMarkerWithWaitListFn)clint_opencl_func("clEnqueueMarkerWithWaitList");
+    g_clint_enqueue_marker = (ClintEnqueueMarkerFn)clint_opencl_func("clEnqueueMarker");
+    g_clint_get_event_profiling_info = (ClintGetEventProfilingInfoFn)clint_opencl_func("clGetEventProfilingInfo");
+    g_clint_release_event = (ClintReleaseEventFn)clint_opencl_func("clReleaseEvent");
+    g_clint_get_command_queue_info = (ClintGetCommandQueueInfoFn)clint_opencl_func("clGetCommandQueueInfo");
+    g_clint_flush = (ClintFlushFn)clint_opencl_func("clFlush");
+    g_clint_get_event_info = (ClintGetEventInfoFn)clint_opencl_func("clGetEventInfo");
+  }
+}
+
+static void clint_markers_add(ClintMarkerStats *to, const ClintMarkerStats *from)
+{
+  if (from->markers == 0)
+    return;
+  if (to->first_ns == 0 || (from->first_ns != 0 && from->first_ns < to->first_ns))
+    to->first_ns = from->first_ns;
+  if (from->last_end_ns > to->last_end_ns)
+    to->last_end_ns = from->last_end_ns;
+  to->latency_ns += from->latency_ns;
+  to->markers += from->markers;
+  to->completed_commands += from->completed_commands;
+}
+
+/* Called without the lock, on markers taken off a queue.  Never waits: stops
+   at the first marker still pending, and returns it and the ones after it. */
+static ClintMarker *clint_markers_poll(cl_command_queue queue, cl_device_id device,
+                                       ClintMarker *pending, ClintMarkerStats *stats)
+{
+  while (pending != NULL) {
+    ClintMarker *marker = pending;
+    cl_int status = CL_QUEUED;
+    cl_ulong queued = 0, end = 0;
+
+    if (g_clint_get_event_info(marker->event, CL_EVENT_COMMAND_EXECUTION_STATUS,
+                               sizeof(cl_int), &status, NULL) != CL_SUCCESS)
+      status = -1;
+    if (status > CL_COMPLETE)
+      break;
+    if (status == CL_COMPLETE &&
+        g_clint_get_event_profiling_info(marker->event, CL_PROFILING_COMMAND_END,
+                                         sizeof(cl_ulong), &end, NULL) == CL_SUCCESS) {
+      /* Markers also keep the device clock calibrated without profiled commands. */
+      if (g_clint_get_event_profiling_info(marker->event, CL_PROFILING_COMMAND_QUEUED,
+                                           sizeof(cl_ulong), &queued, NULL) == CL_SUCCESS)
+        clint_clock_sample(device, queued, marker->host_lo, marker->host_hi);
+      end = clint_clock_to_host(device, end);
+      if (end > marker->batch_ns) {
+        stats->latency_ns += end - marker->batch_ns;
+        clint_log("MARKERS: %p %u commands %f latency\n", queue, marker->commands,
+                  (double)(end - marker->batch_ns) * 1.0e-9);
+      }
+      if (stats->first_ns == 0 || marker->batch_ns < stats->first_ns)
+        stats->first_ns = marker->batch_ns;
+      if (end > stats->last_end_ns)
+        stats->last_end_ns = end;
+      stats->markers++;
+      stats->completed_commands += marker->commands;
+    }
+    CLINT_STACK_POP(pending);
+    g_clint_release_event(marker->event);
+    free(marker);
+  }
+  return pending;
+}
+
+/* Called without the lock.  Closes the batch of commands enqueued since batch_ns. */
+static ClintMarker *clint_markers_insert(cl_command_queue queue, cl_ulong batch_ns, cl_uint commands)
+{
+  ClintMarker *marker;
+  cl_int err = CL_INVALID_OPERATION;
+
+  marker = (ClintMarker*)calloc(1, sizeof(ClintMarker));
+  if (marker == NULL)
+    return NULL;
+  marker->host_lo = clint_time_now();
+  if (g_clint_enqueue_marker_with_wait_list != NULL)
+    err = g_clint_enqueue_marker_with_wait_list(queue, 0, NULL, &marker->event);
+  if (err != CL_SUCCESS && g_clint_enqueue_marker != NULL)
+    err = g_clint_enqueue_marker(queue, &marker->event);
+  marker->host_hi = clint_time_now();
+  if (err != CL_SUCCESS) {
+    free(marker);
+    return NULL;
+  }
+  marker->batch_ns = batch_ns;
+  marker->commands = commands;
+  return marker;
+}
+
+/* Called with the lock held.  Puts markers still pending back in front of
+   any added meanwhile, and marker after them. */
+static void clint_markers_requeue(ClintMarkerQueue *q, ClintMarker *pending, ClintMarker *marker)
+{
+  ClintMarker *tail;
+
+  if (pending != NULL) {
+    for (tail = pending; tail->next != NULL; tail = tail->next) {}
+    tail->next = q->pending;
+    if (q->pending == NULL)
+      q->pending_tail = tail;
+    q->pending = pending;
+  }
+  if (marker != NULL) {
+    marker->next = NULL;
+    if (q->pending_tail != NULL)
+      q->pending_tail->next = marker;
+    else
+      q->pending = marker;
+    q->pending_tail = marker;
+  }
+}
+
+/* Called with the lock held.  Claims the queue for clint_markers_update, and
+   takes its open batch and pending markers. */
+static ClintMarker *clint_markers_take(ClintMarkerQueue *q, cl_ulong *batch_ns, cl_uint *commands)
+{
+  ClintMarker *pending = q->pending;
+
+  q->busy = 1;
+  *batch_ns = q->batch_ns;
+  *commands = q->commands;
+  q->commands = 0;
+  q->pending = NULL;
+  q->pending_tail = NULL;
+  return pending;
+}
+
+/* Called without the lock, by the thread that set q->busy.  Closes the open
+   batch if there is one and polls the markers.  Returns with the lock held
+   and q->busy still set. */
+static void clint_markers_update(ClintMarkerQueue *q, cl_ulong batch_ns, cl_uint commands,
+                                 ClintMarker *pending, int flush)
+{
+  ClintMarkerStats stats;
+  ClintMarker *marker = NULL;
+
+  memset(&stats, 0, sizeof(stats));
+  if (commands > 0) {
+    marker = clint_markers_insert(q->key, batch_ns, commands);
+    if (marker != NULL && flush && g_clint_flush != NULL)
+      g_clint_flush(q->key);
+  }
+  pending = clint_markers_poll(q->key, q->device, pending, &stats);
+  CLINT_SPINLOCK_LOCK(g_clint_markers_lock);
+  clint_markers_requeue(q, pending, marker);
+  clint_markers_add(&q->stats, &stats);
+}
+
+void clint_markers_enqueued(cl_command_queue queue)
+{
+  ClintMarkerQueue *q;
+  ClintMarker *pending = NULL;
+  cl_device_id device = NULL;
+  cl_ulong batch_ns = 0;
+  cl_uint commands = 0;
+  int interval = clint_get_config(CLINT_PROFILE_MARKERS);
+
+  if (queue == NULL || interval <= 0)
+    return;
+  clint_markers_load();
+  CLINT_SPINLOCK_LOCK(g_clint_markers_lock);
+  CLINT_LIST_FIND(q, g_clint_marker_queues, queue);
+  if (q == NULL) {
+    CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+    g_clint_get_command_queue_info(queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+    CLINT_SPINLOCK_LOCK(g_clint_markers_lock);
+    CLINT_LIST_FIND(q, g_clint_marker_queues, queue);
+    if (q == NULL) {
+      q = (ClintMarkerQueue*)calloc(1, sizeof(ClintMarkerQueue));
+      if (q == NULL) {
+        CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+        return;
+      }
+      q->device = device;
+      CLINT_LIST_INSERT(g_clint_marker_queues, queue, q);
+    }
+  }
+  if (q->commands++ == 0)
+    q->batch_ns = clint_time_now();
+  /* Another thread closing a batch on this queue just lets this one grow a little. */
+  if (q->commands >= (cl_uint)interval && !q->busy)
+    pending = clint_markers_take(q, &batch_ns, &commands);
+  CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+  if (commands > 0) {
+    clint_markers_update(q, batch_ns, commands, pending, 0);
+    q->busy = 0;
+    CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+  }
+}
+
+void clint_markers_release(cl_command_queue queue)
+{
+  ClintMarkerQueue *q;
+  ClintMarker *pending = NULL;
+  cl_ulong batch_ns = 0;
+  cl_uint commands = 0;
+  cl_uint count = 0;
+
+  if (queue == NULL)
+    return;
+  clint_markers_load();
+  if (g_clint_get_command_queue_info(queue, CL_QUEUE_REFERENCE_COUNT, sizeof(cl_uint), &count, NULL) != CL_SUCCESS ||
+      count != 1)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_markers_lock);
+  CLINT_LIST_FIND(q, g_clint_marker_queues, queue);
+  if (q != NULL && !q->busy) {
+    if (q->prev != NULL)
+      q->prev->next = q->next;
+    else
+      g_clint_marker_queues = q->next;
+    if (q->next != NULL)
+      q->next->prev = q->prev;
+    q->prev = NULL;
+    q->next = NULL;
+    pending = clint_markers_take(q, &batch_ns, &commands);
+  } else {
+    q = NULL;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+  if (q == NULL)
+    return;
+  /* Close the last batch while the queue is still valid; the release flushes it. */
+  clint_markers_update(q, batch_ns, commands, pending, 0);
+  /* The handle may be reused now. */
+  q->key = NULL;
+  q->busy = 0;
+  if (q->pending == NULL) {
+    clint_markers_add(&g_clint_marker_retired, &q->stats);
+    free(q);
+  } else {
+    q->next = g_clint_marker_released;
+    if (q->next != NULL)
+      q->next->prev = q;
+    g_clint_marker_released = q;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+}
+
+static void clint_markers_report_row(const ClintMarkerQueue *q, const ClintMarkerStats *stats)
+{
+  double span = (stats->last_end_ns > stats->first_ns) ? (double)(stats->last_end_ns - stats->first_ns) : 0.0;
+
+  if (q == NULL)
+    clint_log("%-18s ", "(released)");
+  else
+    clint_log("%-18p ", q->key);
+  clint_log("%10lu %10lu %12.6f %12.3f %12.6f\n",
+            (unsigned long)stats->markers, (unsigned long)stats->completed_commands,
+            (double)stats->latency_ns * 1.0e-9,
+            (double)stats->latency_ns * 1.0e-3 / (double)stats->markers, span * 1.0e-9);
+}
+
+/* Called with the lock held, and drops it while updating.  Polls every queue
+   in list, and returns whether markers are still pending. */
+static int clint_markers_poll_all(ClintMarkerQueue **list, int close)
+{
+  ClintMarkerQueue *q, *next;
+  ClintMarker *pending;
+  cl_ulong batch_ns;
+  cl_uint commands;
+  int waiting = 0;
+
+  for (q = *list; q != NULL; q = next) {
+    if (q->busy || (q->pending == NULL && (!close || q->commands == 0))) {
+      waiting |= (q->pending != NULL);
+      next = q->next;
+      continue;
+    }
+    pending = clint_markers_take(q, &batch_ns, &commands);
+    if (!close)
+      commands = 0;
+    CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+    clint_markers_update(q, batch_ns, commands, pending, 1);
+    q->busy = 0;
+    /* q stayed listed while busy, so its next is still valid. */
+    next = q->next;
+    if (q->pending != NULL) {
+      waiting = 1;
+    } else if (list == &g_clint_marker_released) {
+      if (q->prev != NULL)
+        q->prev->next = q->next;
+      else
+        g_clint_marker_released = q->next;
+      if (q->next != NULL)
+        q->next->prev = q->prev;
+      clint_markers_add(&g_clint_marker_retired, &q->stats);
+      free(q);
+    }
+  }
+  return waiting;
+}
+
+void clint_markers_report(int final)
+{
+  ClintMarkerQueue *q;
+  ClintMarkerStats retired;
+  cl_ulong deadline;
+  int header = 0;
+  int waiting;
+
+  clint_markers_load();
+  /* Close every open batch, and give the markers a moment to complete.  A
+     snapshot only collects the markers already done. */
+  CLINT_SPINLOCK_LOCK(g_clint_markers_lock);
+  waiting = clint_markers_poll_all(&g_clint_marker_queues, final);
+  waiting |= clint_markers_poll_all(&g_clint_marker_released, 0);
+  deadline = clint_time_now() + 1000000000;
+  while (final && waiting && clint_time_now() < deadline) {
+    CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+#if defined(WIN32)
+    Sleep(1);
+#else
+    {
+      struct timespec ts = { 0, 1000000 };
+      nanosleep(&ts, NULL);
+    }
+#endif
+    CLINT_SPINLOCK_LOCK(g_clint_markers_lock);
+    waiting = clint_markers_poll_all(&g_clint_marker_queues, 0);
+    waiting |= clint_markers_poll_all(&g_clint_marker_released, 0);
+  }
+
+  retired = g_clint_marker_retired;
+  /* Only report once, even if we're shutdown again. */
+  if (final)
+    memset(&g_clint_marker_retired, 0, sizeof(g_clint_marker_retired));
+  for (q = g_clint_marker_queues; q != NULL; q = q->next) {
+    if (q->stats.markers == 0)
+      continue;
+    if (!header) {
+      clint_log("Batch latency from markers:\n");
+      clint_log("%-18s %10s %10s %12s %12s %12s\n",
+                "queue", "batches", "commands", "latency (s)", "mean (us)", "span (s)");
+      header = 1;
+    }
+    clint_markers_report_row(q, &q->stats);
+    if (final)
+      memset(&q->stats, 0, sizeof(q->stats));
+  }
+  if (retired.markers > 0) {
+    if (!header) {
+      clint_log("Batch latency from markers:\n");
+      clint_log("%-18s %10s %10s %12s %12s %12s\n",
+                "queue", "batches", "commands", "latency (s)", "mean (us)", "span (s)");
+    }
+    clint_markers_report_row(NULL, &retired);
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_markers_lock);
+}
@@ -62,6 +62,9 @@ ClintObject_##type *clint_lookup_##type(cl_##type v)                \
   obj = clint_tree_find_ClintObject_##type(g_clint_objects_##type, v); \
   CLINT_SPINLOCK_UNLOCK(g_clint_lock_##type);                       \
   if (obj == NULL) {                                                \
+    /* Created before CLINT_TRACK was turned on at runtime. */      \
+    if (clint_config_changed(CLINT_TRACK))                          \
+      return NULL;                                                  \
     clint_log("ERROR: Unknown cl_" #type " %p\n", v);               \
     clint_log_abort();                                              \
     return NULL;                                                    \
@@ -81,6 +84,12 @@ void clint_check_input_##type(cl_##type v)                          \
   (void)clint_lookup_##type(v);                                     \
 }                                                                   \
                                                                     \
+cl_context clint_context_of_##type(cl_##type v)                     \
+{                                                                   \
+  ClintObject_##type *obj = clint_lookup_##type(v);                 \
+  return (obj != NULL) ? obj->context : NULL;                       \
+}                                                                   \
+                                                                    \
 void clint_check_output_##type(cl_##type v, void *src, ClintObjType t ARGS) \
 {                                                                   \
   if (clint_get_config(CLINT_TRACK)) {                              \
@@ -106,28 +115,28 @@ void clint_check_output_##type(cl_##type v, void *src, ClintObjType t ARGS) \
       obj->context = (cl_context)src;                               \
       break;                                                        \
     case ClintObjectType_command_queue:                             \
-      obj->context = clint_lookup_command_queue((cl_command_queue)src)->context; \
+      obj->context = clint_context_of_command_queue((cl_command_queue)src); \
       break;                                                        \
     case ClintObjectType_mem:                                       \
     case ClintObjectType_sub_bufer:                                 \
     case ClintObjectType_image2d:                                   \
     case ClintObjectType_image3d:                                   \
-      obj->context = clint_lookup_mem((cl_mem)src)->context;        \
+      obj->context = clint_context_of_mem((cl_mem)src);             \
       break;                                                        \
     case ClintObjectType_program:                                   \
-      obj->context = clint_lookup_program((cl_program)src)->context;\
+      obj->context = clint_context_of_program((cl_program)src);     \
       break;                                                        \
     case ClintObjectType_kernel:                                    \
-      obj->context = clint_lookup_kernel((cl_kernel)src)->context;  \
+      obj->context = clint_context_of_kernel((cl_kernel)src);       \
       break;                                                        \
     case ClintObjectType_event:                                     \
-      obj->context = clint_lookup_event((cl_event)src)->context;    \
+      obj->context = clint_context_of_event((cl_event)src);         \
       break;                                                        \
     case ClintObjectType_sampler:                                   \
-      obj->context = clint_lookup_sampler((cl_sampler)src)->context;\
+      obj->context = clint_context_of_sampler((cl_sampler)src);     \
       break;                                                        \
     case ClintObjectType_device:                                    \
-      obj->context = clint_lookup_device_id((cl_device_id)src)->context; \
+      obj->context = clint_context_of_device_id((cl_device_id)src); \
       break;                                                        \
     default:                                                        \
       obj->context = NULL;                                          \
@@ -72,6 +72,7 @@ typedef struct ClintObject_##type {                                 \
 } ClintObject_##type;                                               \
                                                                     \
 ClintObject_##type *clint_lookup_##type(cl_##type v);               \
+cl_context clint_context_of_##type(cl_##type v);                    \
 void clint_check_input_##type(cl_##type v);                         \
 void clint_check_output_##type(cl_##type v, void *src, ClintObjType t ARGS); \
 void clint_check_input_##type##s(cl_uint num, const cl_##type *v);  \
@@ -0,0 +1,372 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_profile.h"
+#include "clint.h"
+#include "clint_atomic.h"
+#include "clint_clock.h"
+#include "clint_config.h"
+#include "clint_filter.h"
+#include "clint_frame.h"
+#include "clint_log.h"
+#include "clint_shm.h"
+#include "clint_slo.h"
+#include "clint_time.h"
+#include "clint_timeline.h"
+
+#include <string.h>
+
+typedef cl_int (CL_API_CALL *ClintWaitForEventsFn)(cl_uint, const cl_event *);
+typedef cl_int (CL_API_CALL *ClintGetEventProfilingInfoFn)(cl_event, cl_profiling_info, size_t, void *, size_t *);
+typedef cl_int (CL_API_CALL *ClintGetImageInfoFn)(cl_mem, cl_image_info, size_t, void *, size_t *);
+typedef cl_int (CL_API_CALL *ClintRetainEventFn)(cl_event);
+typedef cl_int (CL_API_CALL *ClintReleaseEventFn)(cl_event);
+typedef cl_int (CL_API_CALL *ClintSetEventCallbackFn)(cl_event, cl_int, void (CL_CALLBACK *)(cl_event, cl_int, void *), void *);
+typedef cl_int (CL_API_CALL *ClintGetCommandQueueInfoFn)(cl_command_queue, cl_command_queue_info, size_t, void *, size_t *);
+
+static ClintWaitForEventsFn g_clint_wait_for_events;
+static ClintGetEventProfilingInfoFn g_clint_get_event_profiling_info;
+static ClintGetImageInfoFn g_clint_get_image_info;
+static ClintGetCommandQueueInfoFn g_clint_get_command_queue_info;
+static ClintRetainEventFn g_clint_retain_event;
+static ClintReleaseEventFn g_clint_release_event;
+static ClintSetEventCallbackFn g_clint_set_event_callback;
+
+/* Transfers are bucketed by size: < 4KB, < 16KB, ... < 64MB, >= 64MB. */
+#define CLINT_PROFILE_BUCKETS 9
+
+typedef struct ClintTransferStats {
+  cl_ulong count;
+  cl_ulong bytes;
+  cl_ulong ns;
+} ClintTransferStats;
+
+static const char *g_clint_transfer_names[ClintTransfer_max] = {
+  "none",
+  "H2D",
+  "D2H",
+  "D2D"
+};
+
+static const char *g_clint_bucket_names[CLINT_PROFILE_BUCKETS] = {
+  "< 4KB",
+  "< 16KB",
+  "< 64KB",
+  "< 256KB",
+  "< 1MB",
+  "< 4MB",
+  "< 16MB",
+  "< 64MB",
+  ">= 64MB"
+};
+
+/* Outstanding writable mappings; more than this many at once are not counted. */
+#define CLINT_PROFILE_MAPS 256
+
+typedef struct ClintProfileMap {
+  cl_mem mem;
+  void *ptr;
+  size_t bytes;
+} ClintProfileMap;
+
+static ClintTransferStats g_clint_transfer_stats[ClintTransfer_max][CLINT_PROFILE_BUCKETS];
+static ClintProfileMap g_clint_profile_maps[CLINT_PROFILE_MAPS];
+static int g_clint_profile_map_count;
+static ClintSpinLock g_clint_profile_lock;
+
+static void clint_profile_load(void)
+{
+  /* The real entry points, so internal queries aren't traced or profiled. */
+  if (g_clint_get_event_profiling_info == NULL) {
+    g_clint_wait_for_events = (ClintWaitForEventsFn)clint_opencl_func("clWaitForEvents");
+    g_clint_get_image_info = (ClintGetImageInfoFn)clint_opencl_func("clGetImageInfo");
+    g_clint_get_command_queue_info = (ClintGetCommandQueueInfoFn)clint_opencl_func("clGetCommandQueueInfo");
+    g_clint_retain_event = (ClintRetainEventFn)clint_opencl_func("clRetainEvent");
+    g_clint_release_event = (ClintReleaseEventFn)clint_opencl_func("clReleaseEvent");
+    g_clint_set_event_callback = (ClintSetEventCallbackFn)clint_opencl_func("clSetEventCallback");
+    g_clint_get_event_profiling_info = (ClintGetEventProfilingInfoFn)clint_opencl_func("clGetEventProfilingInfo");
+  }
+}
+
+static int clint_profile_bucket(size_t bytes)
+{
+  int bucket = 0;
+  size_t limit = 4096;
+
+  while (bucket < CLINT_PROFILE_BUCKETS - 1 && bytes >= limit) {
+    bucket++;
+    limit *= 4;
+  }
+  return bucket;
+}
+
+static int clint_profile_sampling(void)
+{
+  return clint_get_config(CLINT_PROFILE_SAMPLE) > 1 || clint_get_config(CLINT_PROFILE_BUDGET) > 0;
+}
+
+int clint_profile_begin(ClintProfileCommand *cmd, const char *name, cl_command_queue queue, cl_kernel kernel)
+{
+  memset(cmd, 0, sizeof(ClintProfileCommand));
+  cmd->name = name;
+  cmd->queue = queue;
+  cmd->range = clint_annotate_current();
+  /* The wrapper counted the command in its frame, profiled or not. */
+  if (clint_get_config(CLINT_PROFILE_FRAME))
+    cmd->frame = clint_frame_current();
+  if (kernel != NULL) {
+    cmd->kernel = clint_kernels_lookup(kernel);
+    if (cmd->kernel != NULL && (cmd->kernel->filter & CLINT_FILTER_PROFILE) == 0)
+      return 0;
+    if (!clint_kernels_sample(cmd->kernel))
+      return 0;
+  }
+  if (clint_get_config_string(CLINT_PROFILE_STACKS) != NULL)
+    cmd->stack = clint_flame_capture((cmd->kernel != NULL) ? cmd->kernel->name : name);
+  cmd->host_enqueue = clint_time_now();
+  return 1;
+}
+
+void clint_profile_ndrange(ClintProfileCommand *cmd, cl_uint work_dim,
+                           const size_t *global_work_size, const size_t *local_work_size)
+{
+  cl_uint i;
+
+  cmd->shape.dims = (work_dim < 3) ? work_dim : 3;
+  for (i = 0; i < cmd->shape.dims; i++) {
+    cmd->shape.global[i] = (global_work_size != NULL) ? global_work_size[i] : 0;
+    cmd->shape.local[i] = (local_work_size != NULL) ? local_work_size[i] : 0;
+  }
+}
+
+void clint_profile_transfer(ClintProfileCommand *cmd, ClintTransfer transfer, size_t bytes)
+{
+  cmd->transfer = transfer;
+  cmd->bytes = bytes;
+}
+
+void clint_profile_map(const ClintProfileCommand *cmd, cl_mem mem, void *ptr)
+{
+  CLINT_SPINLOCK_LOCK(g_clint_profile_lock);
+  if (g_clint_profile_map_count < CLINT_PROFILE_MAPS) {
+    ClintProfileMap *map = &g_clint_profile_maps[g_clint_profile_map_count++];
+    map->mem = mem;
+    map->ptr = ptr;
+    map->bytes = cmd->bytes;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_profile_lock);
+}
+
+void clint_profile_unmap(ClintProfileCommand *cmd, cl_mem mem, void *ptr)
+{
+  int i;
+
+  CLINT_SPINLOCK_LOCK(g_clint_profile_lock);
+  for (i = g_clint_profile_map_count - 1; i >= 0; i--) {
+    if (g_clint_profile_maps[i].mem == mem && g_clint_profile_maps[i].ptr == ptr) {
+      clint_profile_transfer(cmd, ClintTransfer_host_to_device, g_clint_profile_maps[i].bytes);
+      g_clint_profile_maps[i] = g_clint_profile_maps[--g_clint_profile_map_count];
+      break;
+    }
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_profile_lock);
+}
+
+size_t clint_profile_region_bytes(cl_mem image, const size_t *region)
+{
+  size_t element_size = 1;
+
+  if (region == NULL)
+    return 0;
+  if (image != NULL) {
+    clint_profile_load();
+    if (g_clint_get_image_info == NULL ||
+        g_clint_get_image_info(image, CL_IMAGE_ELEMENT_SIZE, sizeof(size_t), &element_size, NULL) != CL_SUCCESS) {
+      element_size = 0;
+    }
+  }
+  return element_size * region[0] * region[1] * region[2];
+}
+
+static void clint_profile_record_transfer(const ClintProfileCommand *cmd)
+{
+  ClintTransferStats *stats;
+
+  if (cmd->transfer == ClintTransfer_none || cmd->end <= cmd->start)
+    return;
+  stats = &g_clint_transfer_stats[cmd->transfer][clint_profile_bucket(cmd->bytes)];
+  CLINT_SPINLOCK_LOCK(g_clint_profile_lock);
+  stats->count++;
+  stats->bytes += cmd->bytes;
+  stats->ns += cmd->end - cmd->start;
+  CLINT_SPINLOCK_UNLOCK(g_clint_profile_lock);
+}
+
+static cl_int clint_profile_query(ClintProfileCommand *cmd, cl_event event)
+{
+  cl_int err;
+  double elapsed;
+  const char *range_sep = (cmd->range != NULL) ? " in " : "";
+  const char *range_name = (cmd->range != NULL) ? cmd->range->name : "";
+
+  err = g_clint_get_event_profiling_info(event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &cmd->queued, NULL);
+  if (err) return err;
+  err = g_clint_get_event_profiling_info(event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &cmd->submit, NULL);
+  if (err) return err;
+  err = g_clint_get_event_profiling_info(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &cmd->start, NULL);
+  if (err) return err;
+  err = g_clint_get_event_profiling_info(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &cmd->end, NULL);
+  if (err) return err;
+  if (cmd->queue != NULL)
+    g_clint_get_command_queue_info(cmd->queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &cmd->device, NULL);
+  if (cmd->device != NULL) {
+    /* The driver stamped QUEUED while we were inside the enqueue call. */
+    clint_clock_sample(cmd->device, cmd->queued, cmd->host_enqueue, cmd->host_return);
+    cmd->host_start = clint_clock_to_host(cmd->device, cmd->start);
+    cmd->host_end = clint_clock_to_host(cmd->device, cmd->end);
+  }
+  elapsed = (double)(cmd->end - cmd->start) * 1.0e-9;
+  if (cmd->transfer != ClintTransfer_none) {
+    /* Bytes per nanosecond is GB/s. */
+    clint_log("PROFILE: %s %f %lu bytes %.3f GB/s%s%s\n", cmd->name, elapsed, (unsigned long)cmd->bytes,
+              (cmd->end > cmd->start) ? (double)cmd->bytes / (double)(cmd->end - cmd->start) : 0.0,
+              range_sep, range_name);
+    clint_profile_record_transfer(cmd);
+  } else {
+    clint_log("PROFILE: %s %f%s%s\n", cmd->name, elapsed, range_sep, range_name);
+  }
+  if (cmd->end >= cmd->start) {
+    CLINT_SHM_ADD(device_busy_ns, cmd->end - cmd->start);
+  }
+  if (cmd->kernel != NULL && cmd->end >= cmd->start)
+    clint_kernels_record(cmd->kernel, cmd->device, &cmd->shape, cmd->end - cmd->start,
+                         (cmd->start >= cmd->queued) ? cmd->start - cmd->queued : 0, cmd->host_enqueue);
+  if (cmd->range != NULL && cmd->end >= cmd->start)
+    clint_annotate_record(cmd->range, cmd->end - cmd->start);
+  if (cmd->frame != 0 && cmd->end >= cmd->start)
+    clint_frame_command(cmd->frame, cmd->end - cmd->start,
+                        (cmd->transfer != ClintTransfer_none) ? cmd->bytes : 0);
+  if (cmd->stack != NULL && cmd->end >= cmd->start)
+    clint_flame_record(cmd->stack, cmd->end - cmd->start);
+  if (clint_get_config(CLINT_PROFILE_TIMELINE))
+    clint_timeline_command(cmd);
+  if (clint_get_config(CLINT_PROFILE_SLO))
+    clint_slo_completed(cmd);
+  return err;
+}
+
+static void CL_CALLBACK clint_profile_callback(cl_event event, cl_int status, void *user_data)
+{
+  ClintProfileCommand *cmd = (ClintProfileCommand*)user_data;
+
+  if (status == CL_COMPLETE)
+    clint_profile_query(cmd, event);
+  g_clint_release_event(event);
+  free(cmd);
+}
+
+cl_int clint_profile_end(ClintProfileCommand *cmd, cl_event event)
+{
+  cl_int err;
+
+  cmd->host_return = clint_time_now();
+  clint_profile_load();
+  /* When sampling, transfers too, so the launches in between aren't held up. */
+  if ((clint_profile_sampling() || clint_get_config(CLINT_PROFILE_TIMELINE) ||
+       clint_get_config(CLINT_PROFILE_SLO)) &&
+      g_clint_set_event_callback != NULL) {
+    /* Waiting would stall the application and distort the timeline; finish on completion. */
+    ClintProfileCommand *copy = (ClintProfileCommand*)malloc(sizeof(ClintProfileCommand));
+    if (copy != NULL) {
+      *copy = *cmd;
+      if (clint_get_config(CLINT_PROFILE_SLO))
+        clint_slo_enqueued(copy);
+      g_clint_retain_event(event);
+      if (g_clint_set_event_callback(event, CL_COMPLETE, clint_profile_callback, copy) == CL_SUCCESS)
+        return CL_SUCCESS;
+      if (clint_get_config(CLINT_PROFILE_SLO))
+        clint_slo_cancel(copy);
+      g_clint_release_event(event);
+      free(copy);
+    }
+  }
+  err = g_clint_wait_for_events(1, &event);
+  if (err) return err;
+  return clint_profile_query(cmd, event);
+}
+
+static void clint_profile_report_transfers(int final)
+{
+  ClintTransferStats stats[ClintTransfer_max][CLINT_PROFILE_BUCKETS];
+  int header = 0;
+  int t, b;
+
+  CLINT_SPINLOCK_LOCK(g_clint_profile_lock);
+  memcpy(stats, g_clint_transfer_stats, sizeof(stats));
+  /* Only report once, even if we're shutdown again. */
+  if (final)
+    memset(g_clint_transfer_stats, 0, sizeof(g_clint_transfer_stats));
+  CLINT_SPINLOCK_UNLOCK(g_clint_profile_lock);
+
+  for (t = ClintTransfer_none + 1; t < ClintTransfer_max; t++) {
+    ClintTransferStats total;
+    memset(&total, 0, sizeof(total));
+    for (b = 0; b < CLINT_PROFILE_BUCKETS; b++) {
+      total.count += stats[t][b].count;
+      total.bytes += stats[t][b].bytes;
+      total.ns += stats[t][b].ns;
+    }
+    if (total.count == 0)
+      continue;
+    if (!header) {
+      clint_log("Transfer bandwidth:\n");
+      header = 1;
+    }
+    clint_log("%s: %lu transfers, %.3f MB in %f s, %.3f GB/s\n",
+              g_clint_transfer_names[t], (unsigned long)total.count,
+              (double)total.bytes * 1.0e-6, (double)total.ns * 1.0e-9,
+              (double)total.bytes / (double)total.ns);
+    for (b = 0; b < CLINT_PROFILE_BUCKETS; b++) {
+      if (stats[t][b].count == 0)
+        continue;
+      clint_log("\t%s %s: %lu transfers, %.3f MB, %.3f GB/s\n",
+                g_clint_transfer_names[t], g_clint_bucket_names[b],
+                (unsigned long)stats[t][b].count,
+                (double)stats[t][b].bytes * 1.0e-6,
+                (double)stats[t][b].bytes / (double)stats[t][b].ns);
+    }
+  }
+}
+
+void clint_profile_report(int final)
+{
+  clint_kernels_report(final);
+  clint_profile_report_transfers(final);
+  clint_annotate_report(final);
+  clint_flame_report(final);
+}
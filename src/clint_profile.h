@@ -0,0 +1,106 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_PROFILE_H_
+#define _CLINT_PROFILE_H_
+
+#include "clint_annotate.h"
+#include "clint_flame.h"
+#include "clint_kernels.h"
+
+#include <stdlib.h>
+
+#ifdef __APPLE__
+#include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum ClintTransfer {
+  ClintTransfer_none,
+  ClintTransfer_host_to_device,
+  ClintTransfer_device_to_host,
+  ClintTransfer_device_to_device,
+  ClintTransfer_max
+} ClintTransfer;
+
+/* One profiled command, filled in by the generated wrappers. */
+typedef struct ClintProfileCommand {
+  const char *name;
+  cl_command_queue queue;
+  ClintKernelStats *kernel;
+  ClintKernelShape shape;
+  /* The clintPushRangeCLINT range active on the enqueuing thread. */
+  ClintRange *range;
+  /* The enqueuing host stack, for CLINT_PROFILE_STACKS. */
+  ClintFlameStack *stack;
+  /* CLINT_PROFILE_FRAME frame number, or 0. */
+  cl_uint frame;
+  /* Commands in flight on the same queue, for CLINT_PROFILE_SLO. */
+  struct ClintProfileCommand *slo_next;
+  struct ClintProfileCommand *slo_prev;
+  int slo_inflight;
+  ClintTransfer transfer;
+  size_t bytes;
+  cl_ulong queued;
+  cl_ulong submit;
+  cl_ulong start;
+  cl_ulong end;
+  /* clint_time_now() around the enqueue, and START and END on the same clock. */
+  cl_device_id device;
+  cl_ulong host_enqueue;
+  cl_ulong host_return;
+  cl_ulong host_start;
+  cl_ulong host_end;
+} ClintProfileCommand;
+
+/* Returns 0 if this launch was not sampled and should pass through untouched. */
+int clint_profile_begin(ClintProfileCommand *cmd, const char *name, cl_command_queue queue, cl_kernel kernel);
+void clint_profile_transfer(ClintProfileCommand *cmd, ClintTransfer transfer, size_t bytes);
+void clint_profile_ndrange(ClintProfileCommand *cmd, cl_uint work_dim,
+                           const size_t *global_work_size, const size_t *local_work_size);
+/* Remember a writable mapping, so its unmap is counted as a host to device transfer. */
+void clint_profile_map(const ClintProfileCommand *cmd, cl_mem mem, void *ptr);
+void clint_profile_unmap(ClintProfileCommand *cmd, cl_mem mem, void *ptr);
+cl_int clint_profile_end(ClintProfileCommand *cmd, cl_event event);
+
+/* Bytes moved by a rect or image command.  For buffers region[0] is in bytes. */
+size_t clint_profile_region_bytes(cl_mem image, const size_t *region);
+
+/* Log the accumulated statistics.  The final report starts them over. */
+void clint_profile_report(int final);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_PROFILE_H_
@@ -0,0 +1,111 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_shm.h"
+#include "clint_opencl_funcs.h"
+#include "clint_thread.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ClintShmHeader *g_clint_shm = NULL;
+static char g_clint_shm_name[64];
+
+void clint_shm_init(void)
+{
+  size_t size = CLINT_SHM_SIZE(ClintFunc_max);
+  ClintShmHeader *shm;
+  char *names;
+  int i;
+
+  if (g_clint_shm != NULL)
+    return;
+#if defined(WIN32)
+  {
+    HANDLE handle;
+    sprintf_s(g_clint_shm_name, sizeof(g_clint_shm_name), "Local\\clint.%lu",
+              (unsigned long)clint_get_process_id());
+    handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size,
+                                g_clint_shm_name);
+    if (handle == NULL)
+      return;
+    /* The handle stays open so the mapping lives until we exit. */
+    shm = (ClintShmHeader*)MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (shm == NULL) {
+      CloseHandle(handle);
+      return;
+    }
+  }
+#else
+  {
+    int fd;
+    snprintf(g_clint_shm_name, sizeof(g_clint_shm_name), "/clint.%ld", (long)clint_get_process_id());
+    fd = shm_open(g_clint_shm_name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0)
+      return;
+    if (ftruncate(fd, (off_t)size) != 0) {
+      close(fd);
+      shm_unlink(g_clint_shm_name);
+      return;
+    }
+    shm = (ClintShmHeader*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == (ClintShmHeader*)MAP_FAILED) {
+      shm_unlink(g_clint_shm_name);
+      return;
+    }
+  }
+#endif
+  memset(shm, 0, size);
+  shm->version = CLINT_SHM_VERSION;
+  shm->pid = (long)clint_get_process_id();
+  shm->num_funcs = ClintFunc_max;
+  names = CLINT_SHM_NAMES(shm);
+  for (i = 0; i < ClintFunc_max; i++) {
+    strncpy(names + i * CLINT_SHM_NAME_SIZE, clint_func_name((ClintFunc)i), CLINT_SHM_NAME_SIZE - 1);
+  }
+  /* Readers ignore the region until the magic is set. */
+  shm->magic = CLINT_SHM_MAGIC;
+  g_clint_shm = shm;
+}
+
+void clint_shm_shutdown(void)
+{
+  /* Other threads may still be counting, so leave the region mapped. */
+#if !defined(WIN32)
+  if (g_clint_shm != NULL)
+    shm_unlink(g_clint_shm_name);
+#endif
+}
@@ -0,0 +1,94 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_SHM_H_
+#define _CLINT_SHM_H_
+
+#include "clint_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Live counters published in /dev/shm/clint.<pid> (Local\clint.<pid> on Windows)
+   for clinttop.  Only ever updated with relaxed atomic adds. */
+#define CLINT_SHM_MAGIC 0x434c494e54534831LL /* CLINTSH1 */
+#define CLINT_SHM_VERSION 1
+#define CLINT_SHM_NAME_SIZE 64
+
+typedef enum ClintShmObject {
+  ClintShmObject_context,
+  ClintShmObject_command_queue,
+  ClintShmObject_mem,
+  ClintShmObject_sampler,
+  ClintShmObject_program,
+  ClintShmObject_kernel,
+  ClintShmObject_event,
+  ClintShmObject_max
+} ClintShmObject;
+
+typedef struct ClintShmHeader {
+  ClintAtomicInt64 magic;
+  ClintAtomicInt64 version;
+  ClintAtomicInt64 pid;
+  ClintAtomicInt64 num_funcs;
+  ClintAtomicInt64 kernels;
+  ClintAtomicInt64 buffer_bytes;
+  ClintAtomicInt64 device_busy_ns;
+  /* Outstanding references: creates and retains minus releases. */
+  ClintAtomicInt64 objects[ClintShmObject_max];
+} ClintShmHeader;
+
+/* The header is followed by num_funcs call counters, then num_funcs names. */
+#define CLINT_SHM_CALLS(shm) ((ClintAtomicInt64*)((shm) + 1))
+#define CLINT_SHM_NAMES(shm) ((char*)(CLINT_SHM_CALLS(shm) + (shm)->num_funcs))
+#define CLINT_SHM_SIZE(num_funcs) \
+  (sizeof(ClintShmHeader) + (num_funcs) * (sizeof(ClintAtomicInt64) + CLINT_SHM_NAME_SIZE))
+
+/* NULL unless CLINT_SHM is set, so counting costs one test when off. */
+extern ClintShmHeader *g_clint_shm;
+
+#define CLINT_SHM_ADD(field, v)                                         \
+  do {                                                                  \
+    if (g_clint_shm != NULL)                                            \
+      CLINT_ATOMIC_ADD64(v, g_clint_shm->field);                        \
+  } while (0)
+#define CLINT_SHM_CALL(func)                                            \
+  do {                                                                  \
+    if (g_clint_shm != NULL)                                            \
+      CLINT_ATOMIC_ADD64(1, CLINT_SHM_CALLS(g_clint_shm)[func]);        \
+  } while (0)
+
+void clint_shm_init(void);
+void clint_shm_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_SHM_H_
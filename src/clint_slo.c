@@ -0,0 +1,211 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_slo.h"
+#include "clint_atomic.h"
+#include "clint_config.h"
+#include "clint_log.h"
+#include "clint_time.h"
+#include "clint_tree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The latest completions per queue, and how often the window's p99 is checked. */
+#define CLINT_SLO_WINDOW 512
+#define CLINT_SLO_CHECK 32
+#define CLINT_SLO_INFLIGHT 10
+
+typedef struct ClintSloQueue {
+  CLINT_TREE_ELEMS(struct ClintSloQueue, cl_command_queue);
+  cl_ulong window[CLINT_SLO_WINDOW];
+  int next;
+  int count;
+  cl_ulong completions;
+  cl_ulong violations;
+  cl_ulong worst_p99;
+  int violating;
+  /* Commands waiting for their completion callback, newest first. */
+  ClintProfileCommand *inflight;
+} ClintSloQueue;
+
+CLINT_DEFINE_TREE_FUNCS(ClintSloQueue, cl_command_queue);
+CLINT_IMPL_TREE_FUNCS(ClintSloQueue, cl_command_queue);
+
+static ClintSloQueue *g_clint_slo_queues = NULL;
+static ClintSpinLock g_clint_slo_lock;
+
+/* Called with the lock held. */
+static ClintSloQueue *clint_slo_queue(cl_command_queue queue)
+{
+  ClintSloQueue *q = clint_tree_find_ClintSloQueue(g_clint_slo_queues, queue);
+
+  if (q == NULL) {
+    q = (ClintSloQueue*)calloc(1, sizeof(ClintSloQueue));
+    if (q != NULL)
+      clint_tree_insert_ClintSloQueue(&g_clint_slo_queues, queue, q);
+  }
+  return q;
+}
+
+void clint_slo_enqueued(ClintProfileCommand *cmd)
+{
+  ClintSloQueue *q;
+
+  if (cmd->queue == NULL)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_slo_lock);
+  q = clint_slo_queue(cmd->queue);
+  if (q != NULL) {
+    cmd->slo_prev = NULL;
+    cmd->slo_next = q->inflight;
+    if (q->inflight != NULL)
+      q->inflight->slo_prev = cmd;
+    q->inflight = cmd;
+    cmd->slo_inflight = 1;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_slo_lock);
+}
+
+/* Called with the lock held. */
+static void clint_slo_remove(ClintSloQueue *q, ClintProfileCommand *cmd)
+{
+  if (!cmd->slo_inflight)
+    return;
+  if (cmd->slo_prev != NULL)
+    cmd->slo_prev->slo_next = cmd->slo_next;
+  else
+    q->inflight = cmd->slo_next;
+  if (cmd->slo_next != NULL)
+    cmd->slo_next->slo_prev = cmd->slo_prev;
+  cmd->slo_inflight = 0;
+}
+
+void clint_slo_cancel(ClintProfileCommand *cmd)
+{
+  ClintSloQueue *q;
+
+  CLINT_SPINLOCK_LOCK(g_clint_slo_lock);
+  q = clint_tree_find_ClintSloQueue(g_clint_slo_queues, cmd->queue);
+  if (q != NULL)
+    clint_slo_remove(q, cmd);
+  CLINT_SPINLOCK_UNLOCK(g_clint_slo_lock);
+}
+
+static int clint_slo_compare(const void *a, const void *b)
+{
+  cl_ulong ta = *(const cl_ulong*)a;
+  cl_ulong tb = *(const cl_ulong*)b;
+
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+/* Called with the lock held. */
+static cl_ulong clint_slo_p99(const ClintSloQueue *q)
+{
+  cl_ulong sorted[CLINT_SLO_WINDOW];
+
+  memcpy(sorted, q->window, sizeof(cl_ulong) * q->count);
+  qsort(sorted, q->count, sizeof(cl_ulong), clint_slo_compare);
+  return sorted[(q->count * 99) / 100];
+}
+
+/* Called with the lock held. */
+static void clint_slo_log_inflight(const ClintSloQueue *q)
+{
+  const ClintProfileCommand *cmd;
+  cl_ulong now = clint_time_now();
+  int n = 0;
+
+  for (cmd = q->inflight; cmd != NULL; cmd = cmd->slo_next) {
+    if (n++ == CLINT_SLO_INFLIGHT) {
+      clint_log("\t...\n");
+      break;
+    }
+    clint_log("\tin flight: %s, enqueued %.3f ms ago\n",
+              (cmd->kernel != NULL) ? cmd->kernel->name : cmd->name,
+              (double)(now - cmd->host_enqueue) * 1.0e-6);
+  }
+}
+
+void clint_slo_completed(ClintProfileCommand *cmd)
+{
+  cl_ulong threshold = (cl_ulong)clint_get_config(CLINT_PROFILE_SLO) * 1000;
+  ClintSloQueue *q;
+
+  if (cmd->queue == NULL || cmd->end < cmd->queued)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_slo_lock);
+  q = clint_slo_queue(cmd->queue);
+  if (q == NULL) {
+    CLINT_SPINLOCK_UNLOCK(g_clint_slo_lock);
+    return;
+  }
+  clint_slo_remove(q, cmd);
+  q->window[q->next] = cmd->end - cmd->queued;
+  q->next = (q->next + 1) % CLINT_SLO_WINDOW;
+  if (q->count < CLINT_SLO_WINDOW)
+    q->count++;
+  q->completions++;
+  /* A p99 needs 100 samples to mean anything. */
+  if (q->count >= 100 && q->completions % CLINT_SLO_CHECK == 0) {
+    cl_ulong p99 = clint_slo_p99(q);
+    if (p99 > q->worst_p99)
+      q->worst_p99 = p99;
+    if (p99 > threshold && !q->violating) {
+      q->violating = 1;
+      q->violations++;
+      clint_log("SLO: queue %p p99 latency %.3f ms exceeds %.3f ms\n",
+                cmd->queue, (double)p99 * 1.0e-6, (double)threshold * 1.0e-6);
+      clint_slo_log_inflight(q);
+    } else if (p99 <= threshold && q->violating) {
+      q->violating = 0;
+      clint_log("SLO: queue %p p99 latency %.3f ms back within %.3f ms\n",
+                cmd->queue, (double)p99 * 1.0e-6, (double)threshold * 1.0e-6);
+    }
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_slo_lock);
+}
+
+void clint_slo_report(int final)
+{
+  ClintSloQueue *q;
+
+  CLINT_SPINLOCK_LOCK(g_clint_slo_lock);
+  for (q = clint_tree_first_ClintSloQueue(g_clint_slo_queues); q != NULL; q = clint_tree_next_ClintSloQueue(q)) {
+    if (q->completions == 0)
+      continue;
+    clint_log("SLO: queue %p: %lu commands, p99 above target %lu times, worst p99 %.3f ms\n",
+              q->_key, (unsigned long)q->completions, (unsigned long)q->violations,
+              (double)q->worst_p99 * 1.0e-6);
+    /* Only report once, even if we're shutdown again. */
+    if (final)
+      q->completions = 0;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_slo_lock);
+}
@@ -26,6 +26,10 @@
 ** THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#if !defined(__APPLE__) && !defined(WIN32)
+#define _GNU_SOURCE
+#endif
+
 #include "clint_stack.h"
 
 #include <stdlib.h>
@@ -37,7 +41,9 @@
 #include <stdio.h>
 #pragma comment(lib,"DbgHelp.lib")
 #else
+#include <dlfcn.h>
 #include <execinfo.h>
+#include <stdio.h>
 #endif
 
 char *clint_get_stack()
@@ -98,3 +104,96 @@ char *clint_get_stack()
   return buf;
 #endif
 }
+
+void clint_get_symbol(void *addr, char *buf, size_t size)
+{
+#if defined(WIN32)
+  SYMBOL_INFO *symbol;
+  HANDLE process;
+  DWORD64 offset = 0;
+
+  process = GetCurrentProcess();
+  SymInitialize(process, NULL, TRUE);
+  symbol = (SYMBOL_INFO*)calloc(sizeof(SYMBOL_INFO) + 256 * sizeof(char), 1);
+  symbol->MaxNameLen = 255;
+  symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+  if (SymFromAddr(process, (DWORD64)addr, &offset, symbol))
+    _snprintf_s(buf, size, _TRUNCATE, "%s+0x%X", symbol->Name, (unsigned int)offset);
+  else
+    _snprintf_s(buf, size, _TRUNCATE, "%p", addr);
+  free(symbol);
+#else
+  Dl_info info;
+
+  if (addr != NULL && dladdr(addr, &info) && info.dli_sname != NULL) {
+    snprintf(buf, size, "%s+0x%lx (%s)", info.dli_sname,
+             (unsigned long)((char*)addr - (char*)info.dli_saddr), info.dli_fname);
+  } else if (addr != NULL && dladdr(addr, &info) && info.dli_fname != NULL) {
+    snprintf(buf, size, "%s+0x%lx", info.dli_fname,
+             (unsigned long)((char*)addr - (char*)info.dli_fbase));
+  } else {
+    snprintf(buf, size, "%p", addr);
+  }
+#endif
+}
+
+void clint_get_function(void *addr, char *buf, size_t size)
+{
+#if defined(WIN32)
+  SYMBOL_INFO *symbol;
+  HANDLE process;
+
+  process = GetCurrentProcess();
+  SymInitialize(process, NULL, TRUE);
+  symbol = (SYMBOL_INFO*)calloc(sizeof(SYMBOL_INFO) + 256 * sizeof(char), 1);
+  symbol->MaxNameLen = 255;
+  symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+  if (SymFromAddr(process, (DWORD64)addr, NULL, symbol))
+    _snprintf_s(buf, size, _TRUNCATE, "%s", symbol->Name);
+  else
+    _snprintf_s(buf, size, _TRUNCATE, "%p", addr);
+  free(symbol);
+#else
+  Dl_info info;
+
+  if (addr != NULL && dladdr(addr, &info) && info.dli_sname != NULL) {
+    snprintf(buf, size, "%s", info.dli_sname);
+  } else if (addr != NULL && dladdr(addr, &info) && info.dli_fname != NULL) {
+    const char *module = strrchr(info.dli_fname, '/');
+    snprintf(buf, size, "%s+0x%lx", module ? module + 1 : info.dli_fname,
+             (unsigned long)((char*)addr - (char*)info.dli_fbase));
+  } else {
+    snprintf(buf, size, "%p", addr);
+  }
+#endif
+}
+
+int clint_get_frames(void **frames, int max)
+{
+#if defined(WIN32)
+  return CaptureStackBackTrace(0, max, frames, NULL);
+#else
+  return backtrace(frames, max);
+#endif
+}
+
+int clint_is_own_frame(void *addr)
+{
+#if defined(WIN32)
+  HMODULE self = NULL;
+  HMODULE module = NULL;
+
+  GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                     (LPCSTR)&clint_is_own_frame, &self);
+  GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                     (LPCSTR)addr, &module);
+  return module != NULL && module == self;
+#else
+  Dl_info self;
+  Dl_info info;
+
+  if (!dladdr((void*)&clint_is_own_frame, &self) || !dladdr(addr, &info))
+    return 0;
+  return info.dli_fbase == self.dli_fbase;
+#endif
+}
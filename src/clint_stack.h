@@ -29,11 +29,31 @@
 #ifndef _CLINT_STACK_H_
 #define _CLINT_STACK_H_
 
+#include <stddef.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_ReturnAddress)
+#define CLINT_RETURN_ADDRESS() _ReturnAddress()
+#elif defined(__GNUC__)
+#define CLINT_RETURN_ADDRESS() __builtin_return_address(0)
+#else
+#define CLINT_RETURN_ADDRESS() NULL
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 char *clint_get_stack();
+/* Describe a code address as symbol+offset (module). */
+void clint_get_symbol(void *addr, char *buf, size_t size);
+/* Just the function name, or module+offset without symbols. */
+void clint_get_function(void *addr, char *buf, size_t size);
+/* Return addresses of the calling thread, innermost first. */
+int clint_get_frames(void **frames, int max);
+/* Nonzero if addr is code in CLIntercept itself. */
+int clint_is_own_frame(void *addr);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,839 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_timeline.h"
+#include "clint_atomic.h"
+#include "clint_data.h"
+#include "clint_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Commands are analyzed in batches, so memory use doesn't grow with the run. */
+#define CLINT_TIMELINE_BATCH 4096
+/* Host calls not yet taken by the analysis.  They are taken when half full. */
+#define CLINT_TIMELINE_HOST 16384
+/* Host calls kept for commands that haven't completed yet.  Beyond this the
+   oldest are dropped, and idle time they would explain is reported as unknown. */
+#define CLINT_TIMELINE_KEEP (16 * CLINT_TIMELINE_HOST)
+#define CLINT_TIMELINE_GAPS 10
+/* Most queues tracked running at once on one device. */
+#define CLINT_TIMELINE_OVERLAP 16
+
+typedef struct ClintTimelineCommand {
+  const char *name;
+  cl_command_queue queue;
+  cl_device_id device;
+  ClintTransfer transfer;
+  /* Interned clintPushRangeCLINT path, or NULL. */
+  const char *range;
+  cl_ulong start;
+  cl_ulong end;
+} ClintTimelineCommand;
+
+typedef struct ClintTimelineSpan {
+  ClintFunc func;
+  cl_ulong begin;
+  cl_ulong end;
+} ClintTimelineSpan;
+
+typedef struct ClintTimelineBatch {
+  struct ClintTimelineBatch *next;
+  int count;
+  ClintTimelineCommand cmds[CLINT_TIMELINE_BATCH];
+} ClintTimelineBatch;
+
+/* What the host was doing while the device was idle. */
+typedef struct ClintTimelineHost {
+  cl_ulong func_ns[ClintFunc_max];
+  cl_ulong outside_ns;
+  /* Idle time whose host calls were dropped before they could be analyzed. */
+  cl_ulong unknown_ns;
+} ClintTimelineHost;
+
+typedef struct ClintTimelineGap {
+  cl_ulong start;
+  cl_ulong length;
+  /* The host call that covered most of the gap, or ClintFunc_max for none. */
+  ClintFunc func;
+  cl_ulong func_ns;
+  cl_ulong unknown_ns;
+} ClintTimelineGap;
+
+typedef struct ClintTimelineQueue {
+  CLINT_LIST_ELEMS(struct ClintTimelineQueue, cl_command_queue)
+  cl_device_id device;
+  cl_ulong first_ns;
+  cl_ulong last_end_ns;
+  cl_ulong busy_ns;
+  cl_ulong commands;
+} ClintTimelineQueue;
+
+typedef struct ClintTimelineDevice {
+  CLINT_LIST_ELEMS(struct ClintTimelineDevice, cl_device_id)
+  cl_ulong first_ns;
+  cl_ulong last_end_ns;
+  cl_ulong busy_ns;
+  cl_ulong gap_ns;
+  cl_ulong gaps;
+  ClintTimelineHost host;
+  ClintTimelineGap largest[CLINT_TIMELINE_GAPS];
+} ClintTimelineDevice;
+
+/* Wall time two queues on the same device both had commands running. */
+typedef struct ClintTimelinePair {
+  struct ClintTimelinePair *next;
+  cl_command_queue queues[2];
+  cl_ulong overlap_ns;
+  /* Overlap of compute with compute, compute with transfer, transfer with transfer. */
+  cl_ulong kind_ns[3];
+} ClintTimelinePair;
+
+/* Busy-time share: each instant some device was busy, split evenly between the
+   commands running then, by name.  Dependencies between commands aren't
+   recorded, so this says nothing about which of them the run waited on. */
+typedef struct ClintTimelineShare {
+  struct ClintTimelineShare *next;
+  const char *name;
+  cl_ulong ns;
+} ClintTimelineShare;
+
+/* Completed commands, filled from event callbacks.  Full batches wait for
+   an application thread to analyze them, outside the lock. */
+static ClintTimelineBatch *g_clint_timeline_current = NULL;
+static ClintTimelineBatch *g_clint_timeline_ready = NULL;
+static ClintTimelineBatch *g_clint_timeline_ready_tail = NULL;
+static ClintSpinLock g_clint_timeline_lock;
+
+static ClintTimelineSpan g_clint_timeline_host[CLINT_TIMELINE_HOST];
+static unsigned int g_clint_timeline_host_next = 0;
+static unsigned int g_clint_timeline_host_read = 0;
+/* End of the latest host call overwritten before it was taken. */
+static cl_ulong g_clint_timeline_host_lost = 0;
+static ClintSpinLock g_clint_timeline_host_lock;
+
+/* Set by the one thread analyzing; everything below is only touched by it. */
+static ClintAtomicInt g_clint_timeline_analyzing = 0;
+/* Host calls taken from the ring, sorted by begin. */
+static ClintTimelineSpan *g_clint_timeline_spans = NULL;
+static int g_clint_timeline_num_spans = 0;
+static int g_clint_timeline_max_spans = 0;
+/* Longest call kept, to bound the search for overlaps. */
+static cl_ulong g_clint_timeline_span_max = 0;
+/* Host calls ending before this may have been dropped. */
+static cl_ulong g_clint_timeline_lost_ns = 0;
+static ClintTimelineQueue *g_clint_timeline_queues = NULL;
+static ClintTimelineDevice *g_clint_timeline_devices = NULL;
+static ClintTimelineShare *g_clint_timeline_shares = NULL;
+static ClintTimelineShare *g_clint_timeline_range_shares = NULL;
+static ClintTimelinePair *g_clint_timeline_pairs = NULL;
+static ClintTimelineHost g_clint_timeline_idle_host;
+static cl_ulong g_clint_timeline_first_ns = 0;
+static cl_ulong g_clint_timeline_last_end_ns = 0;
+static cl_ulong g_clint_timeline_busy_ns = 0;
+
+static void clint_timeline_drain(int all);
+
+void clint_timeline_host(ClintFunc func, cl_ulong begin, cl_ulong end)
+{
+  ClintTimelineSpan *span;
+  unsigned int pending;
+
+  CLINT_SPINLOCK_LOCK(g_clint_timeline_host_lock);
+  if (g_clint_timeline_host_next - g_clint_timeline_host_read == CLINT_TIMELINE_HOST) {
+    /* The analysis fell behind; this call overwrites one it hasn't seen. */
+    span = &g_clint_timeline_host[g_clint_timeline_host_read++ % CLINT_TIMELINE_HOST];
+    if (span->end > g_clint_timeline_host_lost)
+      g_clint_timeline_host_lost = span->end;
+  }
+  span = &g_clint_timeline_host[g_clint_timeline_host_next++ % CLINT_TIMELINE_HOST];
+  span->func = func;
+  span->begin = begin;
+  span->end = end;
+  pending = g_clint_timeline_host_next - g_clint_timeline_host_read;
+  CLINT_SPINLOCK_UNLOCK(g_clint_timeline_host_lock);
+  if (pending >= CLINT_TIMELINE_HOST / 2 || g_clint_timeline_ready != NULL)
+    clint_timeline_drain(0);
+}
+
+static int clint_timeline_compare_commands(const void *a, const void *b)
+{
+  const ClintTimelineCommand *ca = (const ClintTimelineCommand*)a;
+  const ClintTimelineCommand *cb = (const ClintTimelineCommand*)b;
+
+  if (ca->start != cb->start)
+    return (ca->start < cb->start) ? -1 : 1;
+  return 0;
+}
+
+static int clint_timeline_compare_spans(const void *a, const void *b)
+{
+  const ClintTimelineSpan *sa = (const ClintTimelineSpan*)a;
+  const ClintTimelineSpan *sb = (const ClintTimelineSpan*)b;
+
+  if (sa->begin != sb->begin)
+    return (sa->begin < sb->begin) ? -1 : 1;
+  return 0;
+}
+
+/* Called while analyzing.  Moves the host calls out of the ring, keeping
+   them sorted by begin. */
+static void clint_timeline_take_spans(void)
+{
+  static int warned = 0;
+  unsigned int count, first, i;
+  cl_ulong lost;
+  int total, drop;
+
+  if (g_clint_timeline_spans == NULL) {
+    g_clint_timeline_spans = (ClintTimelineSpan*)malloc(sizeof(ClintTimelineSpan) * CLINT_TIMELINE_HOST);
+    if (g_clint_timeline_spans == NULL)
+      return;
+    g_clint_timeline_max_spans = CLINT_TIMELINE_HOST;
+  }
+  CLINT_SPINLOCK_LOCK(g_clint_timeline_host_lock);
+  first = g_clint_timeline_host_read;
+  count = g_clint_timeline_host_next - first;
+  total = g_clint_timeline_num_spans + (int)count;
+  if (total > g_clint_timeline_max_spans) {
+    /* Grow outside the lock, and take whatever has arrived by then. */
+    CLINT_SPINLOCK_UNLOCK(g_clint_timeline_host_lock);
+    total = g_clint_timeline_num_spans + CLINT_TIMELINE_HOST;
+    if (total > CLINT_TIMELINE_KEEP + CLINT_TIMELINE_HOST)
+      total = CLINT_TIMELINE_KEEP + CLINT_TIMELINE_HOST;
+    if (total > g_clint_timeline_max_spans) {
+      ClintTimelineSpan *spans = (ClintTimelineSpan*)realloc(g_clint_timeline_spans, sizeof(ClintTimelineSpan) * total);
+      if (spans == NULL)
+        return;
+      g_clint_timeline_spans = spans;
+      g_clint_timeline_max_spans = total;
+    }
+    CLINT_SPINLOCK_LOCK(g_clint_timeline_host_lock);
+    first = g_clint_timeline_host_read;
+    count = g_clint_timeline_host_next - first;
+  }
+  for (i = 0; i < count; i++)
+    g_clint_timeline_spans[g_clint_timeline_num_spans + i] = g_clint_timeline_host[(first + i) % CLINT_TIMELINE_HOST];
+  g_clint_timeline_host_read = first + count;
+  lost = g_clint_timeline_host_lost;
+  CLINT_SPINLOCK_UNLOCK(g_clint_timeline_host_lock);
+  g_clint_timeline_num_spans += (int)count;
+  qsort(g_clint_timeline_spans, g_clint_timeline_num_spans, sizeof(ClintTimelineSpan), clint_timeline_compare_spans);
+
+  /* Keep the most recent when commands haven't completed for a long time. */
+  drop = g_clint_timeline_num_spans - CLINT_TIMELINE_KEEP;
+  if (drop > 0) {
+    for (i = 0; i < (unsigned int)drop; i++) {
+      if (g_clint_timeline_spans[i].end > lost)
+        lost = g_clint_timeline_spans[i].end;
+    }
+    g_clint_timeline_num_spans -= drop;
+    memmove(g_clint_timeline_spans, g_clint_timeline_spans + drop, sizeof(ClintTimelineSpan) * g_clint_timeline_num_spans);
+  }
+  if (lost > g_clint_timeline_lost_ns) {
+    g_clint_timeline_lost_ns = lost;
+    if (!warned) {
+      clint_log("Timeline: host calls were dropped before they were analyzed; "
+                "device idle time they would explain is reported as unknown.\n");
+      warned = 1;
+    }
+  }
+  g_clint_timeline_span_max = 0;
+  for (i = 0; i < (unsigned int)g_clint_timeline_num_spans; i++) {
+    if (g_clint_timeline_spans[i].end - g_clint_timeline_spans[i].begin > g_clint_timeline_span_max)
+      g_clint_timeline_span_max = g_clint_timeline_spans[i].end - g_clint_timeline_spans[i].begin;
+  }
+}
+
+/* Called while analyzing.  Host calls ending before horizon can't explain
+   any idle gap still to come. */
+static void clint_timeline_prune_spans(cl_ulong horizon)
+{
+  int i, n = 0;
+
+  for (i = 0; i < g_clint_timeline_num_spans; i++) {
+    if (g_clint_timeline_spans[i].end >= horizon)
+      g_clint_timeline_spans[n++] = g_clint_timeline_spans[i];
+  }
+  g_clint_timeline_num_spans = n;
+}
+
+/* Attribute [start, end) to the host calls overlapping it.  Calls from
+   several threads can overlap; each instant is only counted once. */
+static void clint_timeline_attribute(ClintTimelineGap *gap, ClintTimelineHost *host,
+                                     const ClintTimelineSpan *spans, int num_spans)
+{
+  cl_ulong covered = gap->start;
+  cl_ulong end = gap->start + gap->length;
+  cl_ulong attributed = 0;
+  cl_ulong func_ns[ClintFunc_max];
+  cl_ulong earliest;
+  int lo = 0, hi = num_spans;
+  int i;
+
+  gap->func = ClintFunc_max;
+  gap->func_ns = 0;
+  gap->unknown_ns = 0;
+  memset(func_ns, 0, sizeof(func_ns));
+  if (g_clint_timeline_lost_ns > covered) {
+    /* Calls in this part of the gap may have been dropped. */
+    covered = (g_clint_timeline_lost_ns < end) ? g_clint_timeline_lost_ns : end;
+    gap->unknown_ns = covered - gap->start;
+    host->unknown_ns += gap->unknown_ns;
+    attributed += gap->unknown_ns;
+  }
+  /* No call beginning before this can reach the gap. */
+  earliest = (gap->start > g_clint_timeline_span_max) ? gap->start - g_clint_timeline_span_max : 0;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (spans[mid].begin < earliest)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  for (i = lo; i < num_spans && spans[i].begin < end; i++) {
+    cl_ulong b, e;
+    if (spans[i].end <= covered)
+      continue;
+    b = (spans[i].begin > covered) ? spans[i].begin : covered;
+    e = (spans[i].end < end) ? spans[i].end : end;
+    if (e <= b)
+      continue;
+    func_ns[spans[i].func] += e - b;
+    host->func_ns[spans[i].func] += e - b;
+    if (func_ns[spans[i].func] > gap->func_ns) {
+      gap->func = spans[i].func;
+      gap->func_ns = func_ns[spans[i].func];
+    }
+    attributed += e - b;
+    covered = e;
+  }
+  host->outside_ns += gap->length - attributed;
+}
+
+static void clint_timeline_largest(ClintTimelineDevice *device, const ClintTimelineGap *gap)
+{
+  int i = CLINT_TIMELINE_GAPS - 1;
+
+  if (gap->length <= device->largest[i].length)
+    return;
+  while (i > 0 && device->largest[i - 1].length < gap->length) {
+    device->largest[i] = device->largest[i - 1];
+    i--;
+  }
+  device->largest[i] = *gap;
+}
+
+static ClintTimelineDevice *clint_timeline_device(cl_device_id id)
+{
+  ClintTimelineDevice *device;
+
+  CLINT_LIST_FIND(device, g_clint_timeline_devices, id);
+  if (device == NULL) {
+    device = (ClintTimelineDevice*)calloc(1, sizeof(ClintTimelineDevice));
+    if (device != NULL) {
+      CLINT_LIST_INSERT(g_clint_timeline_devices, id, device);
+    }
+  }
+  return device;
+}
+
+static ClintTimelineQueue *clint_timeline_queue(cl_command_queue id, cl_device_id device)
+{
+  ClintTimelineQueue *queue;
+
+  CLINT_LIST_FIND(queue, g_clint_timeline_queues, id);
+  if (queue == NULL) {
+    queue = (ClintTimelineQueue*)calloc(1, sizeof(ClintTimelineQueue));
+    if (queue != NULL) {
+      queue->device = device;
+      CLINT_LIST_INSERT(g_clint_timeline_queues, id, queue);
+    }
+  }
+  return queue;
+}
+
+static void clint_timeline_share(ClintTimelineShare **list, const char *name, cl_ulong ns)
+{
+  ClintTimelineShare *share;
+
+  for (share = *list; share != NULL; share = share->next) {
+    if (share->name == name) {
+      share->ns += ns;
+      return;
+    }
+  }
+  share = (ClintTimelineShare*)calloc(1, sizeof(ClintTimelineShare));
+  if (share == NULL)
+    return;
+  share->name = name;
+  share->ns = ns;
+  CLINT_STACK_PUSH(*list, share);
+}
+
+/* Busy time of the union of the commands, with gaps measured from *last_end.
+   When device is set, gaps are attributed and remembered for it. */
+static cl_ulong clint_timeline_busy(const ClintTimelineCommand *cmds, int count,
+                                    cl_ulong *last_end, cl_ulong *gap_ns,
+                                    ClintTimelineDevice *device, ClintTimelineHost *host,
+                                    const ClintTimelineSpan *spans, int num_spans)
+{
+  cl_ulong busy = 0;
+  cl_ulong end = *last_end;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (end != 0 && cmds[i].start > end) {
+      ClintTimelineGap gap;
+      gap.start = end;
+      gap.length = cmds[i].start - end;
+      if (gap_ns != NULL)
+        *gap_ns += gap.length;
+      if (host != NULL)
+        clint_timeline_attribute(&gap, host, spans, num_spans);
+      if (device != NULL) {
+        device->gaps++;
+        clint_timeline_largest(device, &gap);
+      }
+    }
+    if (cmds[i].end > end) {
+      busy += cmds[i].end - ((cmds[i].start > end) ? cmds[i].start : end);
+      end = cmds[i].end;
+    }
+  }
+  *last_end = end;
+  return busy;
+}
+
+typedef void (*ClintTimelineVisit)(const ClintTimelineCommand *cmds, const int *active,
+                                   int num_active, cl_ulong ns, void *data);
+
+/* Visit each interval where the set of running commands doesn't change. */
+static void clint_timeline_sweep(const ClintTimelineCommand *cmds, int count,
+                                 ClintTimelineVisit visit, void *data)
+{
+  int *active = (int*)malloc(sizeof(int) * count);
+  int num_active = 0;
+  int next = 0;
+  cl_ulong now;
+  int i;
+
+  if (active == NULL || count == 0) {
+    free(active);
+    return;
+  }
+  now = cmds[0].start;
+  while (next < count || num_active > 0) {
+    /* The next time the active set changes. */
+    cl_ulong t = (next < count) ? cmds[next].start : (cl_ulong)-1;
+    for (i = 0; i < num_active; i++) {
+      if (cmds[active[i]].end < t)
+        t = cmds[active[i]].end;
+    }
+    if (num_active > 0 && t > now)
+      visit(cmds, active, num_active, t - now, data);
+    now = t;
+    for (i = 0; i < num_active; ) {
+      if (cmds[active[i]].end <= now)
+        active[i] = active[--num_active];
+      else
+        i++;
+    }
+    while (next < count && cmds[next].start <= now)
+      active[num_active++] = next++;
+  }
+  free(active);
+}
+
+/* Share each instant of device time between the commands running then. */
+static void clint_timeline_shares(const ClintTimelineCommand *cmds, const int *active,
+                                  int num_active, cl_ulong ns, void *data)
+{
+  cl_ulong share = ns / num_active;
+  int i;
+
+  (void)data;
+  for (i = 0; i < num_active; i++) {
+    clint_timeline_share(&g_clint_timeline_shares, cmds[active[i]].name, share);
+    if (cmds[active[i]].range != NULL)
+      clint_timeline_share(&g_clint_timeline_range_shares, cmds[active[i]].range, share);
+  }
+}
+
+static ClintTimelinePair *clint_timeline_pair(cl_command_queue a, cl_command_queue b)
+{
+  ClintTimelinePair *pair;
+
+  if (a > b) {
+    cl_command_queue t = a;
+    a = b;
+    b = t;
+  }
+  for (pair = g_clint_timeline_pairs; pair != NULL; pair = pair->next) {
+    if (pair->queues[0] == a && pair->queues[1] == b)
+      return pair;
+  }
+  pair = (ClintTimelinePair*)calloc(1, sizeof(ClintTimelinePair));
+  if (pair == NULL)
+    return NULL;
+  pair->queues[0] = a;
+  pair->queues[1] = b;
+  CLINT_STACK_PUSH(g_clint_timeline_pairs, pair);
+  return pair;
+}
+
+/* Time each pair of queues on a device had commands running at once. */
+static void clint_timeline_overlap(const ClintTimelineCommand *cmds, const int *active,
+                                   int num_active, cl_ulong ns, void *data)
+{
+  cl_command_queue queues[CLINT_TIMELINE_OVERLAP];
+  int transfer[CLINT_TIMELINE_OVERLAP];
+  int num_queues = 0;
+  int i, j;
+
+  (void)data;
+  /* An out of order queue can run several commands at once; count the queue once. */
+  for (i = 0; i < num_active; i++) {
+    const ClintTimelineCommand *cmd = &cmds[active[i]];
+    for (j = 0; j < num_queues && queues[j] != cmd->queue; j++)
+      ;
+    if (j == num_queues) {
+      if (num_queues == CLINT_TIMELINE_OVERLAP)
+        continue;
+      queues[num_queues] = cmd->queue;
+      transfer[num_queues++] = 0;
+    }
+    if (cmd->transfer != ClintTransfer_none)
+      transfer[j] = 1;
+  }
+  for (i = 0; i < num_queues; i++) {
+    for (j = i + 1; j < num_queues; j++) {
+      ClintTimelinePair *pair = clint_timeline_pair(queues[i], queues[j]);
+      if (pair == NULL)
+        continue;
+      pair->overlap_ns += ns;
+      pair->kind_ns[transfer[i] + transfer[j]] += ns;
+    }
+  }
+}
+
+/* Called while analyzing, without the lock. */
+static void clint_timeline_analyze(ClintTimelineCommand *cmds, int count)
+{
+  ClintTimelineCommand *subset;
+  ClintTimelineSpan *spans = g_clint_timeline_spans;
+  ClintTimelineDevice *device;
+  ClintTimelineQueue *queue;
+  int num_spans = g_clint_timeline_num_spans;
+  cl_ulong horizon;
+  int i, n;
+
+  if (count == 0)
+    return;
+  subset = (ClintTimelineCommand*)malloc(sizeof(ClintTimelineCommand) * count);
+  if (subset == NULL)
+    return;
+  qsort(cmds, count, sizeof(ClintTimelineCommand), clint_timeline_compare_commands);
+
+  for (i = 0; i < count; i++) {
+    clint_timeline_device(cmds[i].device);
+    clint_timeline_queue(cmds[i].queue, cmds[i].device);
+  }
+  for (device = g_clint_timeline_devices; device != NULL; device = device->next) {
+    for (i = 0, n = 0; i < count; i++) {
+      if (cmds[i].device == device->key)
+        subset[n++] = cmds[i];
+    }
+    if (n == 0)
+      continue;
+    if (device->first_ns == 0)
+      device->first_ns = subset[0].start;
+    device->busy_ns += clint_timeline_busy(subset, n, &device->last_end_ns, &device->gap_ns,
+                                           device, &device->host, spans, num_spans);
+    clint_timeline_sweep(subset, n, clint_timeline_overlap, NULL);
+  }
+  for (queue = g_clint_timeline_queues; queue != NULL; queue = queue->next) {
+    for (i = 0, n = 0; i < count; i++) {
+      if (cmds[i].queue == queue->key)
+        subset[n++] = cmds[i];
+    }
+    if (n == 0)
+      continue;
+    if (queue->first_ns == 0)
+      queue->first_ns = subset[0].start;
+    queue->commands += n;
+    queue->busy_ns += clint_timeline_busy(subset, n, &queue->last_end_ns, NULL,
+                                          NULL, NULL, spans, num_spans);
+  }
+
+  /* Across every device: gaps here are time every device was idle. */
+  if (g_clint_timeline_first_ns == 0)
+    g_clint_timeline_first_ns = cmds[0].start;
+  g_clint_timeline_busy_ns += clint_timeline_busy(cmds, count, &g_clint_timeline_last_end_ns, NULL,
+                                                  NULL, &g_clint_timeline_idle_host,
+                                                  spans, num_spans);
+  clint_timeline_sweep(cmds, count, clint_timeline_shares, NULL);
+  free(subset);
+
+  /* Every later gap starts after the last command of some device. */
+  horizon = g_clint_timeline_last_end_ns;
+  for (device = g_clint_timeline_devices; device != NULL; device = device->next) {
+    if (device->last_end_ns != 0 && device->last_end_ns < horizon)
+      horizon = device->last_end_ns;
+  }
+  clint_timeline_prune_spans(horizon);
+}
+
+/* Only one thread analyzes at a time.  Returns 0 if another one is, unless
+   wait is set. */
+static int clint_timeline_acquire(int wait)
+{
+  while (CLINT_ATOMIC_ADD(1, g_clint_timeline_analyzing) != 1) {
+    CLINT_ATOMIC_SUB(1, g_clint_timeline_analyzing);
+    if (!wait)
+      return 0;
+    while (g_clint_timeline_analyzing) {}
+  }
+  return 1;
+}
+
+static void clint_timeline_release(void)
+{
+  CLINT_ATOMIC_SUB(1, g_clint_timeline_analyzing);
+}
+
+/* Called while analyzing.  Analyzes the full batches, and the partial one if all is set. */
+static void clint_timeline_analyze_ready(int all)
+{
+  ClintTimelineBatch *ready, *batch;
+
+  clint_timeline_take_spans();
+  CLINT_SPINLOCK_LOCK(g_clint_timeline_lock);
+  ready = g_clint_timeline_ready;
+  if (all && g_clint_timeline_current != NULL) {
+    if (g_clint_timeline_ready_tail != NULL)
+      g_clint_timeline_ready_tail->next = g_clint_timeline_current;
+    else
+      ready = g_clint_timeline_current;
+    g_clint_timeline_current = NULL;
+  }
+  g_clint_timeline_ready = NULL;
+  g_clint_timeline_ready_tail = NULL;
+  CLINT_SPINLOCK_UNLOCK(g_clint_timeline_lock);
+  while (ready != NULL) {
+    batch = ready;
+    ready = ready->next;
+    clint_timeline_analyze(batch->cmds, batch->count);
+    free(batch);
+  }
+}
+
+/* From an application thread, never from a driver callback. */
+static void clint_timeline_drain(int all)
+{
+  if (!clint_timeline_acquire(0))
+    return;
+  clint_timeline_analyze_ready(all);
+  clint_timeline_release();
+}
+
+void clint_timeline_command(const ClintProfileCommand *cmd)
+{
+  ClintTimelineBatch *fresh = NULL;
+  ClintTimelineCommand *c;
+
+  if (cmd->device == NULL || cmd->host_start == 0 || cmd->host_end < cmd->host_start)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_timeline_lock);
+  while (g_clint_timeline_current == NULL) {
+    if (fresh != NULL) {
+      fresh->next = NULL;
+      fresh->count = 0;
+      g_clint_timeline_current = fresh;
+      fresh = NULL;
+      break;
+    }
+    /* Allocate outside the lock. */
+    CLINT_SPINLOCK_UNLOCK(g_clint_timeline_lock);
+    fresh = (ClintTimelineBatch*)malloc(sizeof(ClintTimelineBatch));
+    if (fresh == NULL)
+      return;
+    CLINT_SPINLOCK_LOCK(g_clint_timeline_lock);
+  }
+  c = &g_clint_timeline_current->cmds[g_clint_timeline_current->count++];
+  c->name = (cmd->kernel != NULL) ? cmd->kernel->name : cmd->name;
+  c->queue = cmd->queue;
+  c->device = cmd->device;
+  c->transfer = cmd->transfer;
+  c->range = (cmd->range != NULL) ? cmd->range->name : NULL;
+  c->start = cmd->host_start;
+  c->end = cmd->host_end;
+  if (g_clint_timeline_current->count == CLINT_TIMELINE_BATCH) {
+    /* The next application call analyzes it. */
+    if (g_clint_timeline_ready_tail != NULL)
+      g_clint_timeline_ready_tail->next = g_clint_timeline_current;
+    else
+      g_clint_timeline_ready = g_clint_timeline_current;
+    g_clint_timeline_ready_tail = g_clint_timeline_current;
+    g_clint_timeline_current = NULL;
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_timeline_lock);
+  free(fresh);
+}
+
+static void clint_timeline_report_host(const ClintTimelineHost *host, cl_ulong total)
+{
+  int i;
+
+  if (total == 0)
+    return;
+  for (i = 0; i < ClintFunc_max; i++) {
+    /* Skip anything under 0.1% */
+    if (host->func_ns[i] * 1000 < total)
+      continue;
+    clint_log("\t\tin %s: %f s (%.1f%%)\n", clint_func_name((ClintFunc)i),
+              (double)host->func_ns[i] * 1.0e-9, 100.0 * (double)host->func_ns[i] / (double)total);
+  }
+  clint_log("\t\toutside OpenCL: %f s (%.1f%%)\n",
+            (double)host->outside_ns * 1.0e-9, 100.0 * (double)host->outside_ns / (double)total);
+  if (host->unknown_ns > 0)
+    clint_log("\t\tunknown, host calls dropped: %f s (%.1f%%)\n",
+              (double)host->unknown_ns * 1.0e-9, 100.0 * (double)host->unknown_ns / (double)total);
+}
+
+static void clint_timeline_report_pairs(cl_device_id device)
+{
+  static const char *kinds[3] = { "compute/compute", "compute/transfer", "transfer/transfer" };
+  ClintTimelinePair *pair;
+  ClintTimelineQueue *a, *b;
+  int k;
+
+  for (pair = g_clint_timeline_pairs; pair != NULL; pair = pair->next) {
+    cl_ulong either;
+    CLINT_LIST_FIND(a, g_clint_timeline_queues, pair->queues[0]);
+    CLINT_LIST_FIND(b, g_clint_timeline_queues, pair->queues[1]);
+    if (a == NULL || b == NULL || a->device != device)
+      continue;
+    either = a->busy_ns + b->busy_ns - pair->overlap_ns;
+    if (either == 0)
+      continue;
+    clint_log("\tqueues %p and %p: overlapped %f s, serialized %f s (%.1f%% overlapped)\n",
+              a->key, b->key, (double)pair->overlap_ns * 1.0e-9,
+              (double)(either - pair->overlap_ns) * 1.0e-9,
+              100.0 * (double)pair->overlap_ns / (double)either);
+    for (k = 0; k < 3; k++) {
+      if (pair->kind_ns[k] == 0)
+        continue;
+      clint_log("\t\t%s: %f s\n", kinds[k], (double)pair->kind_ns[k] * 1.0e-9);
+    }
+  }
+}
+
+void clint_timeline_report(void)
+{
+  ClintTimelineDevice *device;
+  ClintTimelineQueue *queue;
+  ClintTimelineShare *share;
+  cl_ulong span;
+  int i;
+
+  clint_timeline_acquire(1);
+  clint_timeline_analyze_ready(1);
+  if (g_clint_timeline_last_end_ns <= g_clint_timeline_first_ns) {
+    clint_timeline_release();
+    return;
+  }
+
+  clint_log("Device timeline:\n");
+  for (device = g_clint_timeline_devices; device != NULL; device = device->next) {
+    cl_ulong queue_busy = 0;
+    span = device->last_end_ns - device->first_ns;
+    if (span == 0)
+      continue;
+    clint_log("device %p: busy %f s of %f s (%.1f%%), %lu idle gaps totaling %f s\n",
+              device->key, (double)device->busy_ns * 1.0e-9, (double)span * 1.0e-9,
+              100.0 * (double)device->busy_ns / (double)span,
+              (unsigned long)device->gaps, (double)device->gap_ns * 1.0e-9);
+    for (queue = g_clint_timeline_queues; queue != NULL; queue = queue->next) {
+      cl_ulong queue_span = queue->last_end_ns - queue->first_ns;
+      if (queue->device != device->key || queue_span == 0)
+        continue;
+      clint_log("\tqueue %p: %lu commands, busy %f s (%.1f%%)\n",
+                queue->key, (unsigned long)queue->commands, (double)queue->busy_ns * 1.0e-9,
+                100.0 * (double)queue->busy_ns / (double)queue_span);
+      queue_busy += queue->busy_ns;
+    }
+    if (device->busy_ns > 0)
+      clint_log("\tconcurrency factor %.2f\n", (double)queue_busy / (double)device->busy_ns);
+    clint_timeline_report_pairs(device->key);
+    if (device->gap_ns > 0) {
+      clint_log("\twhile idle the host was:\n");
+      clint_timeline_report_host(&device->host, device->gap_ns);
+      clint_log("\tlargest gaps:\n");
+      for (i = 0; i < CLINT_TIMELINE_GAPS && device->largest[i].length > 0; i++) {
+        const ClintTimelineGap *gap = &device->largest[i];
+        if (gap->unknown_ns * 2 > gap->length) {
+          clint_log("\t\t%f s at %f s, host calls dropped\n",
+                    (double)gap->length * 1.0e-9, (double)(gap->start - device->first_ns) * 1.0e-9);
+        } else if (gap->func != ClintFunc_max) {
+          clint_log("\t\t%f s at %f s, mostly in %s (%.1f%%)\n",
+                    (double)gap->length * 1.0e-9, (double)(gap->start - device->first_ns) * 1.0e-9,
+                    clint_func_name(gap->func), 100.0 * (double)gap->func_ns / (double)gap->length);
+        } else {
+          clint_log("\t\t%f s at %f s, outside OpenCL\n",
+                    (double)gap->length * 1.0e-9, (double)(gap->start - device->first_ns) * 1.0e-9);
+        }
+      }
+    }
+  }
+
+  span = g_clint_timeline_last_end_ns - g_clint_timeline_first_ns;
+  clint_log("All devices: %f s, some device busy %f s (%.1f%%), all idle %f s (%.1f%%)\n",
+            (double)span * 1.0e-9,
+            (double)g_clint_timeline_busy_ns * 1.0e-9, 100.0 * (double)g_clint_timeline_busy_ns / (double)span,
+            (double)(span - g_clint_timeline_busy_ns) * 1.0e-9,
+            100.0 * (double)(span - g_clint_timeline_busy_ns) / (double)span);
+  clint_log("\tbusy-time share by command (not a critical path):\n");
+  for (share = g_clint_timeline_shares; share != NULL; share = share->next) {
+    if (share->ns * 1000 < span)
+      continue;
+    clint_log("\t\t%s: %f s (%.1f%%)\n", share->name,
+              (double)share->ns * 1.0e-9, 100.0 * (double)share->ns / (double)span);
+  }
+  if (g_clint_timeline_range_shares != NULL)
+    clint_log("\tbusy-time share by range:\n");
+  for (share = g_clint_timeline_range_shares; share != NULL; share = share->next) {
+    if (share->ns * 1000 < span)
+      continue;
+    clint_log("\t\t%s: %f s (%.1f%%)\n", share->name,
+              (double)share->ns * 1.0e-9, 100.0 * (double)share->ns / (double)span);
+  }
+  clint_log("\twhile all devices were idle the host was:\n");
+  clint_timeline_report_host(&g_clint_timeline_idle_host, span - g_clint_timeline_busy_ns);
+  clint_timeline_release();
+}
@@ -0,0 +1,457 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_trace.h"
+#include "clint_atomic.h"
+#include "clint_config.h"
+#include "clint_data.h"
+#include "clint_filter.h"
+#include "clint_log.h"
+#include "clint_opencl_funcs.h"
+#include "clint_thread.h"
+#include "clint_time.h"
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CLINT_TRACE_BUFFER (64 * 1024)
+
+/* CLINT_FLIGHT_RECORDER keeps each thread's last records in fixed size slots,
+   so recording is only the encoder's stores; nothing is decoded until a dump.
+   Larger records aren't kept. */
+#define CLINT_FLIGHT_SLOT 256
+#define CLINT_FLIGHT_CALLS 128
+
+typedef struct ClintTraceThread {
+  struct ClintTraceThread *next;
+  ClintSpinLock lock;
+  cl_uint thread;
+  /* The record between clint_trace_begin() and clint_trace_end(), or NULL. */
+  unsigned char *pending;
+  /* CLINT_TRACE_BINARY: records only written to the file when the buffer is
+     full and at shutdown.  Buffers outlive their threads. */
+  unsigned char *buffer;
+  size_t used;
+  /* CLINT_FLIGHT_RECORDER: records ever recorded, and up to which they were dumped. */
+  unsigned char *slots;
+  volatile cl_uint recorded;
+  cl_uint dumped;
+} ClintTraceThread;
+
+static FILE *g_clint_trace_fp = NULL;
+static ClintSpinLock g_clint_trace_lock;
+static ClintTraceThread *g_clint_trace_threads = NULL;
+static cl_uint g_clint_trace_num_threads = 0;
+static cl_uint g_clint_flight_slots = 0;
+static int g_clint_trace_init = 0;
+static ClintTLS g_clint_trace_key;
+
+#define CLINT_FLIGHT_RECORD(t, i) ((t)->slots + ((i) % g_clint_flight_slots) * CLINT_FLIGHT_SLOT)
+
+/* Crash signals that dump the flight recorder, and the application's handlers for them. */
+#if defined(WIN32)
+static const int g_clint_trace_signals[] = { SIGSEGV, SIGILL, SIGFPE, SIGABRT };
+static void (*g_clint_trace_oldact[4])(int);
+static void clint_trace_signal(int sig);
+#else
+static const int g_clint_trace_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+static struct sigaction g_clint_trace_oldact[5];
+static void clint_trace_signal(int sig, siginfo_t *info, void *context);
+#endif
+#define CLINT_TRACE_SIGNALS (sizeof(g_clint_trace_signals) / sizeof(g_clint_trace_signals[0]))
+
+static void clint_trace_open(const char *path)
+{
+  ClintTraceHeader header;
+
+#if defined(WIN32)
+  if (fopen_s(&g_clint_trace_fp, path, "wb") != 0)
+    g_clint_trace_fp = NULL;
+#else
+  g_clint_trace_fp = fopen(path, "wb");
+#endif
+  if (g_clint_trace_fp == NULL) {
+    clint_log("Trace: can't write %s\n", path);
+    return;
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CLINT_TRACE_MAGIC, sizeof(header.magic));
+  header.version = CLINT_TRACE_VERSION;
+  header.funcs = ClintFunc_max;
+  header.pointer_size = sizeof(void*);
+  fwrite(&header, sizeof(header), 1, g_clint_trace_fp);
+}
+
+static void clint_trace_abort(void)
+{
+  clint_trace_dump("error");
+}
+
+void clint_trace_init(void)
+{
+  const char *path = clint_get_config_string(CLINT_TRACE_BINARY);
+  int calls = clint_get_config(CLINT_FLIGHT_RECORDER);
+
+  if (g_clint_trace_init)
+    return;
+  g_clint_trace_init = 1;
+  clint_tls_create(&g_clint_trace_key);
+  if (path != NULL)
+    clint_trace_open(path);
+  if (calls > 0) {
+    /* A call and its return are two records. */
+    g_clint_flight_slots = 2 * (calls > 1 ? calls : CLINT_FLIGHT_CALLS);
+    clint_log_abort_handler(clint_trace_abort);
+#if defined(WIN32)
+    {
+      size_t i;
+      for (i = 0; i < CLINT_TRACE_SIGNALS; i++)
+        g_clint_trace_oldact[i] = signal(g_clint_trace_signals[i], clint_trace_signal);
+    }
+#else
+    {
+      struct sigaction sa;
+      size_t i;
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_sigaction = clint_trace_signal;
+      sa.sa_flags = SA_SIGINFO | SA_RESETHAND;
+      sigemptyset(&sa.sa_mask);
+      for (i = 0; i < CLINT_TRACE_SIGNALS; i++) {
+        if (sigaction(g_clint_trace_signals[i], &sa, &g_clint_trace_oldact[i]) != 0)
+          g_clint_trace_oldact[i].sa_handler = SIG_DFL;
+      }
+    }
+#endif
+  }
+}
+
+/* Called with the thread locked. */
+static void clint_trace_flush(ClintTraceThread *thread)
+{
+  CLINT_SPINLOCK_LOCK(g_clint_trace_lock);
+  if (g_clint_trace_fp != NULL && thread->used != 0)
+    fwrite(thread->buffer, 1, thread->used, g_clint_trace_fp);
+  CLINT_SPINLOCK_UNLOCK(g_clint_trace_lock);
+  thread->used = 0;
+}
+
+static ClintTraceThread *clint_trace_thread(void)
+{
+  ClintTraceThread *thread = (ClintTraceThread*)clint_tls_get(&g_clint_trace_key);
+
+  if (thread == NULL) {
+    thread = (ClintTraceThread*)calloc(1, sizeof(ClintTraceThread));
+    if (thread == NULL)
+      return NULL;
+    if (g_clint_trace_fp != NULL)
+      thread->buffer = (unsigned char*)malloc(CLINT_TRACE_BUFFER);
+    if (g_clint_flight_slots != 0)
+      thread->slots = (unsigned char*)calloc(g_clint_flight_slots, CLINT_FLIGHT_SLOT);
+    CLINT_SPINLOCK_LOCK(g_clint_trace_lock);
+    thread->thread = g_clint_trace_num_threads++;
+    CLINT_STACK_PUSH(g_clint_trace_threads, thread);
+    CLINT_SPINLOCK_UNLOCK(g_clint_trace_lock);
+    clint_tls_set(&g_clint_trace_key, thread);
+  }
+  return thread;
+}
+
+unsigned char *clint_trace_begin(int func, ClintTraceKind kind, size_t size)
+{
+  ClintTraceThread *thread;
+  ClintTraceRecord record;
+  unsigned char *p = NULL;
+
+  if (!g_clint_trace_init || (thread = clint_trace_thread()) == NULL)
+    return NULL;
+  size += sizeof(record);
+  memset(&record, 0, sizeof(record));
+  record.func = (cl_ushort)func;
+  record.kind = (cl_uchar)kind;
+  record.thread = thread->thread;
+  record.time = clint_time_now();
+
+  if (thread->buffer != NULL && g_clint_trace_fp != NULL && CLINT_FILTER_LIVE(func, CLINT_FILTER_BINARY)) {
+    if (size > CLINT_TRACE_MAX_RECORD)
+      return NULL;
+    CLINT_SPINLOCK_LOCK(thread->lock);
+    if (thread->used + size > CLINT_TRACE_BUFFER)
+      clint_trace_flush(thread);
+    p = thread->buffer + thread->used;
+    memcpy(p, &record, sizeof(record));
+    thread->pending = p;
+    CLINT_SPINLOCK_UNLOCK(thread->lock);
+  } else if (thread->slots != NULL) {
+    if (size > CLINT_FLIGHT_SLOT)
+      return NULL;
+    p = CLINT_FLIGHT_RECORD(thread, thread->recorded);
+    memcpy(p, &record, sizeof(record));
+    thread->pending = p;
+  } else {
+    return NULL;
+  }
+  return p + sizeof(record);
+}
+
+void clint_trace_end(unsigned char *end)
+{
+  ClintTraceThread *thread = (ClintTraceThread*)clint_tls_get(&g_clint_trace_key);
+  unsigned char *p;
+  cl_uint size;
+
+  if (thread == NULL || (p = thread->pending) == NULL)
+    return;
+  size = (cl_uint)(end - p);
+  memcpy(p + offsetof(ClintTraceRecord, size), &size, sizeof(size));
+  if (thread->buffer != NULL && p >= thread->buffer && p < thread->buffer + CLINT_TRACE_BUFFER) {
+    CLINT_SPINLOCK_LOCK(thread->lock);
+    /* The record is dropped if the trace was shut down meanwhile. */
+    if (thread->pending == p)
+      thread->used = (p - thread->buffer) + size;
+    thread->pending = NULL;
+    CLINT_SPINLOCK_UNLOCK(thread->lock);
+    if (thread->slots == NULL || size > CLINT_FLIGHT_SLOT)
+      return;
+    memcpy(CLINT_FLIGHT_RECORD(thread, thread->recorded), p, size);
+  }
+  thread->pending = NULL;
+  CLINT_MEMORY_BARRIER();
+  thread->recorded++;
+}
+
+unsigned char *clint_trace_put_string(unsigned char *p, const char *s)
+{
+  size_t len;
+
+  if (s == NULL) {
+    *p++ = CLINT_TRACE_NULL_STRING;
+    return p;
+  }
+  len = strlen(s);
+  if (len > CLINT_TRACE_MAX_STRING)
+    len = CLINT_TRACE_MAX_STRING;
+  *p++ = (unsigned char)len;
+  memcpy(p, s, len);
+  return p + len;
+}
+
+unsigned char *clint_trace_put_bytes(unsigned char *p, const void *v, size_t size)
+{
+  *p++ = (v != NULL);
+  if (v == NULL)
+    return p;
+  memcpy(p, v, size);
+  return p + size;
+}
+
+/* Records of other threads may be overwritten while we decode them, so each
+   is copied to a zero padded buffer first and decoded as well as it can be. */
+void clint_trace_dump(const char *reason)
+{
+  unsigned char args[CLINT_FLIGHT_SLOT];
+  ClintTraceRecord record;
+  ClintTraceThread *thread;
+  ClintAutopool pool;
+  const char *text;
+  cl_ulong now = clint_time_now();
+  cl_uint recorded;
+  cl_uint i;
+
+  if (g_clint_flight_slots == 0)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_trace_lock);
+  thread = g_clint_trace_threads;
+  CLINT_SPINLOCK_UNLOCK(g_clint_trace_lock);
+  for (; thread != NULL; thread = thread->next) {
+    recorded = thread->recorded;
+    CLINT_MEMORY_BARRIER();
+    i = thread->dumped;
+    if (recorded - i > g_clint_flight_slots)
+      i = recorded - g_clint_flight_slots;
+    if (i == recorded)
+      continue;
+    clint_log("Flight recorder (%s): thread %u, last %u records\n", reason, thread->thread, recorded - i);
+    for (; i != recorded; i++) {
+      memcpy(&record, CLINT_FLIGHT_RECORD(thread, i), sizeof(record));
+      if (record.size < sizeof(record) || record.size > CLINT_FLIGHT_SLOT)
+        continue;
+      memset(args, 0, sizeof(args));
+      memcpy(args, CLINT_FLIGHT_RECORD(thread, i) + sizeof(record), record.size - sizeof(record));
+      clint_autopool_begin(&pool);
+      text = clint_decode_record(record.func, (ClintTraceKind)record.kind, args);
+      if (text != NULL)
+        clint_log("  -%.3f ms %s", (double)(cl_long)(now - record.time) * 1.0e-6, text);
+      clint_autopool_end(&pool);
+    }
+    /* Only report once, even if we're dumped again. */
+    thread->dumped = recorded;
+  }
+}
+
+/* Append s, or as much of it as fits. */
+static size_t clint_trace_put_text(char *buf, size_t used, size_t size, const char *s)
+{
+  while (*s && used < size)
+    buf[used++] = *s++;
+  return used;
+}
+
+/* Append v in decimal, zero padded to at least digits. */
+static size_t clint_trace_put_uint(char *buf, size_t used, size_t size, cl_ulong v, int digits)
+{
+  char tmp[24];
+  int n = 0;
+
+  do {
+    tmp[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v > 0 || n < digits);
+  while (n > 0 && used < size)
+    buf[used++] = tmp[--n];
+  return used;
+}
+
+/* The signal may have interrupted a thread holding any of our locks, or inside
+   malloc or stdio, so only try locks, and format into a static buffer.  Without
+   the decoder, which allocates, only the functions and their times are logged. */
+static void clint_trace_dump_signal(int sig)
+{
+  static char line[256];
+  ClintTraceRecord record;
+  ClintTraceThread *thread;
+  const char *name;
+  cl_ulong now = clint_time_now();
+  cl_ulong us;
+  cl_uint recorded;
+  cl_uint i;
+  size_t used;
+
+  if (g_clint_flight_slots == 0 || !CLINT_SPINLOCK_TRYLOCK(g_clint_trace_lock))
+    return;
+  thread = g_clint_trace_threads;
+  CLINT_SPINLOCK_UNLOCK(g_clint_trace_lock);
+  if (!clint_log_signal_begin())
+    return;
+  for (; thread != NULL; thread = thread->next) {
+    recorded = thread->recorded;
+    CLINT_MEMORY_BARRIER();
+    i = thread->dumped;
+    if (recorded - i > g_clint_flight_slots)
+      i = recorded - g_clint_flight_slots;
+    if (i == recorded)
+      continue;
+    used = clint_trace_put_text(line, 0, sizeof(line), "Flight recorder (signal ");
+    used = clint_trace_put_uint(line, used, sizeof(line), (cl_ulong)sig, 1);
+    used = clint_trace_put_text(line, used, sizeof(line), "): thread ");
+    used = clint_trace_put_uint(line, used, sizeof(line), thread->thread, 1);
+    used = clint_trace_put_text(line, used, sizeof(line), ", last ");
+    used = clint_trace_put_uint(line, used, sizeof(line), recorded - i, 1);
+    used = clint_trace_put_text(line, used, sizeof(line), " records\n");
+    clint_log_signal_write(line, used);
+    for (; i != recorded; i++) {
+      memcpy(&record, CLINT_FLIGHT_RECORD(thread, i), sizeof(record));
+      name = clint_func_name((ClintFunc)record.func);
+      if (record.size < sizeof(record) || record.size > CLINT_FLIGHT_SLOT || name == NULL)
+        continue;
+      us = (now > record.time) ? (now - record.time) / 1000 : 0;
+      used = clint_trace_put_text(line, 0, sizeof(line), "  -");
+      used = clint_trace_put_uint(line, used, sizeof(line), us / 1000, 1);
+      used = clint_trace_put_text(line, used, sizeof(line), ".");
+      used = clint_trace_put_uint(line, used, sizeof(line), us % 1000, 3);
+      used = clint_trace_put_text(line, used, sizeof(line), " ms ");
+      used = clint_trace_put_text(line, used, sizeof(line), name);
+      used = clint_trace_put_text(line, used, sizeof(line),
+                                  (record.kind == ClintTrace_call) ? " called\n" : " returned\n");
+      clint_log_signal_write(line, used);
+    }
+    thread->dumped = recorded;
+  }
+  clint_log_signal_end();
+}
+
+/* Afterwards the application's own handler, or the default action, gets the signal. */
+#if defined(WIN32)
+static void clint_trace_signal(int sig)
+{
+  size_t i;
+
+  clint_trace_dump_signal(sig);
+  for (i = 0; i < CLINT_TRACE_SIGNALS && g_clint_trace_signals[i] != sig; i++)
+    ;
+  signal(sig, (i < CLINT_TRACE_SIGNALS && g_clint_trace_oldact[i] != SIG_ERR) ?
+         g_clint_trace_oldact[i] : SIG_DFL);
+  raise(sig);
+}
+#else
+static void clint_trace_signal(int sig, siginfo_t *info, void *context)
+{
+  size_t i;
+
+  (void)context;
+  clint_trace_dump_signal(sig);
+  for (i = 0; i < CLINT_TRACE_SIGNALS && g_clint_trace_signals[i] != sig; i++)
+    ;
+  if (i < CLINT_TRACE_SIGNALS)
+    sigaction(sig, &g_clint_trace_oldact[i], NULL);
+  /* A fault happens again when we return, with its siginfo intact for the
+     application's handler.  Sent signals have to be sent again. */
+  if (info == NULL || info->si_code <= 0)
+    raise(sig);
+}
+#endif
+
+void clint_trace_shutdown(void)
+{
+  ClintTraceThread *thread;
+  FILE *fp;
+
+  if (g_clint_trace_fp == NULL)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_trace_lock);
+  thread = g_clint_trace_threads;
+  CLINT_SPINLOCK_UNLOCK(g_clint_trace_lock);
+  for (; thread != NULL; thread = thread->next) {
+    CLINT_SPINLOCK_LOCK(thread->lock);
+    clint_trace_flush(thread);
+    if (thread->buffer != NULL && thread->pending != NULL && thread->pending >= thread->buffer &&
+        thread->pending < thread->buffer + CLINT_TRACE_BUFFER)
+      thread->pending = NULL;
+    CLINT_SPINLOCK_UNLOCK(thread->lock);
+  }
+
+  CLINT_SPINLOCK_LOCK(g_clint_trace_lock);
+  fp = g_clint_trace_fp;
+  g_clint_trace_fp = NULL;
+  CLINT_SPINLOCK_UNLOCK(g_clint_trace_lock);
+  /* Threads are kept, they may still be in clint_trace_end(). */
+  fclose(fp);
+  clint_log("Trace: %u threads written to %s\n", g_clint_trace_num_threads,
+            clint_get_config_string(CLINT_TRACE_BINARY));
+}
@@ -0,0 +1,112 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_TRACE_H_
+#define _CLINT_TRACE_H_
+
+#ifdef __APPLE__
+#include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CLINT_TRACE_BINARY file layout, in host byte order: a ClintTraceHeader, then
+   records of a ClintTraceRecord followed by the arguments the generated encoder
+   wrote for that function. Records of each thread are in order; records of
+   different threads are interleaved in chunks. */
+#define CLINT_TRACE_MAGIC "CLINTBIN"
+#define CLINT_TRACE_VERSION 1
+
+typedef struct ClintTraceHeader {
+  char magic[8];
+  cl_uint version;
+  /* ClintFunc_max of the writer; function ids are only valid for a decoder
+     generated from the same OpenCL headers. */
+  cl_uint funcs;
+  cl_uint pointer_size;
+  cl_uint reserved;
+} ClintTraceHeader;
+
+typedef enum ClintTraceKind {
+  ClintTrace_call,
+  ClintTrace_return
+} ClintTraceKind;
+
+typedef struct ClintTraceRecord {
+  cl_ushort func;
+  cl_uchar kind;
+  cl_uchar reserved;
+  /* Including this header. */
+  cl_uint size;
+  /* Numbered in the order threads first made a call. */
+  cl_uint thread;
+  cl_uint reserved2;
+  cl_ulong time;
+} ClintTraceRecord;
+
+/* Records never exceed this, so decoders can read them into a fixed buffer. */
+#define CLINT_TRACE_MAX_RECORD 4096
+
+/* Strings are a length byte and at most this many characters, enough for
+   clint_string_shorten() to render them as the text trace does. */
+#define CLINT_TRACE_MAX_STRING 32
+#define CLINT_TRACE_NULL_STRING 0xff
+
+void clint_trace_init(void);
+void clint_trace_shutdown(void);
+/* Log the CLINT_FLIGHT_RECORDER records of all threads not dumped yet. */
+void clint_trace_dump(const char *reason);
+
+/* Reserve size bytes of arguments for a record in the calling thread's buffer
+   or flight recorder.  Returns where to put them, or NULL if not recording. */
+unsigned char *clint_trace_begin(int func, ClintTraceKind kind, size_t size);
+void clint_trace_end(unsigned char *end);
+
+unsigned char *clint_trace_put_string(unsigned char *p, const char *s);
+/* A presence byte, followed by size bytes at v unless v is NULL. */
+unsigned char *clint_trace_put_bytes(unsigned char *p, const void *v, size_t size);
+
+#define CLINT_TRACE_PUT(p, type, v) { type clint_trace_v = (type)(v); memcpy((p), &clint_trace_v, sizeof(type)); (p) += sizeof(type); }
+#define CLINT_TRACE_PUT_POINTER(p, v) CLINT_TRACE_PUT(p, cl_ulong, (size_t)(v))
+#define CLINT_TRACE_GET(p, type, v) { memcpy(&(v), (p), sizeof(type)); (p) += sizeof(type); }
+
+/* The text trace of a record's arguments, or NULL for an unknown function.
+   Generated into clint_opencl_decode.c, for clintdecode. */
+const char *clint_decode_record(int func, ClintTraceKind kind, const unsigned char *args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_TRACE_H_
@@ -0,0 +1,384 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_wait.h"
+#include "clint.h"
+#include "clint_atomic.h"
+#include "clint_data.h"
+#include "clint_kernels.h"
+#include "clint_log.h"
+#include "clint_opencl_types.h"
+#include "clint_stack.h"
+#include "clint_thread.h"
+#include "clint_time.h"
+#include "clint_tree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CLINT_WAIT_BUCKETS 64
+/* Per site, only the commands waited on most often are worth listing. */
+#define CLINT_WAIT_TARGETS 5
+/* Events whose command types are queried at a time, before taking the lock. */
+#define CLINT_WAIT_EVENTS 32
+
+typedef cl_int (CL_API_CALL *ClintGetEventInfoFn)(cl_event, cl_event_info, size_t, void *, size_t *);
+
+/* A command waited on: an enqueue function or kernel name, or an event's command type. */
+typedef struct ClintWaitTarget {
+  struct ClintWaitTarget *next;
+  const char *name;
+  cl_command_type type;
+  cl_ulong count;
+} ClintWaitTarget;
+
+typedef struct ClintWaitSite {
+  struct ClintWaitSite *next;
+  ClintFunc func;
+  void *site;
+  cl_ulong waits;
+  cl_ulong ns;
+  cl_ulong max_ns;
+  ClintWaitTarget *targets;
+} ClintWaitSite;
+
+/* Each thread only updates its own shard, with its lock held so a report can
+   read and reset the counts at any time.  New sites and targets are linked
+   under the global lock so the report can walk them. */
+typedef struct ClintWaitShard {
+  struct ClintWaitShard *next;
+  ClintSpinLock lock;
+  int thread;
+  cl_ulong ns;
+  ClintWaitSite *sites[CLINT_WAIT_BUCKETS];
+  /* The event being polled with clGetEventInfo, if any. */
+  cl_event poll_event;
+  void *poll_site;
+  cl_ulong poll_begin;
+} ClintWaitShard;
+
+/* Commands enqueued on a queue since its last wait. */
+typedef struct ClintWaitQueue {
+  CLINT_TREE_ELEMS(struct ClintWaitQueue, cl_command_queue);
+  ClintWaitTarget *pending;
+} ClintWaitQueue;
+
+CLINT_DEFINE_TREE_FUNCS(ClintWaitQueue, cl_command_queue);
+CLINT_IMPL_TREE_FUNCS(ClintWaitQueue, cl_command_queue);
+
+static int g_clint_wait_init = 0;
+static ClintTLS g_clint_wait_key;
+static ClintWaitShard *g_clint_wait_shards = NULL;
+static int g_clint_wait_threads = 0;
+static ClintWaitQueue *g_clint_wait_queues = NULL;
+static ClintSpinLock g_clint_wait_lock;
+static ClintGetEventInfoFn g_clint_get_event_info;
+
+void clint_wait_init(void)
+{
+  if (g_clint_wait_init == 0) {
+    g_clint_wait_init = 1;
+    clint_tls_create(&g_clint_wait_key);
+  }
+}
+
+static ClintWaitShard *clint_wait_shard(void)
+{
+  ClintWaitShard *shard;
+
+  shard = (ClintWaitShard*)clint_tls_get(&g_clint_wait_key);
+  if (shard == NULL) {
+    shard = (ClintWaitShard*)calloc(1, sizeof(ClintWaitShard));
+    if (shard == NULL)
+      return NULL;
+    clint_tls_set(&g_clint_wait_key, shard);
+    CLINT_SPINLOCK_LOCK(g_clint_wait_lock);
+    shard->thread = g_clint_wait_threads++;
+    shard->next = g_clint_wait_shards;
+    g_clint_wait_shards = shard;
+    CLINT_SPINLOCK_UNLOCK(g_clint_wait_lock);
+  }
+  return shard;
+}
+
+/* Called with the lock held. */
+static void clint_wait_add_target(ClintWaitTarget **list, const char *name, cl_command_type type, cl_ulong count)
+{
+  ClintWaitTarget *target;
+
+  for (target = *list; target != NULL; target = target->next) {
+    if (target->name == name && target->type == type) {
+      target->count += count;
+      return;
+    }
+  }
+  target = (ClintWaitTarget*)calloc(1, sizeof(ClintWaitTarget));
+  if (target == NULL)
+    return;
+  target->name = name;
+  target->type = type;
+  target->count = count;
+  CLINT_STACK_PUSH(*list, target);
+}
+
+void clint_wait_enqueued(cl_command_queue queue, const char *name, cl_kernel kernel)
+{
+  ClintWaitQueue *q;
+
+  if (!g_clint_wait_init || queue == NULL)
+    return;
+  if (kernel != NULL) {
+    ClintKernelStats *stats = clint_kernels_lookup(kernel);
+    if (stats != NULL)
+      name = stats->name;
+  }
+  CLINT_SPINLOCK_LOCK(g_clint_wait_lock);
+  q = clint_tree_find_ClintWaitQueue(g_clint_wait_queues, queue);
+  if (q == NULL) {
+    q = (ClintWaitQueue*)calloc(1, sizeof(ClintWaitQueue));
+    if (q != NULL)
+      clint_tree_insert_ClintWaitQueue(&g_clint_wait_queues, queue, q);
+  }
+  if (q != NULL)
+    clint_wait_add_target(&q->pending, name, 0, 1);
+  CLINT_SPINLOCK_UNLOCK(g_clint_wait_lock);
+}
+
+static ClintWaitSite *clint_wait_site(ClintWaitShard *shard, ClintFunc func, void *site)
+{
+  ClintWaitSite *s;
+  unsigned int bucket = (unsigned int)(((size_t)site >> 2) ^ (size_t)func) % CLINT_WAIT_BUCKETS;
+
+  for (s = shard->sites[bucket]; s != NULL; s = s->next) {
+    if (s->site == site && s->func == func)
+      return s;
+  }
+  s = (ClintWaitSite*)calloc(1, sizeof(ClintWaitSite));
+  if (s == NULL)
+    return NULL;
+  s->func = func;
+  s->site = site;
+  CLINT_SPINLOCK_LOCK(g_clint_wait_lock);
+  CLINT_STACK_PUSH(shard->sites[bucket], s);
+  CLINT_SPINLOCK_UNLOCK(g_clint_wait_lock);
+  return s;
+}
+
+static void clint_wait_add(ClintWaitShard *shard, ClintFunc func, void *site, cl_ulong ns,
+                           cl_command_queue queue, cl_uint num_events, const cl_event *events)
+{
+  cl_command_type types[CLINT_WAIT_EVENTS];
+  ClintWaitSite *s;
+  cl_uint i, n;
+
+  s = clint_wait_site(shard, func, site);
+  if (s == NULL)
+    return;
+  CLINT_SPINLOCK_LOCK(shard->lock);
+  s->waits++;
+  s->ns += ns;
+  if (ns > s->max_ns)
+    s->max_ns = ns;
+  shard->ns += ns;
+  CLINT_SPINLOCK_UNLOCK(shard->lock);
+
+  if (queue != NULL) {
+    CLINT_SPINLOCK_LOCK(g_clint_wait_lock);
+    ClintWaitQueue *q = clint_tree_find_ClintWaitQueue(g_clint_wait_queues, queue);
+    if (q != NULL) {
+      /* Move this queue's pending commands to the site. */
+      while (q->pending != NULL) {
+        ClintWaitTarget *target = q->pending;
+        q->pending = target->next;
+        clint_wait_add_target(&s->targets, target->name, 0, target->count);
+        free(target);
+      }
+    }
+    CLINT_SPINLOCK_UNLOCK(g_clint_wait_lock);
+  }
+
+  if (g_clint_get_event_info == NULL)
+    g_clint_get_event_info = (ClintGetEventInfoFn)clint_opencl_func("clGetEventInfo");
+  if (events == NULL || g_clint_get_event_info == NULL)
+    return;
+  /* Ask the driver before taking the lock. */
+  for (; num_events > 0; num_events -= n, events += n) {
+    n = (num_events < CLINT_WAIT_EVENTS) ? num_events : CLINT_WAIT_EVENTS;
+    for (i = 0; i < n; i++) {
+      if (g_clint_get_event_info(events[i], CL_EVENT_COMMAND_TYPE, sizeof(types[i]), &types[i], NULL) != CL_SUCCESS)
+        types[i] = 0;
+    }
+    CLINT_SPINLOCK_LOCK(g_clint_wait_lock);
+    for (i = 0; i < n; i++) {
+      if (types[i] != 0)
+        clint_wait_add_target(&s->targets, NULL, types[i], 1);
+    }
+    CLINT_SPINLOCK_UNLOCK(g_clint_wait_lock);
+  }
+}
+
+void clint_wait_record(ClintFunc func, void *site, const cl_ulong *times,
+                       cl_command_queue queue, cl_uint num_events, const cl_event *events)
+{
+  ClintWaitShard *shard;
+
+  if (!g_clint_wait_init || times[2] < times[1])
+    return;
+  shard = clint_wait_shard();
+  if (shard == NULL)
+    return;
+  clint_wait_add(shard, func, site, times[2] - times[1], queue, num_events, events);
+}
+
+void clint_wait_poll(void *site, const cl_ulong *times, cl_event event, cl_int status)
+{
+  ClintWaitShard *shard;
+
+  if (!g_clint_wait_init)
+    return;
+  shard = clint_wait_shard();
+  if (shard == NULL)
+    return;
+  if (status > CL_COMPLETE) {
+    if (shard->poll_event != event) {
+      shard->poll_event = event;
+      shard->poll_site = site;
+      shard->poll_begin = times[1];
+    }
+  } else if (shard->poll_event == event) {
+    shard->poll_event = NULL;
+    if (times[2] > shard->poll_begin)
+      clint_wait_add(shard, ClintFunc_clGetEventInfo, shard->poll_site,
+                     times[2] - shard->poll_begin, NULL, 1, &event);
+  }
+}
+
+/* A site's counts, copied under its shard's lock. */
+typedef struct ClintWaitRow {
+  const ClintWaitSite *site;
+  cl_ulong waits;
+  cl_ulong ns;
+  cl_ulong max_ns;
+} ClintWaitRow;
+
+static int clint_wait_compare(const void *a, const void *b)
+{
+  const ClintWaitRow *sa = (const ClintWaitRow*)a;
+  const ClintWaitRow *sb = (const ClintWaitRow*)b;
+
+  if (sa->ns != sb->ns)
+    return (sa->ns < sb->ns) ? 1 : -1;
+  return 0;
+}
+
+static void clint_wait_report_targets(const ClintWaitSite *s)
+{
+  const ClintWaitTarget *top[CLINT_WAIT_TARGETS];
+  const ClintWaitTarget *target;
+  int count = 0;
+  int i, j;
+
+  for (target = s->targets; target != NULL; target = target->next) {
+    for (i = 0; i < count && top[i]->count >= target->count; i++)
+      ;
+    if (i == CLINT_WAIT_TARGETS)
+      continue;
+    if (count < CLINT_WAIT_TARGETS)
+      count++;
+    for (j = count - 1; j > i; j--)
+      top[j] = top[j - 1];
+    top[i] = target;
+  }
+  for (i = 0; i < count; i++) {
+    clint_log("\t\twaited on %lu %s\n", (unsigned long)top[i]->count,
+              (top[i]->name != NULL) ? top[i]->name : clint_string_command_type(top[i]->type));
+  }
+}
+
+void clint_wait_report(int final)
+{
+  ClintWaitShard *shard;
+  ClintWaitRow *rows;
+  ClintWaitSite *s;
+  cl_ulong shard_ns;
+  int count;
+  int i, b;
+
+  if (!g_clint_wait_init)
+    return;
+  CLINT_SPINLOCK_LOCK(g_clint_wait_lock);
+  for (shard = g_clint_wait_shards; shard != NULL; shard = shard->next) {
+    count = 0;
+    for (b = 0; b < CLINT_WAIT_BUCKETS; b++) {
+      for (s = shard->sites[b]; s != NULL; s = s->next)
+        count++;
+    }
+    if (count == 0)
+      continue;
+    rows = (ClintWaitRow*)malloc(sizeof(ClintWaitRow) * count);
+    if (rows == NULL)
+      continue;
+    count = 0;
+    CLINT_SPINLOCK_LOCK(shard->lock);
+    shard_ns = shard->ns;
+    for (b = 0; b < CLINT_WAIT_BUCKETS; b++) {
+      for (s = shard->sites[b]; s != NULL; s = s->next) {
+        if (s->waits == 0)
+          continue;
+        rows[count].site = s;
+        rows[count].waits = s->waits;
+        rows[count].ns = s->ns;
+        rows[count].max_ns = s->max_ns;
+        count++;
+        /* Only report once, even if we're shutdown again. */
+        if (final) {
+          s->waits = 0;
+          s->ns = 0;
+          s->max_ns = 0;
+        }
+      }
+    }
+    if (final)
+      shard->ns = 0;
+    CLINT_SPINLOCK_UNLOCK(shard->lock);
+    if (shard_ns > 0) {
+      qsort(rows, count, sizeof(ClintWaitRow), clint_wait_compare);
+      clint_log("Wait statistics for thread %d: %f s\n", shard->thread, (double)shard_ns * 1.0e-9);
+      for (i = 0; i < count; i++) {
+        char where[256];
+        clint_get_symbol(rows[i].site->site, where, sizeof(where));
+        clint_log("\t%s from %s: %lu waits, %f s, max %f s\n",
+                  clint_func_name(rows[i].site->func), where, (unsigned long)rows[i].waits,
+                  (double)rows[i].ns * 1.0e-9, (double)rows[i].max_ns * 1.0e-9);
+        clint_wait_report_targets(rows[i].site);
+      }
+    }
+    free(rows);
+  }
+  CLINT_SPINLOCK_UNLOCK(g_clint_wait_lock);
+}
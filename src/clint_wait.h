@@ -0,0 +1,66 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _CLINT_WAIT_H_
+#define _CLINT_WAIT_H_
+
+#include "clint_opencl_funcs.h"
+
+#ifdef __APPLE__
+#include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void clint_wait_init(void);
+
+/* Remember a command so the next wait on its queue can name it. */
+void clint_wait_enqueued(cl_command_queue queue, const char *name, cl_kernel kernel);
+
+/* A blocking call returned.  times are the generated wrapper's api_time.
+   Waits on a queue are linked to the commands enqueued since its last wait,
+   waits on events to their command types. */
+void clint_wait_record(ClintFunc func, void *site, const cl_ulong *times,
+                       cl_command_queue queue, cl_uint num_events, const cl_event *events);
+
+/* clGetEventInfo(CL_EVENT_COMMAND_EXECUTION_STATUS) returned status.  Repeated
+   polls of one event until it completes count as a single wait. */
+void clint_wait_poll(void *site, const cl_ulong *times, cl_event event, cl_int status);
+
+/* Log wait time per thread and call site. */
+void clint_wait_report(int final);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CLINT_WAIT_H_
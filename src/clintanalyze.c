@@ -0,0 +1,904 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Summarize a log written with CLINT_TRACE, CLINT_PROFILE and CLINT_LEAKS:
+   calls, errors and profiled time per function, launches per kernel, and
+   object lifetimes.  The log is mapped and split on line boundaries across
+   threads, then their partial results are merged in file order. */
+
+#include "clint_analyze.h"
+#include "clint_opencl_funcs.h"
+#include "clint_shm.h"
+#include "clint_time.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CLINTANALYZE_MAX_THREADS 64
+/* Smaller logs aren't worth another thread. */
+#define CLINTANALYZE_MIN_CHUNK (4 * 1024 * 1024)
+#define CLINTANALYZE_NAME_BUCKETS 1024
+#define CLINTANALYZE_ERROR_SIZE 128
+
+/* As CLINT_LEAKS names them, in ClintShmObject order. */
+static const char *g_clintanalyze_objects[ClintShmObject_max] = {
+  "context",
+  "command_queue",
+  "mem",
+  "sampler",
+  "program",
+  "kernel",
+  "event"
+};
+
+typedef enum ClintanalyzeCount {
+  ClintanalyzeCount_created,
+  ClintanalyzeCount_retained,
+  ClintanalyzeCount_released,
+  ClintanalyzeCount_leaked,
+  ClintanalyzeCount_max
+} ClintanalyzeCount;
+
+typedef struct ClintanalyzeFuncStats {
+  cl_ulong calls;
+  cl_ulong errors;
+  cl_ulong profiled;
+  cl_ulong bytes;
+  double seconds;
+  double max_seconds;
+} ClintanalyzeFuncStats;
+
+/* Open addressing from kernel handles to an index. */
+typedef struct ClintanalyzeHandles {
+  cl_ulong *keys;
+  int *values;
+  size_t buckets;
+  size_t count;
+} ClintanalyzeHandles;
+
+/* A kernel handle as seen by one chunk: launches until it is created again. */
+typedef struct ClintanalyzeLaunches {
+  cl_ulong handle;
+  /* Created in this chunk, with the name of the clCreateKernel call before
+     it, or NULL if that call was in an earlier chunk.  Otherwise named by
+     the chunks before. */
+  int created;
+  const char *name;
+  size_t len;
+  cl_ulong launches;
+} ClintanalyzeLaunches;
+
+typedef struct ClintanalyzeError {
+  int func;
+  const char *text;
+  size_t len;
+  cl_ulong count;
+} ClintanalyzeError;
+
+typedef struct ClintanalyzeChunk {
+  const char *begin;
+  const char *end;
+  cl_ulong lines;
+  ClintanalyzeFuncStats funcs[ClintFunc_max];
+  cl_ulong objects[ClintShmObject_max][ClintanalyzeCount_max];
+  ClintanalyzeLaunches *kernels;
+  int num_kernels;
+  int max_kernels;
+  ClintanalyzeHandles handles;
+  /* The last clCreateKernel name. */
+  const char *kernel_name;
+  size_t kernel_name_len;
+  ClintanalyzeError *errors;
+  int num_errors;
+  int max_errors;
+  /* The last "Kernel statistics:" table. */
+  const char *kernel_stats;
+  /* CLINT_TRACE_LOOPS: the next repeat_lines trace lines stand for this many more. */
+  cl_ulong repeats;
+  int repeat_lines;
+} ClintanalyzeChunk;
+
+typedef struct ClintanalyzeKernel {
+  const char *name;
+  size_t len;
+  cl_ulong created;
+  cl_ulong launches;
+  /* From the CLINT_PROFILE "Kernel statistics:" table. */
+  cl_ulong profiled;
+  double mean_us;
+  double total_s;
+} ClintanalyzeKernel;
+
+typedef struct ClintanalyzeRow {
+  int index;
+  double key;
+} ClintanalyzeRow;
+
+static int g_clintanalyze_names[CLINTANALYZE_NAME_BUCKETS];
+
+static unsigned int clintanalyze_hash(const char *s, size_t len)
+{
+  unsigned int h = 2166136261u;
+
+  while (len-- > 0)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+}
+
+static void clintanalyze_names_init(void)
+{
+  int i;
+
+  for (i = 0; i < ClintFunc_max; i++) {
+    const char *name = g_clint_analyze_funcs[i].name;
+    unsigned int b = clintanalyze_hash(name, strlen(name)) % CLINTANALYZE_NAME_BUCKETS;
+    while (g_clintanalyze_names[b] != 0)
+      b = (b + 1) % CLINTANALYZE_NAME_BUCKETS;
+    g_clintanalyze_names[b] = i + 1;
+  }
+}
+
+/* The ClintFunc named by s, or -1. */
+static int clintanalyze_func(const char *s, size_t len)
+{
+  unsigned int b = clintanalyze_hash(s, len) % CLINTANALYZE_NAME_BUCKETS;
+
+  while (g_clintanalyze_names[b] != 0) {
+    const char *name = g_clint_analyze_funcs[g_clintanalyze_names[b] - 1].name;
+    if (strncmp(name, s, len) == 0 && name[len] == 0)
+      return g_clintanalyze_names[b] - 1;
+    b = (b + 1) % CLINTANALYZE_NAME_BUCKETS;
+  }
+  return -1;
+}
+
+static int clintanalyze_prefix(const char *p, const char *end, const char *prefix)
+{
+  size_t len = strlen(prefix);
+  return (size_t)(end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+static const char *clintanalyze_word(const char *p, const char *end)
+{
+  while (p < end && (isalnum((unsigned char)*p) || *p == '_'))
+    p++;
+  return p;
+}
+
+/* The value of the argument "<key>=", e.g. "kernel=", in a call line. */
+static const char *clintanalyze_arg(const char *p, const char *end, const char *key)
+{
+  size_t len = strlen(key);
+
+  for (; p + len <= end; p++) {
+    if ((p[-1] == '(' || p[-1] == ' ') && memcmp(p, key, len) == 0)
+      return p + len;
+  }
+  return NULL;
+}
+
+static cl_ulong clintanalyze_handle(const char *p, const char *end)
+{
+  cl_ulong v = 0;
+
+  if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    p += 2;
+  for (; p < end && isxdigit((unsigned char)*p); p++)
+    v = v * 16 + (cl_ulong)(isdigit((unsigned char)*p) ? *p - '0' : tolower((unsigned char)*p) - 'a' + 10);
+  return v;
+}
+
+static int clintanalyze_handles_find(const ClintanalyzeHandles *handles, cl_ulong key)
+{
+  size_t b;
+
+  if (handles->buckets == 0)
+    return -1;
+  b = (size_t)(key ^ (key >> 17)) & (handles->buckets - 1);
+  while (handles->values[b] >= 0) {
+    if (handles->keys[b] == key)
+      return handles->values[b];
+    b = (b + 1) & (handles->buckets - 1);
+  }
+  return -1;
+}
+
+static void clintanalyze_handles_put(ClintanalyzeHandles *handles, cl_ulong key, int value)
+{
+  size_t b;
+
+  if (2 * (handles->count + 1) > handles->buckets) {
+    ClintanalyzeHandles grown;
+    size_t i;
+    grown.buckets = handles->buckets ? 2 * handles->buckets : 64;
+    grown.count = 0;
+    grown.keys = (cl_ulong*)malloc(grown.buckets * sizeof(cl_ulong));
+    grown.values = (int*)malloc(grown.buckets * sizeof(int));
+    if (grown.keys == NULL || grown.values == NULL) {
+      fprintf(stderr, "clintanalyze: out of memory\n");
+      exit(1);
+    }
+    memset(grown.values, 0xff, grown.buckets * sizeof(int));
+    for (i = 0; i < handles->buckets; i++) {
+      if (handles->values[i] >= 0)
+        clintanalyze_handles_put(&grown, handles->keys[i], handles->values[i]);
+    }
+    free(handles->keys);
+    free(handles->values);
+    *handles = grown;
+  }
+  b = (size_t)(key ^ (key >> 17)) & (handles->buckets - 1);
+  while (handles->values[b] >= 0 && handles->keys[b] != key)
+    b = (b + 1) & (handles->buckets - 1);
+  if (handles->values[b] < 0)
+    handles->count++;
+  handles->keys[b] = key;
+  handles->values[b] = value;
+}
+
+static void *clintanalyze_grow(void *array, int *max, size_t size)
+{
+  *max = *max ? 2 * *max : 64;
+  array = realloc(array, *max * size);
+  if (array == NULL) {
+    fprintf(stderr, "clintanalyze: out of memory\n");
+    exit(1);
+  }
+  return array;
+}
+
+static ClintanalyzeLaunches *clintanalyze_kernel(ClintanalyzeChunk *chunk, cl_ulong handle, int created)
+{
+  int i = created ? -1 : clintanalyze_handles_find(&chunk->handles, handle);
+  ClintanalyzeLaunches *k;
+
+  if (i >= 0)
+    return &chunk->kernels[i];
+  if (chunk->num_kernels == chunk->max_kernels)
+    chunk->kernels = (ClintanalyzeLaunches*)clintanalyze_grow(chunk->kernels, &chunk->max_kernels,
+                                                              sizeof(ClintanalyzeLaunches));
+  i = chunk->num_kernels++;
+  k = &chunk->kernels[i];
+  memset(k, 0, sizeof(ClintanalyzeLaunches));
+  k->handle = handle;
+  k->created = created;
+  if (created) {
+    k->name = chunk->kernel_name;
+    k->len = chunk->kernel_name_len;
+  }
+  clintanalyze_handles_put(&chunk->handles, handle, i);
+  return k;
+}
+
+static void clintanalyze_error(ClintanalyzeChunk *chunk, int func, const char *text, size_t len, cl_ulong count)
+{
+  ClintanalyzeError *e;
+  int i;
+
+  for (i = 0; i < chunk->num_errors; i++) {
+    e = &chunk->errors[i];
+    if (e->func == func && e->len == len && memcmp(e->text, text, len) == 0) {
+      e->count += count;
+      return;
+    }
+  }
+  if (chunk->num_errors == chunk->max_errors)
+    chunk->errors = (ClintanalyzeError*)clintanalyze_grow(chunk->errors, &chunk->max_errors,
+                                                          sizeof(ClintanalyzeError));
+  e = &chunk->errors[chunk->num_errors++];
+  e->func = func;
+  e->text = text;
+  e->len = len;
+  e->count = count;
+}
+
+/* Other errors, e.g. from CLINT_TRACK, counted with their handles masked. */
+static void clintanalyze_other_error(ClintanalyzeChunk *chunk, const char *p, const char *end)
+{
+  char text[CLINTANALYZE_ERROR_SIZE];
+  size_t len = 0;
+  int i;
+
+  while (p < end && len + 3 < sizeof(text)) {
+    if (p + 2 < end && p[0] == '0' && p[1] == 'x' && isxdigit((unsigned char)p[2])) {
+      for (p += 2; p < end && isxdigit((unsigned char)*p); p++)
+        ;
+      text[len++] = '%';
+      text[len++] = 'p';
+    } else {
+      text[len++] = *p++;
+    }
+  }
+  for (i = 0; i < chunk->num_errors; i++) {
+    ClintanalyzeError *e = &chunk->errors[i];
+    if (e->func == -1 && e->len == len && memcmp(e->text, text, len) == 0) {
+      e->count++;
+      return;
+    }
+  }
+  p = (const char*)malloc(len);
+  if (p == NULL)
+    return;
+  memcpy((char*)p, text, len);
+  clintanalyze_error(chunk, -1, p, len, 1);
+}
+
+static void clintanalyze_trace(ClintanalyzeChunk *chunk, const char *p, const char *end)
+{
+  const char *q = clintanalyze_word(p, end);
+  int func = clintanalyze_func(p, q - p);
+  const ClintAnalyzeFunc *info;
+  cl_ulong n = 1;
+
+  if (func < 0)
+    return;
+  info = &g_clint_analyze_funcs[func];
+  if (chunk->repeat_lines > 0) {
+    chunk->repeat_lines--;
+    n += chunk->repeats;
+  }
+  if (q < end && *q == '(') {
+    const char *v;
+    chunk->funcs[func].calls += n;
+    if (info->kernel == NULL || (v = clintanalyze_arg(q + 1, end, info->kernel)) == NULL)
+      return;
+    if (info->kind == ClintAnalyze_create) {
+      const char *e = v;
+      while (e < end && *e != ',' && *e != ')')
+        e++;
+      chunk->kernel_name = v;
+      chunk->kernel_name_len = e - v;
+    } else if (!clintanalyze_prefix(v, end, "(nil)")) {
+      clintanalyze_kernel(chunk, clintanalyze_handle(v, end), 0)->launches += n;
+    }
+  } else if (clintanalyze_prefix(q, end, " returned ")) {
+    q += 10;
+    if (info->object < 0)
+      return;
+    if (info->kind == ClintAnalyze_create) {
+      if (clintanalyze_prefix(q, end, "(nil)") || clintanalyze_handle(q, end) == 0)
+        return;
+      chunk->objects[info->object][ClintanalyzeCount_created] += n;
+      if (info->object == ClintShmObject_kernel)
+        clintanalyze_kernel(chunk, clintanalyze_handle(q, end), 1);
+    } else if (q < end && *q == '0' && (q + 1 == end || q[1] == ' ')) {
+      if (info->kind == ClintAnalyze_retain)
+        chunk->objects[info->object][ClintanalyzeCount_retained] += n;
+      else if (info->kind == ClintAnalyze_release)
+        chunk->objects[info->object][ClintanalyzeCount_released] += n;
+    }
+  }
+}
+
+/* "PROFILE: <func> <seconds>[ <bytes> bytes <rate> GB/s][ <range>]" */
+static void clintanalyze_profile(ClintanalyzeChunk *chunk, const char *p, const char *end)
+{
+  const char *q = clintanalyze_word(p, end);
+  int func = clintanalyze_func(p, q - p);
+  ClintanalyzeFuncStats *stats;
+  char number[64];
+  size_t len;
+  double seconds;
+
+  if (func < 0 || q == end)
+    return;
+  for (p = ++q; q < end && *q != ' '; q++)
+    ;
+  len = q - p;
+  if (len == 0 || len >= sizeof(number))
+    return;
+  memcpy(number, p, len);
+  number[len] = 0;
+  seconds = atof(number);
+  stats = &chunk->funcs[func];
+  stats->profiled++;
+  stats->seconds += seconds;
+  if (seconds > stats->max_seconds)
+    stats->max_seconds = seconds;
+  if (q < end && clintanalyze_prefix(clintanalyze_word(q + 1, end), end, " bytes "))
+    stats->bytes += (cl_ulong)strtoul(q + 1, NULL, 10);
+}
+
+static void clintanalyze_line(ClintanalyzeChunk *chunk, const char *p, const char *end)
+{
+  if (end > p && end[-1] == '\r')
+    end--;
+  if (end - p > 2 && p[0] == 'c' && p[1] == 'l') {
+    clintanalyze_trace(chunk, p, end);
+  } else if (clintanalyze_prefix(p, end, "PROFILE: ")) {
+    clintanalyze_profile(chunk, p + 9, end);
+  } else if (clintanalyze_prefix(p, end, "ERROR in ")) {
+    const char *q = clintanalyze_word(p + 9, end);
+    int func = clintanalyze_func(p + 9, q - (p + 9));
+    if (func >= 0 && clintanalyze_prefix(q, end, ": ")) {
+      chunk->funcs[func].errors++;
+      clintanalyze_error(chunk, func, q + 2, end - (q + 2), 1);
+    }
+  } else if (clintanalyze_prefix(p, end, "ERROR: ")) {
+    clintanalyze_other_error(chunk, p + 7, end);
+  } else if (clintanalyze_prefix(p, end, "Possibly leaked cl_")) {
+    const char *q = clintanalyze_word(p + 19, end);
+    int i;
+    for (i = 0; i < ClintShmObject_max; i++) {
+      if (strlen(g_clintanalyze_objects[i]) == (size_t)(q - (p + 19)) &&
+          memcmp(g_clintanalyze_objects[i], p + 19, q - (p + 19)) == 0)
+        chunk->objects[i][ClintanalyzeCount_leaked]++;
+    }
+  } else if (clintanalyze_prefix(p, end, "... x")) {
+    /* "... x<repeats> (<lines> calls)": the repeats left out were the same
+       calls as the lines that follow. */
+    char *q;
+    chunk->repeats = (cl_ulong)strtoul(p + 5, &q, 10);
+    chunk->repeat_lines = (*q == ' ' && q[1] == '(') ? atoi(q + 2) : 0;
+  } else if (clintanalyze_prefix(p, end, "Kernel statistics:")) {
+    chunk->kernel_stats = end;
+  }
+}
+
+static void clintanalyze_chunk(ClintanalyzeChunk *chunk)
+{
+  const char *p = chunk->begin;
+
+  while (p < chunk->end) {
+    const char *end = (const char*)memchr(p, '\n', chunk->end - p);
+    if (end == NULL)
+      end = chunk->end;
+    clintanalyze_line(chunk, p, end);
+    chunk->lines++;
+    p = end + 1;
+  }
+}
+
+#if defined(WIN32)
+static DWORD WINAPI clintanalyze_thread(LPVOID arg)
+{
+  clintanalyze_chunk((ClintanalyzeChunk*)arg);
+  return 0;
+}
+#else
+static void *clintanalyze_thread(void *arg)
+{
+  clintanalyze_chunk((ClintanalyzeChunk*)arg);
+  return NULL;
+}
+#endif
+
+static const char *clintanalyze_map(const char *path, size_t *size)
+{
+#if defined(WIN32)
+  HANDLE file, mapping;
+  LARGE_INTEGER file_size;
+  const char *data;
+
+  file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return NULL;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return NULL;
+  }
+  *size = (size_t)file_size.QuadPart;
+  if (*size == 0) {
+    CloseHandle(file);
+    return "";
+  }
+  mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL)
+    return NULL;
+  data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  return data;
+#else
+  struct stat st;
+  void *data;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+  *size = (size_t)st.st_size;
+  if (*size == 0) {
+    close(fd);
+    return "";
+  }
+  data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+#ifdef MADV_SEQUENTIAL
+  madvise(data, *size, MADV_SEQUENTIAL);
+#endif
+  return (const char*)data;
+#endif
+}
+
+static int clintanalyze_cpus(void)
+{
+#if defined(WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int)n : 1;
+#endif
+}
+
+static int clintanalyze_kernel_index(ClintanalyzeKernel **kernels, int *num, int *max, const char *name, size_t len)
+{
+  int i;
+
+  for (i = 0; i < *num; i++) {
+    if ((*kernels)[i].len == len && memcmp((*kernels)[i].name, name, len) == 0)
+      return i;
+  }
+  if (*num == *max)
+    *kernels = (ClintanalyzeKernel*)clintanalyze_grow(*kernels, max, sizeof(ClintanalyzeKernel));
+  memset(&(*kernels)[*num], 0, sizeof(ClintanalyzeKernel));
+  (*kernels)[*num].name = name;
+  (*kernels)[*num].len = len;
+  return (*num)++;
+}
+
+/* Trace lines cut names to 28 characters and "...". */
+static int clintanalyze_kernel_match(const ClintanalyzeKernel *k, const char *name, size_t len)
+{
+  if (k->len == len && memcmp(k->name, name, len) == 0)
+    return 1;
+  return k->len > 3 && memcmp(k->name + k->len - 3, "...", 3) == 0 &&
+    len >= k->len - 3 && memcmp(k->name, name, k->len - 3) == 0;
+}
+
+/* The rows under "Kernel statistics:": kernel, launches, profiled, mean (us), total (s), +/- (s). */
+static void clintanalyze_kernel_stats(ClintanalyzeKernel **kernels, int *num, int *max,
+                                      const char *p, const char *end)
+{
+  int header = 1;
+
+  while (p < end) {
+    const char *line = ++p;
+    const char *name_end;
+    char row[256];
+    size_t len;
+    unsigned long launches, profiled;
+    double mean, total;
+    int i;
+
+    p = (const char*)memchr(line, '\n', end - line);
+    if (p == NULL)
+      p = end;
+    len = (size_t)(p - line);
+    if (header) {
+      header = 0;
+      continue;
+    }
+    if (len >= sizeof(row))
+      break;
+    memcpy(row, line, len);
+    row[len] = 0;
+    for (name_end = line; name_end < p && !isspace((unsigned char)*name_end); name_end++)
+      ;
+    if (name_end == line || sscanf(row + (name_end - line), "%lu %lu %lf %lf", &launches, &profiled, &mean, &total) != 4)
+      break;
+    for (i = 0; i < *num; i++) {
+      if (clintanalyze_kernel_match(&(*kernels)[i], line, name_end - line))
+        break;
+    }
+    if (i == *num)
+      i = clintanalyze_kernel_index(kernels, num, max, line, name_end - line);
+    if ((*kernels)[i].launches == 0)
+      (*kernels)[i].launches = launches;
+    (*kernels)[i].profiled = profiled;
+    (*kernels)[i].mean_us = mean;
+    (*kernels)[i].total_s = total;
+  }
+}
+
+static int clintanalyze_compare(const void *a, const void *b)
+{
+  const ClintanalyzeRow *ra = (const ClintanalyzeRow*)a;
+  const ClintanalyzeRow *rb = (const ClintanalyzeRow*)b;
+
+  if (ra->key != rb->key)
+    return (ra->key < rb->key) ? 1 : -1;
+  return ra->index - rb->index;
+}
+
+static void clintanalyze_report(ClintanalyzeChunk *chunks, int num_chunks, const char *end)
+{
+  ClintanalyzeChunk *total = &chunks[0];
+  ClintanalyzeHandles handles;
+  ClintanalyzeKernel *kernels = NULL;
+  ClintanalyzeRow *rows;
+  const char *kernel_name = NULL;
+  size_t kernel_name_len = 0;
+  const char *kernel_stats = NULL;
+  int num_kernels = 0, max_kernels = 0;
+  int num_rows = 0;
+  int header = 0;
+  int c, i, j;
+
+  /* Merge into the first chunk, and name the kernels in file order. */
+  memset(&handles, 0, sizeof(handles));
+  for (c = 0; c < num_chunks; c++) {
+    ClintanalyzeChunk *chunk = &chunks[c];
+    for (i = 0; i < chunk->num_kernels; i++) {
+      ClintanalyzeLaunches *k = &chunk->kernels[i];
+      if (!k->created) {
+        j = clintanalyze_handles_find(&handles, k->handle);
+        if (j < 0)
+          j = clintanalyze_kernel_index(&kernels, &num_kernels, &max_kernels, "(unknown)", 9);
+        kernels[j].launches += k->launches;
+      }
+    }
+    for (i = 0; i < chunk->num_kernels; i++) {
+      ClintanalyzeLaunches *k = &chunk->kernels[i];
+      if (k->created) {
+        if (k->name == NULL) {
+          k->name = kernel_name ? kernel_name : "(unknown)";
+          k->len = kernel_name ? kernel_name_len : 9;
+        }
+        j = clintanalyze_kernel_index(&kernels, &num_kernels, &max_kernels, k->name, k->len);
+        kernels[j].created++;
+        kernels[j].launches += k->launches;
+        clintanalyze_handles_put(&handles, k->handle, j);
+      }
+    }
+    if (chunk->kernel_name != NULL) {
+      kernel_name = chunk->kernel_name;
+      kernel_name_len = chunk->kernel_name_len;
+    }
+    if (chunk->kernel_stats != NULL)
+      kernel_stats = chunk->kernel_stats;
+    if (c == 0)
+      continue;
+    total->lines += chunk->lines;
+    for (i = 0; i < ClintFunc_max; i++) {
+      ClintanalyzeFuncStats *a = &total->funcs[i];
+      const ClintanalyzeFuncStats *b = &chunk->funcs[i];
+      a->calls += b->calls;
+      a->errors += b->errors;
+      a->profiled += b->profiled;
+      a->bytes += b->bytes;
+      a->seconds += b->seconds;
+      if (b->max_seconds > a->max_seconds)
+        a->max_seconds = b->max_seconds;
+    }
+    for (i = 0; i < ClintShmObject_max; i++) {
+      for (j = 0; j < ClintanalyzeCount_max; j++)
+        total->objects[i][j] += chunk->objects[i][j];
+    }
+    for (i = 0; i < chunk->num_errors; i++) {
+      ClintanalyzeError *e = &chunk->errors[i];
+      clintanalyze_error(total, e->func, e->text, e->len, e->count);
+    }
+  }
+  if (kernel_stats != NULL)
+    clintanalyze_kernel_stats(&kernels, &num_kernels, &max_kernels, kernel_stats, end);
+
+  j = ClintFunc_max;
+  if (num_kernels > j)
+    j = num_kernels;
+  if (total->num_errors > j)
+    j = total->num_errors;
+  rows = (ClintanalyzeRow*)malloc((j + 1) * sizeof(ClintanalyzeRow));
+  if (rows == NULL)
+    return;
+
+  for (i = 0; i < ClintFunc_max; i++) {
+    const ClintanalyzeFuncStats *s = &total->funcs[i];
+    if (s->calls > 0 || s->errors > 0 || s->profiled > 0) {
+      rows[num_rows].index = i;
+      rows[num_rows].key = (double)s->calls + s->seconds;
+      num_rows++;
+    }
+  }
+  if (num_rows > 0) {
+    qsort(rows, num_rows, sizeof(ClintanalyzeRow), clintanalyze_compare);
+    printf("Functions:\n");
+    printf("%-40s %12s %10s %10s %12s %12s %12s %12s\n",
+           "function", "calls", "errors", "profiled", "total (s)", "mean (us)", "max (us)", "GB/s");
+    for (i = 0; i < num_rows; i++) {
+      const ClintanalyzeFuncStats *s = &total->funcs[rows[i].index];
+      printf("%-40s %12lu %10lu %10lu %12.6f %12.3f %12.3f %12.3f\n",
+             g_clint_analyze_funcs[rows[i].index].name, (unsigned long)s->calls,
+             (unsigned long)s->errors, (unsigned long)s->profiled, s->seconds,
+             s->profiled ? s->seconds * 1.0e6 / (double)s->profiled : 0.0, s->max_seconds * 1.0e6,
+             s->seconds > 0 ? (double)s->bytes * 1.0e-9 / s->seconds : 0.0);
+    }
+  }
+
+  num_rows = 0;
+  for (i = 0; i < num_kernels; i++) {
+    rows[num_rows].index = i;
+    rows[num_rows].key = (double)kernels[i].launches + kernels[i].total_s;
+    num_rows++;
+  }
+  if (num_rows > 0) {
+    qsort(rows, num_rows, sizeof(ClintanalyzeRow), clintanalyze_compare);
+    printf("Kernels:\n");
+    printf("%-40s %10s %12s %12s %12s %12s\n",
+           "kernel", "created", "launches", "profiled", "mean (us)", "total (s)");
+    for (i = 0; i < num_rows; i++) {
+      const ClintanalyzeKernel *k = &kernels[rows[i].index];
+      printf("%-40.*s %10lu %12lu %12lu %12.3f %12.6f\n", (int)k->len, k->name,
+             (unsigned long)k->created, (unsigned long)k->launches, (unsigned long)k->profiled,
+             k->mean_us, k->total_s);
+    }
+  }
+
+  num_rows = 0;
+  for (i = 0; i < total->num_errors; i++) {
+    rows[num_rows].index = i;
+    rows[num_rows].key = (double)total->errors[i].count;
+    num_rows++;
+  }
+  if (num_rows > 0) {
+    qsort(rows, num_rows, sizeof(ClintanalyzeRow), clintanalyze_compare);
+    printf("Errors:\n");
+    printf("%12s %-40s %s\n", "count", "function", "error");
+    for (i = 0; i < num_rows; i++) {
+      const ClintanalyzeError *e = &total->errors[rows[i].index];
+      printf("%12lu %-40s %.*s\n", (unsigned long)e->count,
+             (e->func >= 0) ? g_clint_analyze_funcs[e->func].name : "-", (int)e->len, e->text);
+    }
+  }
+
+  for (i = 0; i < ClintShmObject_max; i++) {
+    for (j = 0; j < ClintanalyzeCount_max; j++) {
+      if (total->objects[i][j] != 0)
+        break;
+    }
+    if (j == ClintanalyzeCount_max)
+      continue;
+    if (!header) {
+      printf("Objects:\n");
+      printf("%-20s %12s %12s %12s %12s %12s\n",
+             "type", "created", "retained", "released", "outstanding", "leaked");
+      header = 1;
+    }
+    printf("cl_%-17s %12lu %12lu %12lu %12ld %12lu\n", g_clintanalyze_objects[i],
+           (unsigned long)total->objects[i][ClintanalyzeCount_created],
+           (unsigned long)total->objects[i][ClintanalyzeCount_retained],
+           (unsigned long)total->objects[i][ClintanalyzeCount_released],
+           (long)(total->objects[i][ClintanalyzeCount_created] + total->objects[i][ClintanalyzeCount_retained] -
+                  total->objects[i][ClintanalyzeCount_released]),
+           (unsigned long)total->objects[i][ClintanalyzeCount_leaked]);
+  }
+  free(rows);
+}
+
+int main(int argc, const char *argv[])
+{
+  ClintanalyzeChunk *chunks;
+  const char *path = NULL;
+  const char *data;
+  size_t size = 0;
+  cl_ulong start;
+  int threads = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else
+      path = argv[i];
+  }
+  if (path == NULL) {
+    fprintf(stderr, "usage: clintanalyze [-j <threads>] <log>\n");
+    return 1;
+  }
+  data = clintanalyze_map(path, &size);
+  if (data == NULL) {
+    fprintf(stderr, "clintanalyze: can't read %s\n", path);
+    return 1;
+  }
+
+  start = clint_time_now();
+  clintanalyze_names_init();
+  if (threads <= 0) {
+    threads = clintanalyze_cpus();
+    if ((size_t)threads > size / CLINTANALYZE_MIN_CHUNK)
+      threads = (int)(size / CLINTANALYZE_MIN_CHUNK);
+  }
+  if (threads > CLINTANALYZE_MAX_THREADS)
+    threads = CLINTANALYZE_MAX_THREADS;
+  if (threads < 1)
+    threads = 1;
+  chunks = (ClintanalyzeChunk*)calloc(threads, sizeof(ClintanalyzeChunk));
+  if (chunks == NULL) {
+    fprintf(stderr, "clintanalyze: out of memory\n");
+    return 1;
+  }
+  /* Each chunk ends after the first newline past its share of the log. */
+  chunks[0].begin = data;
+  for (i = 0; i < threads; i++) {
+    const char *end = data + size;
+    if (i + 1 < threads) {
+      const char *split = data + size / threads * (i + 1);
+      if (split < chunks[i].begin)
+        split = chunks[i].begin;
+      end = (const char*)memchr(split, '\n', data + size - split);
+      end = (end != NULL) ? end + 1 : data + size;
+      chunks[i + 1].begin = end;
+    }
+    chunks[i].end = end;
+  }
+
+  if (threads == 1) {
+    clintanalyze_chunk(&chunks[0]);
+  } else {
+#if defined(WIN32)
+    HANDLE workers[CLINTANALYZE_MAX_THREADS];
+    for (i = 0; i < threads; i++)
+      workers[i] = CreateThread(NULL, 0, clintanalyze_thread, &chunks[i], 0, NULL);
+    for (i = 0; i < threads; i++) {
+      if (workers[i] == NULL) {
+        clintanalyze_chunk(&chunks[i]);
+      } else {
+        WaitForSingleObject(workers[i], INFINITE);
+        CloseHandle(workers[i]);
+      }
+    }
+#else
+    pthread_t workers[CLINTANALYZE_MAX_THREADS];
+    int started[CLINTANALYZE_MAX_THREADS];
+    for (i = 0; i < threads; i++)
+      started[i] = (pthread_create(&workers[i], NULL, clintanalyze_thread, &chunks[i]) == 0);
+    for (i = 0; i < threads; i++) {
+      if (started[i])
+        pthread_join(workers[i], NULL);
+      else
+        clintanalyze_chunk(&chunks[i]);
+    }
+#endif
+  }
+
+  clintanalyze_report(chunks, threads, data + size);
+  fprintf(stderr, "clintanalyze: %lu lines, %.1f MB in %.3f s on %d thread%s\n",
+          (unsigned long)chunks[0].lines, (double)size / (1024.0 * 1024.0),
+          (double)(clint_time_now() - start) * 1.0e-9, threads, (threads == 1) ? "" : "s");
+  return 0;
+}
@@ -0,0 +1,163 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Render a CLINT_TRACE_BINARY file as the text CLINT_TRACE would have logged. */
+
+#include "clint_data.h"
+#include "clint_opencl_funcs.h"
+#include "clint_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ClintdecodeRecord {
+  cl_ulong time;
+  size_t offset;
+} ClintdecodeRecord;
+
+/* Threads flush in chunks, so order by time; equal times keep file order. */
+static int clintdecode_compare(const void *a, const void *b)
+{
+  const ClintdecodeRecord *ra = (const ClintdecodeRecord*)a;
+  const ClintdecodeRecord *rb = (const ClintdecodeRecord*)b;
+
+  if (ra->time != rb->time)
+    return ra->time < rb->time ? -1 : 1;
+  return ra->offset < rb->offset ? -1 : ra->offset > rb->offset;
+}
+
+static unsigned char *clintdecode_read(const char *path, size_t *size)
+{
+  unsigned char *data = NULL;
+  size_t capacity = 0;
+  size_t n;
+  FILE *fp;
+
+  fp = fopen(path, "rb");
+  if (fp == NULL)
+    return NULL;
+  *size = 0;
+  do {
+    if (*size == capacity) {
+      capacity = capacity ? capacity * 2 : 1024 * 1024;
+      data = (unsigned char*)realloc(data, capacity);
+      if (data == NULL)
+        break;
+    }
+    n = fread(data + *size, 1, capacity - *size, fp);
+    *size += n;
+  } while (n > 0);
+  fclose(fp);
+  return data;
+}
+
+int main(int argc, const char *argv[])
+{
+  unsigned char args[CLINT_TRACE_MAX_RECORD];
+  ClintTraceHeader header;
+  ClintTraceRecord record;
+  ClintdecodeRecord *records;
+  ClintAutopool pool;
+  unsigned char *data;
+  const char *path;
+  const char *text;
+  size_t num_records = 0;
+  size_t offset;
+  size_t size;
+  size_t i;
+  int verbose = 0;
+
+  if (argc > 2 && strcmp(argv[1], "-v") == 0) {
+    verbose = 1;
+    argv++;
+    argc--;
+  }
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s [-v] file\n", argv[0]);
+    return 1;
+  }
+  path = argv[1];
+  data = clintdecode_read(path, &size);
+  if (data == NULL) {
+    fprintf(stderr, "%s: can't read %s\n", argv[0], path);
+    return 1;
+  }
+  if (size < sizeof(header)) {
+    fprintf(stderr, "%s: %s is not a CLIntercept trace\n", argv[0], path);
+    return 1;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, CLINT_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != CLINT_TRACE_VERSION) {
+    fprintf(stderr, "%s: %s is not a CLIntercept trace\n", argv[0], path);
+    return 1;
+  }
+  if (header.funcs != ClintFunc_max || header.pointer_size != sizeof(void*)) {
+    fprintf(stderr, "%s: %s was written by a different build of CLIntercept\n", argv[0], path);
+    return 1;
+  }
+
+  /* Index the records first; a truncated last record is ignored. */
+  records = (ClintdecodeRecord*)malloc(sizeof(ClintdecodeRecord) * (size / sizeof(record) + 1));
+  if (records == NULL)
+    return 1;
+  for (offset = sizeof(header); offset + sizeof(record) <= size; offset += record.size) {
+    memcpy(&record, data + offset, sizeof(record));
+    if (record.size < sizeof(record) || record.size > CLINT_TRACE_MAX_RECORD ||
+        offset + record.size > size) {
+      fprintf(stderr, "%s: %s is corrupt at offset %lu\n", argv[0], path, (unsigned long)offset);
+      break;
+    }
+    records[num_records].time = record.time;
+    records[num_records].offset = offset;
+    num_records++;
+  }
+  qsort(records, num_records, sizeof(ClintdecodeRecord), clintdecode_compare);
+
+  clint_data_init();
+  for (i = 0; i < num_records; i++) {
+    memcpy(&record, data + records[i].offset, sizeof(record));
+    /* Decoders trust the layout, so give them a zero padded copy. */
+    memset(args, 0, sizeof(args));
+    memcpy(args, data + records[i].offset + sizeof(record), record.size - sizeof(record));
+    clint_autopool_begin(&pool);
+    text = clint_decode_record(record.func, (ClintTraceKind)record.kind, args);
+    if (text == NULL)
+      text = "(unknown record)\n";
+    if (verbose)
+      printf("[%u %lu] %s", record.thread, (unsigned long)record.time, text);
+    else
+      fputs(text, stdout);
+    clint_autopool_end(&pool);
+  }
+  clint_data_shutdown();
+  free(records);
+  free(data);
+  return 0;
+}
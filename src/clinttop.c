@@ -0,0 +1,209 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Live view of the counters a process running with CLINT_SHM publishes. */
+
+#include "clint_shm.h"
+#include "clint_time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CLINTTOP_ROWS 20
+
+static const char *g_clinttop_objects[ClintShmObject_max] = {
+  "contexts",
+  "queues",
+  "mems",
+  "samplers",
+  "programs",
+  "kernels",
+  "events"
+};
+
+typedef struct ClinttopRow {
+  int func;
+  double rate;
+} ClinttopRow;
+
+static const ClintShmHeader *clinttop_attach(long pid)
+{
+  char name[64];
+  const ClintShmHeader *shm;
+
+#if defined(WIN32)
+  HANDLE handle;
+  sprintf_s(name, sizeof(name), "Local\\clint.%ld", pid);
+  handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+  if (handle == NULL)
+    return NULL;
+  shm = (const ClintShmHeader*)MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+#else
+  struct stat st;
+  int fd;
+  snprintf(name, sizeof(name), "/clint.%ld", pid);
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ClintShmHeader)) {
+    close(fd);
+    return NULL;
+  }
+  shm = (const ClintShmHeader*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == (const ClintShmHeader*)MAP_FAILED)
+    return NULL;
+  if ((size_t)st.st_size < CLINT_SHM_SIZE(shm->num_funcs))
+    return NULL;
+#endif
+  if (shm == NULL || shm->magic != CLINT_SHM_MAGIC || shm->version != CLINT_SHM_VERSION)
+    return NULL;
+  return shm;
+}
+
+static int clinttop_alive(long pid)
+{
+#if defined(WIN32)
+  DWORD code = 0;
+  HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, (DWORD)pid);
+  if (process == NULL)
+    return 0;
+  GetExitCodeProcess(process, &code);
+  CloseHandle(process);
+  return code == STILL_ACTIVE;
+#else
+  return kill((pid_t)pid, 0) == 0;
+#endif
+}
+
+static void clinttop_sleep(double seconds)
+{
+#if defined(WIN32)
+  Sleep((DWORD)(seconds * 1000));
+#else
+  usleep((useconds_t)(seconds * 1000000));
+#endif
+}
+
+static int clinttop_compare(const void *a, const void *b)
+{
+  const ClinttopRow *ra = (const ClinttopRow*)a;
+  const ClinttopRow *rb = (const ClinttopRow*)b;
+
+  if (ra->rate != rb->rate)
+    return (ra->rate < rb->rate) ? 1 : -1;
+  return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+  const ClintShmHeader *shm;
+  ClintShmHeader last;
+  long long *last_calls;
+  ClinttopRow *rows;
+  const char *names;
+  double interval = 1.0;
+  cl_ulong last_time;
+  long pid;
+  int num_funcs;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s pid [seconds]\n", argv[0]);
+    return 1;
+  }
+  pid = strtol(argv[1], NULL, 10);
+  if (argc > 2)
+    interval = atof(argv[2]);
+  if (interval <= 0)
+    interval = 1.0;
+  shm = clinttop_attach(pid);
+  if (shm == NULL) {
+    fprintf(stderr, "%s: no CLIntercept counters for process %ld (is CLINT_SHM set?)\n", argv[0], pid);
+    return 1;
+  }
+  num_funcs = (int)shm->num_funcs;
+  names = CLINT_SHM_NAMES(shm);
+  last_calls = (long long*)calloc(num_funcs, sizeof(long long));
+  rows = (ClinttopRow*)calloc(num_funcs, sizeof(ClinttopRow));
+  if (last_calls == NULL || rows == NULL)
+    return 1;
+
+  memcpy(&last, (const void*)shm, sizeof(last));
+  for (i = 0; i < num_funcs; i++)
+    last_calls[i] = CLINT_SHM_CALLS(shm)[i];
+  last_time = clint_time_now();
+  while (clinttop_alive(pid)) {
+    ClintShmHeader now;
+    double elapsed;
+    cl_ulong t;
+    int o;
+
+    clinttop_sleep(interval);
+    memcpy(&now, (const void*)shm, sizeof(now));
+    t = clint_time_now();
+    elapsed = (double)(t - last_time) * 1.0e-9;
+    last_time = t;
+    for (i = 0; i < num_funcs; i++) {
+      long long calls = CLINT_SHM_CALLS(shm)[i];
+      rows[i].func = i;
+      rows[i].rate = (double)(calls - last_calls[i]) / elapsed;
+      last_calls[i] = calls;
+    }
+    qsort(rows, num_funcs, sizeof(ClinttopRow), clinttop_compare);
+
+    printf("\033[H\033[2J");
+    printf("clinttop: process %ld\n\n", pid);
+    printf("kernels/s %10.1f   device busy %6.1f%%   buffers %10.3f MB/s\n",
+           (double)(now.kernels - last.kernels) / elapsed,
+           100.0 * (double)(now.device_busy_ns - last.device_busy_ns) * 1.0e-9 / elapsed,
+           (double)(now.buffer_bytes - last.buffer_bytes) * 1.0e-6 / elapsed);
+    printf("live");
+    for (o = 0; o < ClintShmObject_max; o++)
+      printf("  %s %lld", g_clinttop_objects[o], (long long)now.objects[o]);
+    printf("\n\n%-40s %12s %14s\n", "function", "calls/s", "calls");
+    for (i = 0; i < num_funcs && i < CLINTTOP_ROWS && rows[i].rate > 0; i++) {
+      printf("%-40.40s %12.1f %14lld\n", names + rows[i].func * CLINT_SHM_NAME_SIZE,
+             rows[i].rate, last_calls[rows[i].func]);
+    }
+    fflush(stdout);
+    last = now;
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Throughput of the generated trace formatters: enum and bitfield names, and
+   whole clCreateBuffer trace lines as CLINT_TRACE formats them.  Each call
+   runs in its own autopool, as in the wrappers. */
+
+#include "clint_data.h"
+#include "clint_opencl_types.h"
+#include "clint_time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const cl_int g_bench_errors[] = {
+  CL_SUCCESS, CL_OUT_OF_RESOURCES, CL_INVALID_VALUE, CL_INVALID_CONTEXT,
+  CL_INVALID_MEM_OBJECT, CL_INVALID_EVENT, CL_INVALID_OPERATION, -9999
+};
+
+static const cl_mem_info g_bench_mem_info[] = {
+  CL_MEM_TYPE, CL_MEM_FLAGS, CL_MEM_SIZE, CL_MEM_FLAGS
+};
+
+static const cl_mem_flags g_bench_mem_flags[] = {
+  CL_MEM_READ_WRITE,
+  CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+  CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
+  CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
+};
+
+static size_t g_bench_sink;
+
+static void bench_report(const char *name, cl_ulong start, int n)
+{
+  double ns = (double)(clint_time_now() - start) / (double)n;
+  printf("%-24s %10.1f ns %10.2f M/s\n", name, ns, 1.0e3 / ns);
+}
+
+int main(int argc, char *argv[])
+{
+  ClintAutopool pool;
+  cl_ulong start;
+  int n = (argc > 1) ? atoi(argv[1]) : 2000000;
+  int i;
+
+  start = clint_time_now();
+  for (i = 0; i < n; i++) {
+    clint_autopool_begin(&pool);
+    g_bench_sink += strlen(clint_string_error(g_bench_errors[i & 7]));
+    clint_autopool_end(&pool);
+  }
+  bench_report("clint_string_error", start, n);
+
+  start = clint_time_now();
+  for (i = 0; i < n; i++) {
+    clint_autopool_begin(&pool);
+    g_bench_sink += strlen(clint_string_mem_info(g_bench_mem_info[i & 3]));
+    clint_autopool_end(&pool);
+  }
+  bench_report("clint_string_mem_info", start, n);
+
+  start = clint_time_now();
+  for (i = 0; i < n; i++) {
+    clint_autopool_begin(&pool);
+    g_bench_sink += strlen(clint_string_mem_flags(g_bench_mem_flags[i & 3]));
+    clint_autopool_end(&pool);
+  }
+  bench_report("clint_string_mem_flags", start, n);
+
+  start = clint_time_now();
+  for (i = 0; i < n; i++) {
+    clint_autopool_begin(&pool);
+    g_bench_sink += strlen(clint_string_device_type(CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_ACCELERATOR));
+    clint_autopool_end(&pool);
+  }
+  bench_report("clint_string_device_type", start, n);
+
+  start = clint_time_now();
+  for (i = 0; i < n; i++) {
+    clint_autopool_begin(&pool);
+    g_bench_sink += strlen(clint_string_sprintf(
+      "clCreateBuffer(context=%p, flags=%s, size=%lu, host_ptr=%p, errcode_ret=%p)\n",
+      (void*)&pool, clint_string_mem_flags(g_bench_mem_flags[i & 3]), (unsigned long)i, (void*)NULL, (void*)&i));
+    g_bench_sink += strlen(clint_string_sprintf("clCreateBuffer returned %p errcode_ret=%s\n",
+                                                (void*)&pool, clint_string_error(g_bench_errors[i & 7])));
+    clint_autopool_end(&pool);
+  }
+  bench_report("clCreateBuffer trace", start, n);
+
+  return (g_bench_sink == 0);
+}
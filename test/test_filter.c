@@ -0,0 +1,89 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_filter_rules.h"
+
+#include <assert.h>
+#include <string.h>
+
+static int match(const char *patterns, const char *name)
+{
+  ClintFilterRules rules;
+
+  clint_filter_compile(&rules, patterns);
+  return clint_filter_match(&rules, name);
+}
+
+int main(int argc, const char *argv[])
+{
+  ClintFilterRules rules;
+
+  (void)argc;
+  (void)argv;
+
+  assert(clint_filter_glob("clEnqueue*", "clEnqueueNDRangeKernel"));
+  assert(clint_filter_glob("*Kernel", "clEnqueueNDRangeKernel"));
+  assert(clint_filter_glob("cl*Read*", "clEnqueueReadBuffer"));
+  assert(clint_filter_glob("clFinis?", "clFinish"));
+  assert(clint_filter_glob("*", ""));
+  assert(clint_filter_glob("clFinish", "clFinish"));
+  assert(!clint_filter_glob("clFinish", "clFinished"));
+  assert(!clint_filter_glob("clFinis?", "clFinis"));
+  assert(!clint_filter_glob("*Buffer", "clEnqueueReadBufferRect"));
+
+  clint_filter_compile(&rules, " clEnqueue*,-clEnqueueMarker* ;clFinish ");
+  assert(rules.count == 3);
+  assert(strcmp(rules.patterns[0], "clEnqueue*") == 0 && !rules.exclude[0]);
+  assert(strcmp(rules.patterns[1], "clEnqueueMarker*") == 0 && rules.exclude[1]);
+  assert(strcmp(rules.patterns[2], "clFinish") == 0 && !rules.exclude[2]);
+
+  /* No patterns match everything. */
+  assert(match(NULL, "clFinish"));
+  assert(match("", "clFinish"));
+  assert(match(" , ", "clFinish"));
+
+  /* The last match wins. */
+  assert(match("clEnqueue*, -clEnqueueMarker*", "clEnqueueNDRangeKernel"));
+  assert(!match("clEnqueue*, -clEnqueueMarker*", "clEnqueueMarkerWithWaitList"));
+  assert(match("clEnqueue*, -clEnqueueMarker*, clEnqueueMarker", "clEnqueueMarker"));
+  assert(!match("clEnqueueMarker, -clEnqueue*", "clEnqueueMarker"));
+
+  /* Unmatched names are included only if the first pattern excludes. */
+  assert(!match("clEnqueue*", "clFinish"));
+  assert(match("-clEnqueue*", "clFinish"));
+  assert(!match("-clEnqueue*", "clEnqueueReadBuffer"));
+  assert(!match("clFinish, -clEnqueue*", "clCreateBuffer"));
+  assert(match("-clEnqueue*, clEnqueueReadBuffer", "clCreateBuffer"));
+  assert(match("-clEnqueue*, clEnqueueReadBuffer", "clEnqueueReadBuffer"));
+
+  /* Kernel names are matched the same way. */
+  assert(match("blur_*, -blur_debug", "blur_h"));
+  assert(!match("blur_*, -blur_debug", "blur_debug"));
+  assert(!match("blur_*", NULL));
+  return 0;
+}
@@ -0,0 +1,109 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_info_handles.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A report naming a platform and two devices, whose handles differ between runs. */
+static void report(char *text, void *platform, void *gpu, void *cpu)
+{
+  sprintf(text,
+          "Platform %p: Stub\n"
+          "  Device %p: GPU\n"
+          "    CL_DEVICE_PLATFORM: %p\n"
+          "    CL_DEVICE_PARENT_DEVICE: (nil)\n"
+          "  Device %p: CPU,%p\n"
+          "    CL_DEVICE_MAX_MEM_ALLOC_SIZE: 4096\n",
+          platform, gpu, platform, cpu, gpu);
+}
+
+int main(int argc, const char *argv[])
+{
+  ClintInfoHandles run1 = { 0, NULL, NULL };
+  ClintInfoHandles run2 = { 0, NULL, NULL };
+  char text1[1024], text2[1024], generic[1024];
+  char *cached, *restored, *again;
+
+  (void)argc;
+  (void)argv;
+
+  /* The second device's handle starts with the first's, so only whole words
+     may be replaced. */
+  clint_info_add(&run1, (void*)0x1000, "platform", 0);
+  clint_info_add(&run1, (void*)0x2000, "device", 0);
+  clint_info_add(&run1, (void*)0x20000, "device", 1);
+  assert(run1.count == 3);
+  assert(strcmp(run1.tokens[0], "{platform 0}") == 0);
+  assert(strcmp(run1.tokens[2], "{device 1}") == 0);
+
+  clint_info_add(&run2, (void*)0x3000, "platform", 0);
+  clint_info_add(&run2, (void*)0x4000, "device", 0);
+  clint_info_add(&run2, (void*)0x5000, "device", 1);
+
+  /* What is cached names the handles by token. */
+  report(text1, (void*)0x1000, (void*)0x2000, (void*)0x20000);
+  cached = clint_info_replace(text1, run1.pointers, run1.tokens, run1.count);
+  assert(cached != NULL);
+  strcpy(generic,
+         "Platform {platform 0}: Stub\n"
+         "  Device {device 0}: GPU\n"
+         "    CL_DEVICE_PLATFORM: {platform 0}\n"
+         "    CL_DEVICE_PARENT_DEVICE: (nil)\n"
+         "  Device {device 1}: CPU,{device 0}\n"
+         "    CL_DEVICE_MAX_MEM_ALLOC_SIZE: 4096\n");
+  assert(strcmp(cached, generic) == 0);
+
+  /* Reading it back in the same run gives the original report. */
+  restored = clint_info_replace(cached, run1.tokens, run1.pointers, run1.count);
+  assert(restored != NULL && strcmp(restored, text1) == 0);
+
+  /* And in a later run, the same report with that run's handles. */
+  again = clint_info_replace(cached, run2.tokens, run2.pointers, run2.count);
+  report(text2, (void*)0x3000, (void*)0x4000, (void*)0x5000);
+  assert(again != NULL && strcmp(again, text2) == 0);
+
+  /* Replacements longer than the text make it grow.  Tokens are whole words too. */
+  free(restored);
+  restored = clint_info_replace("{device 1}{device 1}x{device 1}", run1.tokens, run1.pointers, run1.count);
+  assert(restored != NULL);
+  sprintf(text2, "%p{device 1}x{device 1}", (void*)0x20000);
+  assert(strcmp(restored, text2) == 0);
+
+  free(cached);
+  free(restored);
+  free(again);
+  free(run1.pointers);
+  free(run1.tokens);
+  free(run2.pointers);
+  free(run2.tokens);
+  return 0;
+}
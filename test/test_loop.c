@@ -0,0 +1,180 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+** CLIntercept OpenCL debugging utilities
+** Copyright (c) 2012, Digital Anarchy, Inc.
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**
+** * Redistributions of source code must retain the above copyright notice,
+**   this list of conditions and the following disclaimer.
+** * Redistributions in binary form must reproduce the above copyright notice,
+**   this list of conditions and the following disclaimer in the documentation
+**   and/or other materials provided with the distribution.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+** AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+** IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+** ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+** LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+** CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+** SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+** INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+** CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+** ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+** THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "clint_log.h"
+#include "clint_loop.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SET_ARG "clSetKernelArg(kernel=0x%x, arg_index=0, arg_size=8)\n"
+#define LAUNCH "clEnqueueNDRangeKernel(command_queue=0x10, kernel=0x%x, work_dim=1)\n"
+#define READ "clEnqueueReadBuffer(command_queue=0x10, buffer=0x20, offset=%u)\n"
+#define FINISH "clFinish(command_queue=0x10)\n"
+
+static FILE *g_log;
+static unsigned int g_test;
+
+/* Log to a new file, after a call that ends any loop the last test left. */
+static void start(void)
+{
+  FILE *fp = g_log;
+  char line[64];
+
+  if (fp != NULL) {
+    sprintf(line, "test %u\n", ++g_test);
+    clint_loop_trace(0, line);
+  }
+  g_log = tmpfile();
+  assert(g_log != NULL);
+  clint_log_init_fp(g_log);
+  if (fp != NULL)
+    fclose(fp);
+}
+
+/* Trace a line as a generated wrapper would. */
+static void call(int func, const char *fmt, unsigned int i)
+{
+  char line[256];
+
+  sprintf(line, fmt, i);
+  clint_loop_trace(func, line);
+}
+
+/* Compare everything logged since start() with the expected lines. */
+static void expect(const char *expected)
+{
+  char text[4096];
+  size_t n;
+
+  clint_loop_flush();
+  fflush(g_log);
+  rewind(g_log);
+  n = fread(text, 1, sizeof(text) - 1, g_log);
+  text[n] = 0;
+  if (strcmp(text, expected) != 0) {
+    fprintf(stderr, "expected:\n%sgot:\n%s", expected, text);
+    assert(0);
+  }
+}
+
+int main(int argc, const char *argv[])
+{
+  unsigned int i;
+
+  (void)argc;
+  (void)argv;
+
+  /* Seen twice, the pair is a loop: later repeats are held back until a
+     different call, then counted, with the fields that changed, and the last
+     one logged in full.  Handles changing don't break the loop. */
+  start();
+  for (i = 0; i < 5; i++) {
+    call(1, SET_ARG, 0x1000 + i);
+    call(2, LAUNCH, 0x1000 + i);
+  }
+  call(3, FINISH, 0);
+  expect("clSetKernelArg(kernel=0x1000, arg_index=0, arg_size=8)\n"
+         "clEnqueueNDRangeKernel(command_queue=0x10, kernel=0x1000, work_dim=1)\n"
+         "clSetKernelArg(kernel=0x1001, arg_index=0, arg_size=8)\n"
+         "clEnqueueNDRangeKernel(command_queue=0x10, kernel=0x1001, work_dim=1)\n"
+         "... x2 (2 calls), kernel vary\n"
+         "clSetKernelArg(kernel=0x1004, arg_index=0, arg_size=8)\n"
+         "clEnqueueNDRangeKernel(command_queue=0x10, kernel=0x1004, work_dim=1)\n"
+         "clFinish(command_queue=0x10)\n");
+
+  /* Identical repeats list no fields, and a single repeating call is a loop
+     too.  Flushing logs what is held back. */
+  start();
+  for (i = 0; i < 6; i++)
+    call(3, FINISH, 0);
+  expect("clFinish(command_queue=0x10)\n"
+         "clFinish(command_queue=0x10)\n"
+         "... x3 (1 calls)\n"
+         "clFinish(command_queue=0x10)\n");
+
+  /* One held back repeat and a partial one are logged as they were. */
+  start();
+  for (i = 0; i < 3; i++) {
+    call(1, SET_ARG, 0x1000);
+    call(2, LAUNCH, 0x1000);
+  }
+  call(1, SET_ARG, 0x1000);
+  call(3, FINISH, 0);
+  expect("clSetKernelArg(kernel=0x1000, arg_index=0, arg_size=8)\n"
+         "clEnqueueNDRangeKernel(command_queue=0x10, kernel=0x1000, work_dim=1)\n"
+         "clSetKernelArg(kernel=0x1000, arg_index=0, arg_size=8)\n"
+         "clEnqueueNDRangeKernel(command_queue=0x10, kernel=0x1000, work_dim=1)\n"
+         "clSetKernelArg(kernel=0x1000, arg_index=0, arg_size=8)\n"
+         "clEnqueueNDRangeKernel(command_queue=0x10, kernel=0x1000, work_dim=1)\n"
+         "clSetKernelArg(kernel=0x1000, arg_index=0, arg_size=8)\n"
+         "clFinish(command_queue=0x10)\n");
+
+  /* Values other than handles are part of the pattern, so calls that differ
+     in them are not a loop. */
+  start();
+  for (i = 0; i < 4; i++)
+    call(4, READ, i);
+  expect("clEnqueueReadBuffer(command_queue=0x10, buffer=0x20, offset=0)\n"
+         "clEnqueueReadBuffer(command_queue=0x10, buffer=0x20, offset=1)\n"
+         "clEnqueueReadBuffer(command_queue=0x10, buffer=0x20, offset=2)\n"
+         "clEnqueueReadBuffer(command_queue=0x10, buffer=0x20, offset=3)\n");
+
+  /* The longest loop recognized is 16 calls.  Returns name their value retval. */
+  start();
+  for (i = 0; i < 4 * 16; i++) {
+    if (i % 16 == 15)
+      call(5, "clCreateBuffer returned 0x%x\n", 0x100 + i);
+    else
+      call(4, READ, i % 16);
+  }
+  call(3, FINISH, 0);
+  {
+    char expected[4096] = "";
+    char line[256];
+    for (i = 0; i < 2 * 16; i++) {
+      if (i % 16 == 15)
+        sprintf(line, "clCreateBuffer returned 0x%x\n", 0x100 + i);
+      else
+        sprintf(line, READ, i % 16);
+      strcat(expected, line);
+    }
+    strcat(expected, "... x1 (16 calls), retval vary\n");
+    for (i = 3 * 16; i < 4 * 16; i++) {
+      if (i % 16 == 15)
+        sprintf(line, "clCreateBuffer returned 0x%x\n", 0x100 + i);
+      else
+        sprintf(line, READ, i % 16);
+      strcat(expected, line);
+    }
+    strcat(expected, FINISH);
+    expect(expected);
+  }
+  return 0;
+}